@@ -15,7 +15,6 @@ int main(int argc, char *argv[])
     getDeviceSerial();
     best_session_time = get_best_session_time();
 
-    FILE *fp;
     int old_percentage = -1, current_percentage, warn_at = 15, last_logged_percentage = -1;
 
     atexit(cleanup);
@@ -55,6 +54,7 @@ int main(int argc, char *argv[])
                     best_session_time = session_time;
                 }
                 log_new_percentage(current_percentage, is_charging);
+                shared_state_setBattery(current_percentage, is_charging);
             }
         }
         else if (is_charging) {
@@ -75,6 +75,7 @@ int main(int argc, char *argv[])
             }
             update_current_duration();
             log_new_percentage(current_percentage, is_charging);
+            shared_state_setBattery(current_percentage, is_charging);
         }
 
         if (!is_suspended) {
@@ -104,7 +105,7 @@ int main(int argc, char *argv[])
                     "saving percBat: suspended = %d, perc = %d, warn = %d\n",
                     is_suspended, current_percentage, warn_at);
                 old_percentage = current_percentage;
-                file_put_sync(fp, "/tmp/percBat", "%d", current_percentage);
+                shared_state_setBattery(current_percentage, is_charging);
 
                 if (abs(last_logged_percentage - current_percentage) >= BATTERY_LOG_THRESHOLD) {
                     // Current battery state duration addition
@@ -174,7 +175,7 @@ static void sigHandler(int sig)
 
 void cleanup(void)
 {
-    remove("/tmp/percBat");
+    shared_state_setBattery(-1, false);
     display_free();
     close(sar_fd);
 }
@@ -387,7 +388,7 @@ int batteryPercentage(int value)
 static void *batteryWarning_thread(void *param)
 {
     while (1) {
-        if (temp_flag_get("hasBatteryDisplay"))
+        if (shared_state_getFlag(SHARED_FLAG_BATTERY_DISPLAY))
             break;
         display_drawBatteryIcon(0x00FF0000, 15, RENDER_HEIGHT - 30, 10,
                                 0x00FF0000); // draw red battery icon
@@ -415,5 +416,5 @@ void batteryWarning_hide(void)
 
 bool warningDisabled(void)
 {
-    return config_flag_get(".noBatteryWarning") || temp_flag_get("hasBatteryDisplay") || process_isRunning("MainUI");
+    return config_flag_get(".noBatteryWarning") || shared_state_getFlag(SHARED_FLAG_BATTERY_DISPLAY) || process_isRunning("MainUI");
 }
@@ -2,14 +2,29 @@
 #define MENU_H__
 
 #include <SDL/SDL.h>
+#include <SDL/SDL_image.h>
+#include <SDL/SDL_rotozoom.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 
+#include "utils/file.h"
+#include "utils/imageCache.h"
 #include "utils/str.h"
 
 #define MAX_NUM_VALUES 100
+#define LIST_ARENA_BLOCK_SIZE 4096
+#define LIST_TEXT_MAX (STR_MAX - 1) // longest text an item field holds
+#define LIST_PREVIEW_WIDTH 250       // previews are scaled down to fit the preview box
+
+/**
+ * @brief Value labels of a MULTIVALUE item (copied by list_addItem):
+ * `.value_labels = LIST_VALUE_LABELS("Off", "On")`
+ */
+#define LIST_VALUE_LABELS(...) \
+    ((const char *[]){__VA_ARGS__, NULL})
 
 typedef enum list_type { LIST_SMALL,
                          LIST_LARGE } ListType;
@@ -17,6 +32,24 @@ typedef enum item_type { ACTION,
                          TOGGLE,
                          MULTIVALUE } ListItemType;
 
+/**
+ * Item texts live in a per-list arena: blocks that are only freed with the
+ * list, so the pointers stay valid. Each text is preceded by one byte
+ * holding its capacity, which lets a shorter or equal text be written in
+ * place (see list_setItemText).
+ */
+typedef struct ListArenaBlock {
+    struct ListArenaBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+} ListArenaBlock;
+
+typedef struct ListArena {
+    ListArenaBlock *blocks;
+    char *empty; // shared "" (capacity 0)
+} ListArena;
+
 typedef struct ListItem {
     int _id;
     ListItemType item_type;
@@ -25,14 +58,14 @@ typedef struct ListItem {
     bool disable_arrows;
     bool disable_a_btn;
     bool alternative_arrow_action;
-    char label[STR_MAX];
-    char description[STR_MAX];
-    char payload[STR_MAX];
+    const char *label;
+    const char *description;
+    const char *payload;
     void *payload_ptr;
     int value;
     int value_min;
     int value_max;
-    char value_labels[MAX_NUM_VALUES][STR_MAX];
+    const char **value_labels; // NULL terminated, see LIST_VALUE_LABELS
     void (*value_formatter)(void *self, char *out_label);
     void (*action)(void *self);
     void (*arrow_action)(void *self);
@@ -40,9 +73,10 @@ typedef struct ListItem {
     int _reset_value;
     void *icon_ptr;
     void *preview_ptr;
-    char preview_path[STR_MAX];
-    char sticky_note[STR_MAX];
-    char info_note[STR_MAX];
+    const char *preview_path;
+    const char *sticky_note;
+    const char *info_note;
+    ListArena *_arena;
 } ListItem;
 
 typedef struct List {
@@ -54,12 +88,124 @@ typedef struct List {
     int scroll_height;
     ListType list_type;
     ListItem *items;
+    ListArena *arena;
+    ImageCache *preview_cache; // see list_prefetchPreviews
+    int _preview_pending;      // active item whose preview is being loaded
     bool has_sticky;
     bool _created;
 } List;
 
 static int list_id_incr = 0;
 
+static void *__list_arenaAlloc(ListArena *arena, size_t size, size_t align)
+{
+    ListArenaBlock *block = arena->blocks;
+    size_t offset = block != NULL ? (block->used + align - 1) & ~(align - 1) : 0;
+
+    if (block == NULL || offset + size > block->size) {
+        size_t block_size = size > LIST_ARENA_BLOCK_SIZE ? size : LIST_ARENA_BLOCK_SIZE;
+        if ((block = (ListArenaBlock *)malloc(sizeof(ListArenaBlock) + block_size)) == NULL)
+            return NULL;
+        block->next = arena->blocks;
+        block->size = block_size;
+        arena->blocks = block;
+        offset = 0;
+    }
+
+    block->used = offset + size;
+    return block->data + offset;
+}
+
+// Texts get some slack, so notes updated with similar texts stay in place
+static char *__list_arenaText(ListArena *arena, const char *text)
+{
+    size_t len = strnlen(text, LIST_TEXT_MAX);
+    size_t capacity = (len + 15) & ~(size_t)15;
+    if (capacity > LIST_TEXT_MAX)
+        capacity = LIST_TEXT_MAX;
+
+    if (capacity == 0 && arena->empty != NULL)
+        return arena->empty;
+
+    char *block = (char *)__list_arenaAlloc(arena, capacity + 2, 1);
+    if (block == NULL)
+        return NULL;
+    block[0] = (char)(uint8_t)capacity;
+    memcpy(block + 1, text, len);
+    block[len + 1] = '\0';
+    return block + 1;
+}
+
+static size_t __list_textCapacity(const char *text)
+{
+    return (uint8_t)text[-1];
+}
+
+static ListArena *__list_arenaCreate(void)
+{
+    ListArena *arena = (ListArena *)calloc(1, sizeof(ListArena));
+    if (arena != NULL)
+        arena->empty = __list_arenaText(arena, "");
+    return arena;
+}
+
+static void __list_arenaFree(ListArena *arena)
+{
+    if (arena == NULL)
+        return;
+    while (arena->blocks != NULL) {
+        ListArenaBlock *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    free(arena);
+}
+
+static char *__list_internText(ListArena *arena, const char *text)
+{
+    char *interned = text != NULL && text[0] != '\0' ? __list_arenaText(arena, text) : NULL;
+    return interned != NULL ? interned : arena->empty;
+}
+
+static const char **__list_internLabels(ListArena *arena, const char **labels)
+{
+    int count = 0;
+
+    if (labels == NULL)
+        return NULL;
+    while (labels[count] != NULL && count < MAX_NUM_VALUES)
+        count++;
+
+    const char **interned = (const char **)__list_arenaAlloc(arena, (count + 1) * sizeof(char *), sizeof(char *));
+    if (interned == NULL)
+        return NULL;
+    for (int i = 0; i < count; i++)
+        interned[i] = __list_internText(arena, labels[i]);
+    interned[count] = NULL;
+    return interned;
+}
+
+/**
+ * @brief Replaces one of the texts of an added item (`&item->label`,
+ * `&item->sticky_note`, ...). Written in place when it fits.
+ */
+void list_setItemText(ListItem *item, const char **field, const char *text)
+{
+    size_t len = strnlen(text, LIST_TEXT_MAX);
+
+    if (*field != NULL && len <= __list_textCapacity(*field)) {
+        // Arena texts are writable, only exposed as const
+        char *dst = (char *)*field;
+        memmove(dst, text, len);
+        dst[len] = '\0';
+        return;
+    }
+
+    char *replacement = __list_arenaText(item->_arena, text);
+    if (replacement != NULL)
+        *field = replacement;
+}
+
 int _list_modulo(int x, int n) { return (x % n + n) % n; }
 
 int list_countVisible(List *list)
@@ -113,11 +259,13 @@ void list_hideAllExcept(List *list, ListItem *item, bool disabled)
 
 List list_create(int max_items, ListType list_type)
 {
-    return (List){.scroll_height = list_type == LIST_SMALL ? 6 : 4,
+    return (List){._id = list_id_incr++,
+                  .scroll_height = list_type == LIST_SMALL ? 6 : 4,
                   .list_type = list_type,
                   .items = (ListItem *)calloc(max_items, sizeof(ListItem)),
-                  ._created = true,
-                  ._id = list_id_incr++};
+                  .arena = __list_arenaCreate(),
+                  ._preview_pending = -1,
+                  ._created = true};
 }
 
 List list_createWithTitle(int max_items, ListType list_type, const char *title)
@@ -135,11 +283,23 @@ List list_createWithSticky(int max_items, const char *title)
     return list;
 }
 
+/**
+ * @brief Adds a copy of `item`, its texts and value labels copied into the
+ * list's arena (the ones given may be temporary).
+ */
 ListItem *list_addItem(List *list, ListItem item)
 {
+    ListArena *arena = list->arena;
     item._reset_value = item.value;
     item._id = list->item_count;
-    memset(item.info_note, 0, STR_MAX);
+    item._arena = arena;
+    item.label = __list_internText(arena, item.label);
+    item.description = __list_internText(arena, item.description);
+    item.payload = __list_internText(arena, item.payload);
+    item.preview_path = __list_internText(arena, item.preview_path);
+    item.sticky_note = __list_internText(arena, item.sticky_note);
+    item.info_note = arena->empty;
+    item.value_labels = __list_internLabels(arena, item.value_labels);
     list->items[item._id] = item;
     list->item_count++;
     if (item.disabled && list->active_pos == item._id) {
@@ -151,7 +311,7 @@ ListItem *list_addItem(List *list, ListItem item)
 ListItem *list_addItemWithInfoNote(List *list, ListItem item, const char *info_note)
 {
     ListItem *_item = list_addItem(list, item);
-    strcpy(_item->info_note, info_note);
+    _item->info_note = __list_internText(list->arena, info_note);
     return _item;
 }
 
@@ -164,7 +324,7 @@ ListItem *list_currentItem(List *list)
 
 void list_updateStickyNote(ListItem *item, const char *message)
 {
-    strncpy(item->sticky_note, message, STR_MAX - 1);
+    list_setItemText(item, &item->sticky_note, message);
 }
 
 const char *list_getStickyNote(ListItem *item)
@@ -406,16 +566,112 @@ void list_getItemValueLabel(ListItem *item, char *out_label)
 {
     if (item->value_formatter != NULL)
         item->value_formatter(item, out_label);
-    else if (item->value_labels[0][0] != '\0')
+    else if (item->value_labels != NULL && item->value_labels[0] != NULL)
         sprintf(out_label, "%s", item->value_labels[item->value]);
     else
         sprintf(out_label, "%d", item->value);
 }
 
+// Runs on the preview cache's worker
+static SDL_Surface *__list_loadPreview(int index, void *userdata)
+{
+    ListItem *item = &((ListItem *)userdata)[index];
+    SDL_Surface *preview = NULL;
+
+    if (item->preview_path[0] != '\0' && is_file(item->preview_path))
+        preview = IMG_Load(item->preview_path);
+
+    if (preview != NULL && preview->w > LIST_PREVIEW_WIDTH) {
+        SDL_Surface *scaled = rotozoomSurface(preview, 0.0, (double)LIST_PREVIEW_WIDTH / preview->w, 0);
+        if (scaled != NULL) {
+            SDL_FreeSurface(preview);
+            preview = scaled;
+        }
+    }
+
+    return preview;
+}
+
+/**
+ * @brief Loads (and scales) item previews in the background, around the
+ * active item, instead of on the UI thread when an item gets active. Call
+ * once all items are added and sorted.
+ *
+ * @param capacity previews kept loaded
+ */
+void list_prefetchPreviews(List *list, int capacity)
+{
+    if (list->preview_cache != NULL || list->item_count == 0)
+        return;
+    list->preview_cache = imageCache_create(capacity, list->item_count, __list_loadPreview, list->items);
+}
+
+/**
+ * @brief Preview of an item to draw, NULL if it has none or it isn't
+ * loaded yet. Give it back with list_releasePreview.
+ */
+SDL_Surface *list_acquirePreview(List *list, ListItem *item)
+{
+    int index = item - list->items;
+
+    if (item->preview_path[0] == '\0')
+        return NULL;
+
+    if (list->preview_cache == NULL) {
+        if (item->preview_ptr == NULL && is_file(item->preview_path))
+            item->preview_ptr = (void *)IMG_Load(item->preview_path);
+        return (SDL_Surface *)item->preview_ptr;
+    }
+
+    imageCache_focus(list->preview_cache, index);
+    SDL_Surface *preview = imageCache_acquire(list->preview_cache, index);
+    list->_preview_pending = preview == NULL ? index : -1;
+    return preview;
+}
+
+void list_releasePreview(List *list, SDL_Surface *preview)
+{
+    if (list->preview_cache != NULL)
+        imageCache_release(list->preview_cache, preview);
+}
+
+/**
+ * @brief Whether the preview missing from the last render has been loaded
+ * since (the list needs to be rendered again).
+ */
+bool list_previewLoaded(List *list)
+{
+    if (list->preview_cache == NULL || list->_preview_pending < 0)
+        return false;
+    if (!imageCache_isLoaded(list->preview_cache, list->_preview_pending))
+        return false;
+    list->_preview_pending = -1;
+    return true;
+}
+
+/**
+ * @brief Changes the preview of an item, dropping the loaded one.
+ */
+void list_setItemPreview(List *list, ListItem *item, const char *preview_path)
+{
+    // Holds the loader off the path while it's rewritten
+    if (list->preview_cache != NULL)
+        imageCache_invalidate(list->preview_cache, item - list->items);
+
+    list_setItemText(item, &item->preview_path, preview_path);
+
+    if (item->preview_ptr != NULL) {
+        SDL_FreeSurface((SDL_Surface *)item->preview_ptr);
+        item->preview_ptr = NULL;
+    }
+}
+
 void list_free(List *list)
 {
     if (!list->_created)
         return;
+    imageCache_free(list->preview_cache);
+    list->preview_cache = NULL;
     for (int i = 0; i < list->item_count; i++) {
         ListItem *item = &list->items[i];
         if (item->icon_ptr != NULL)
@@ -424,6 +680,8 @@ void list_free(List *list)
             SDL_FreeSurface((SDL_Surface *)item->preview_ptr);
     }
     free(list->items);
+    __list_arenaFree(list->arena);
+    list->arena = NULL;
     list->_created = false;
 }
 
@@ -44,6 +44,11 @@ endif
 CXXFLAGS := $(CFLAGS)
 LDFLAGS := -L../../lib -L/usr/local/lib
 
+ifneq ($(INCLUDE_UTILS),0)
+# utils/log.c runs a background writer thread
+LDFLAGS := $(LDFLAGS) -lpthread
+endif
+
 ifeq ($(PLATFORM),miyoomini)
 CFLAGS := $(CFLAGS) -marm -mtune=cortex-a7 -mfpu=neon-vfpv4 -mfloat-abi=hard -march=armv7ve -Wl,-rpath=$(LIB)
 
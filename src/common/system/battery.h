@@ -2,6 +2,7 @@
 #define BATTERY_H__
 
 #include "system/device_model.h"
+#include "system/shared_state.h"
 #include "system/system.h"
 #include "utils/file.h"
 #include "utils/log.h"
@@ -20,7 +21,7 @@ static bool battery_is_charging = false;
 int battery_getPercentage(void)
 {
     FILE *fp;
-    int percentage = -1;
+    int percentage = shared_state_getBatteryPercentage(NULL);
     int retry = 3;
 
     while (percentage == -1 && retry > 0) {
@@ -97,8 +98,14 @@ bool battery_isCharging(void)
 bool battery_hasChanged(int ticks, int *out_percentage)
 {
     bool changed = false;
+    bool charging;
+    int published = shared_state_getBatteryPercentage(&charging);
 
-    if (battery_isCharging()) {
+    // batmon publishes the charging state too, no need to query the PMIC
+    if (published == -1)
+        charging = battery_isCharging();
+
+    if (charging) {
         if (!battery_is_charging) {
             *out_percentage = 500;
             battery_is_charging = true;
@@ -110,8 +117,8 @@ bool battery_hasChanged(int ticks, int *out_percentage)
         battery_is_charging = false;
     }
 
-    if (file_isModified("/tmp/percBat", &battery_last_modified)) {
-        int current_percentage = battery_getPercentage();
+    if (published != -1 || file_isModified("/tmp/percBat", &battery_last_modified)) {
+        int current_percentage = published != -1 ? published : battery_getPercentage();
 
         if (current_percentage != *out_percentage) {
             *out_percentage = current_percentage;
@@ -0,0 +1,98 @@
+#ifndef SYSTEM_KEYINJECT_H__
+#define SYSTEM_KEYINJECT_H__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "utils/str.h"
+
+#define KEYINJECT_MAX_EVENTS 100
+
+// Device the synthetic key events are written to (the one the apps read)
+static char keyinject_device[STR_MAX] = "/dev/input/event0";
+static int __keyinject_fd = -1;
+
+/**
+ * @brief Opens the input device for writing, kept open until
+ * keyinject_close(). Called implicitly by the send functions.
+ *
+ * @return true The device is open
+ */
+bool keyinject_open(void)
+{
+    if (__keyinject_fd != -1)
+        return true;
+
+    __keyinject_fd = open(keyinject_device, O_WRONLY | O_CLOEXEC);
+
+    if (__keyinject_fd == -1) {
+        printf_debug("Can't open %s: %s\n", keyinject_device, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+void keyinject_close(void)
+{
+    if (__keyinject_fd == -1)
+        return;
+    close(__keyinject_fd);
+    __keyinject_fd = -1;
+}
+
+/**
+ * @brief Injects key events, written in a single batch.
+ *
+ * @param n number of events (max KEYINJECT_MAX_EVENTS)
+ * @param code_value_pairs key code and value (0 - released, 1 - pressed,
+ * 2 - repeating) of each event
+ * @return true All events were written
+ */
+bool keyinject_sendMulti(int n, int code_value_pairs[][2])
+{
+    struct input_event events[KEYINJECT_MAX_EVENTS];
+    struct timeval now;
+
+    if (n > KEYINJECT_MAX_EVENTS)
+        n = KEYINJECT_MAX_EVENTS;
+
+    if (!keyinject_open())
+        return false;
+
+    gettimeofday(&now, NULL);
+
+    for (int i = 0; i < n; i++) {
+        memset(&events[i], 0, sizeof(struct input_event));
+        events[i].time = now;
+        events[i].type = EV_KEY;
+        events[i].code = code_value_pairs[i][0];
+        events[i].value = code_value_pairs[i][1];
+    }
+
+    size_t size = n * sizeof(struct input_event);
+    ssize_t written = write(__keyinject_fd, events, size);
+
+    if (written != (ssize_t)size) {
+        // The device may have gone away, reopen on the next call
+        print_debug("keyinject: write failed");
+        keyinject_close();
+        return false;
+    }
+
+    return true;
+}
+
+bool keyinject_send(unsigned short code, signed int value)
+{
+    int event[1][2] = {{code, value}};
+    return keyinject_sendMulti(1, event);
+}
+
+#endif // SYSTEM_KEYINJECT_H__
@@ -2,6 +2,9 @@
 #define SYSTEM_OSD_H__
 
 #include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "utils/config.h"
 #include "utils/log.h"
@@ -23,9 +26,6 @@
 #define OSD_VOLUME_COLOR OSD_COLOR_GREEN
 #define OSD_MUTE_ON_COLOR OSD_COLOR_RED
 
-static bool osd_thread_active = false;
-static pthread_t osd_pt;
-
 //
 //	Print digit
 //
@@ -128,67 +128,173 @@ void print_value(uint32_t value, uint32_t color)
     }
 }
 
+/**
+ * The bar is composited over whatever is on screen: a `meterWidth` wide
+ * column strip at the right edge of the framebuffer (which holds
+ * OSD_BAR_PAGES pages for triple buffering). Only the strip is saved and
+ * restored, per page. The thread polls the displayed page (yoffset) and
+ * redraws only when the value changes, the page flips, or the strip was
+ * drawn over; otherwise a poll is one ioctl and a few pixel reads.
+ */
+
+#define OSD_BAR_PAGES 3
+#define OSD_BAR_TIMEOUT 2000 // ms
+#define OSD_BAR_POLL_MS 4    // a quarter of a frame at 60 Hz
+#define OSD_BAR_PROBES 8     // rows checked to detect overdraw
+
+typedef struct {
+    uint32_t *fb;
+    int width; // pixels per row (framebuffer stride)
+    int height;
+    int pages;
+    int meter_width;
+    uint32_t *saved;               // strip behind the bar, per page
+    uint32_t drawn_pages;          // pages the bar was drawn on
+    uint64_t drawn[OSD_BAR_PAGES]; // value drawn on each page
+    uint32_t draw_count;           // times the bar was drawn
+} OsdBar;
+
 static int meterWidth = 4;
 static bool osd_bar_activated = false;
+static bool osd_thread_active = false;
+static pthread_t osd_pt;
+static bool _osd_thread_joinable = false;
+static volatile int _osd_stop = 0;
 static int _bar_timer = 0;
-static int _bar_value = 0;
-static int _bar_max = 0;
-static uint32_t _bar_color = 0x00FFFFFF;
+static uint64_t _bar_state = 0;
 #ifdef PLATFORM_MIYOOMINI
-static uint32_t *_bar_savebuf;
+static OsdBar _osd_bar;
 #endif
 
-void _print_bar(void)
+// Value, max and color in one word, so the thread reads them consistently
+// without a lock
+static uint64_t __osd_bar_pack(int value, int value_max, uint32_t color)
 {
-#ifdef PLATFORM_MIYOOMINI
-    uint32_t *ofs = fb_addr;
-    uint32_t i, j, curr, percentage = _bar_max > 0 ? _bar_value * RENDER_HEIGHT / _bar_max : 0;
+    return (uint64_t)color << 32 | (uint64_t)(value_max & 0xFFFF) << 16 | (value & 0xFFFF);
+}
+
+static uint32_t __osd_bar_pixel(uint64_t state, int row, int height)
+{
+    int value = state & 0xFFFF, value_max = (state >> 16) & 0xFFFF;
+    int filled = value_max > 0 ? value * height / value_max : 0;
+    return row < filled ? (uint32_t)(state >> 32) : 0;
+}
 
-    ofs += RENDER_WIDTH - meterWidth;
-    for (i = 0; i < RENDER_HEIGHT * 3; i++, ofs += RENDER_WIDTH) {
-        curr = (i % RENDER_HEIGHT) < percentage ? _bar_color : 0;
-        for (j = 0; j < meterWidth; j++)
+static uint32_t *__osd_bar_strip(OsdBar *bar, int page)
+{
+    return bar->fb + (size_t)page * bar->height * bar->width + bar->width - bar->meter_width;
+}
+
+/**
+ * @brief Sets up the compositor for a framebuffer of `pages` pages.
+ *
+ * @return false The save buffer couldn't be allocated
+ */
+bool osd_bar_init(OsdBar *bar, uint32_t *fb, int width, int height, int pages, int meter_width)
+{
+    memset(bar, 0, sizeof(OsdBar));
+    bar->fb = fb;
+    bar->width = width;
+    bar->height = height;
+    bar->pages = pages > OSD_BAR_PAGES ? OSD_BAR_PAGES : pages;
+    bar->meter_width = meter_width > width ? width : meter_width;
+    bar->saved = (uint32_t *)malloc((size_t)bar->meter_width * height * bar->pages * sizeof(uint32_t));
+    return bar->saved != NULL;
+}
+
+static void __osd_bar_save(OsdBar *bar, int page)
+{
+    uint32_t *ofs = __osd_bar_strip(bar, page);
+    uint32_t *ofss = bar->saved + (size_t)page * bar->height * bar->meter_width;
+
+    for (int i = 0; i < bar->height; i++, ofs += bar->width, ofss += bar->meter_width)
+        memcpy(ofss, ofs, bar->meter_width * sizeof(uint32_t));
+}
+
+static void __osd_bar_draw(OsdBar *bar, int page, uint64_t state)
+{
+    uint32_t *ofs = __osd_bar_strip(bar, page);
+
+    for (int i = 0; i < bar->height; i++, ofs += bar->width) {
+        uint32_t curr = __osd_bar_pixel(state, i, bar->height);
+        for (int j = 0; j < bar->meter_width; j++)
             ofs[j] = curr;
     }
-#endif
+    bar->drawn_pages |= 1 << page;
+    bar->drawn[page] = state;
+    bar->draw_count++;
 }
 
-void _bar_restoreBufferBehind(void)
+// Whether the bar drawn on `page` is still there (probes a few rows, and
+// the edge of the filled part): after a flip the page may have been
+// redrawn by the app, or the app may have drawn over the strip
+static bool __osd_bar_isIntact(OsdBar *bar, int page)
 {
-#ifdef PLATFORM_MIYOOMINI
-    _bar_value = 0;
-    _bar_max = 0;
-    _bar_color = 0;
-    _print_bar();
-    if (_bar_savebuf) {
-        uint32_t i, j, *ofs = fb_addr, *ofss = _bar_savebuf;
-        ofs += RENDER_WIDTH - meterWidth;
-        ofss += RENDER_WIDTH - meterWidth;
-        for (i = 0; i < RENDER_HEIGHT; i++, ofs += RENDER_WIDTH, ofss += RENDER_WIDTH) {
-            for (j = 0; j < meterWidth; j++)
-                ofs[j] = ofss[j];
-        }
-        free(_bar_savebuf);
-        _bar_savebuf = NULL;
+    uint32_t *strip = __osd_bar_strip(bar, page);
+    uint64_t state = bar->drawn[page];
+    int value = state & 0xFFFF, value_max = (state >> 16) & 0xFFFF;
+    int filled = value_max > 0 ? value * bar->height / value_max : 0;
+    int rows[OSD_BAR_PROBES + 2];
+    int count = 0;
+
+    if (!(bar->drawn_pages & (1 << page)))
+        return false;
+
+    for (int i = 0; i < OSD_BAR_PROBES; i++)
+        rows[count++] = i * (bar->height - 1) / (OSD_BAR_PROBES - 1);
+    if (filled > 0 && filled <= bar->height)
+        rows[count++] = filled - 1;
+    if (filled < bar->height)
+        rows[count++] = filled;
+
+    for (int i = 0; i < count; i++) {
+        const uint32_t *row = strip + (size_t)rows[i] * bar->width;
+        uint32_t expected = __osd_bar_pixel(state, rows[i], bar->height);
+        if (row[0] != expected || row[bar->meter_width - 1] != expected)
+            return false;
     }
-#endif
+
+    return true;
 }
 
-void _bar_saveBufferBehind(void)
+/**
+ * @brief Shows `state` on the displayed `page`, drawing only if needed.
+ * When the bar isn't there anymore (the app redrew the page), what's
+ * behind it is saved again first.
+ *
+ * @return true The bar was drawn
+ */
+bool osd_bar_update(OsdBar *bar, int page, uint64_t state)
 {
-#ifdef PLATFORM_MIYOOMINI
-    // Save display area and clear
-    if ((_bar_savebuf = (uint32_t *)malloc(RENDER_WIDTH * RENDER_HEIGHT *
-                                           sizeof(uint32_t)))) {
-        uint32_t i, j, *ofs = fb_addr, *ofss = _bar_savebuf;
-        ofs += RENDER_WIDTH - meterWidth;
-        ofss += RENDER_WIDTH - meterWidth;
-        for (i = 0; i < RENDER_HEIGHT; i++, ofs += RENDER_WIDTH, ofss += RENDER_WIDTH) {
-            for (j = 0; j < meterWidth; j++)
-                ofss[j] = ofs[j];
-        }
+    if (page < 0 || page >= bar->pages)
+        page = 0;
+
+    if (!__osd_bar_isIntact(bar, page))
+        __osd_bar_save(bar, page);
+    else if (state == bar->drawn[page])
+        return false;
+
+    __osd_bar_draw(bar, page, state);
+    return true;
+}
+
+/**
+ * @brief Puts back what was behind the bar on the pages it's still on
+ * (pages the app redrew since are left alone), and frees the save buffer.
+ */
+void osd_bar_restore(OsdBar *bar)
+{
+    for (int page = 0; page < bar->pages && bar->saved != NULL; page++) {
+        if (!__osd_bar_isIntact(bar, page))
+            continue;
+        uint32_t *ofs = __osd_bar_strip(bar, page);
+        uint32_t *ofss = bar->saved + (size_t)page * bar->height * bar->meter_width;
+        for (int i = 0; i < bar->height; i++, ofs += bar->width, ofss += bar->meter_width)
+            memcpy(ofs, ofss, bar->meter_width * sizeof(uint32_t));
     }
-#endif
+    free(bar->saved);
+    bar->saved = NULL;
+    bar->drawn_pages = 0;
 }
 
 //
@@ -196,12 +302,23 @@ void _bar_saveBufferBehind(void)
 //
 static void *_osd_thread(void *_)
 {
-    while (getMilliseconds() - _bar_timer < 2000) {
-        _print_bar();
-        msleep(1);
+#ifdef PLATFORM_MIYOOMINI
+    struct fb_var_screeninfo var;
+
+    while (!__atomic_load_n(&_osd_stop, __ATOMIC_ACQUIRE) &&
+           getMilliseconds() - __atomic_load_n(&_bar_timer, __ATOMIC_ACQUIRE) < OSD_BAR_TIMEOUT) {
+        int page = 0;
+        if (ioctl(fb_fd, FBIOGET_VSCREENINFO, &var) == 0 && RENDER_HEIGHT > 0)
+            page = var.yoffset / RENDER_HEIGHT;
+        osd_bar_update(&_osd_bar, page, __atomic_load_n(&_bar_state, __ATOMIC_ACQUIRE));
+        msleep(OSD_BAR_POLL_MS);
     }
-    _bar_restoreBufferBehind();
-    osd_thread_active = false;
+    // From here, osd_showBar waits for this thread and starts a new one
+    __atomic_store_n(&osd_thread_active, false, __ATOMIC_RELEASE);
+    osd_bar_restore(&_osd_bar);
+#else
+    __atomic_store_n(&osd_thread_active, false, __ATOMIC_RELEASE);
+#endif
     return 0;
 }
 
@@ -214,30 +331,43 @@ static void *_osd_thread(void *_)
  */
 void osd_showBar(int value, int value_max, uint32_t color)
 {
-    _bar_timer = getMilliseconds();
-    _bar_value = value;
-    _bar_max = value_max;
-    _bar_color = color;
+    __atomic_store_n(&_bar_state, __osd_bar_pack(value, value_max, color), __ATOMIC_RELEASE);
+    __atomic_store_n(&_bar_timer, getMilliseconds(), __ATOMIC_RELEASE);
     osd_bar_activated = true;
 
+    if (__atomic_load_n(&osd_thread_active, __ATOMIC_ACQUIRE))
+        return;
+
+    // The last thread timed out on its own
+    if (_osd_thread_joinable) {
+        pthread_join(osd_pt, NULL);
+        _osd_thread_joinable = false;
+    }
+
     config_get("display/meterWidth", CONFIG_INT, &meterWidth);
 
-    if (osd_thread_active)
+#ifdef PLATFORM_MIYOOMINI
+    if (!osd_bar_init(&_osd_bar, fb_addr, RENDER_WIDTH, RENDER_HEIGHT, OSD_BAR_PAGES, meterWidth))
         return;
+#endif
 
-    _bar_saveBufferBehind();
-    pthread_create(&osd_pt, NULL, _osd_thread, _print_bar);
+    _osd_stop = 0;
     osd_thread_active = true;
+    if (pthread_create(&osd_pt, NULL, _osd_thread, NULL) == 0)
+        _osd_thread_joinable = true;
+    else
+        osd_thread_active = false;
 }
 
 void osd_hideBar(void)
 {
     osd_bar_activated = false;
-    if (!osd_thread_active)
+    if (!_osd_thread_joinable)
         return;
-    pthread_cancel(osd_pt);
+    // The thread restores the screen on its way out
+    __atomic_store_n(&_osd_stop, 1, __ATOMIC_RELEASE);
     pthread_join(osd_pt, NULL);
-    _bar_restoreBufferBehind();
+    _osd_thread_joinable = false;
     osd_thread_active = false;
 }
 
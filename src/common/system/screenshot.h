@@ -1,7 +1,8 @@
 #ifndef SCREENSHOT_H__
 #define SCREENSHOT_H__
 
-#include <png/png.h>
+#include <dirent.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -10,10 +11,52 @@
 #include "./state.h"
 #include "utils/file.h"
 #include "utils/hash.h"
+#include "utils/imageWriter.h"
 #include "utils/log.h"
 #include "utils/process.h"
 #include "utils/str.h"
 
+/**
+ * Screenshots are captured into one of two preallocated buffers (the game
+ * is only stopped for the copy) and encoded by a worker thread, so the
+ * caller of screenshot_recent() gets back to its input loop right away.
+ * romScreens are waited for, GameSwitcher reads them next. Frames are saved
+ * as RGB PNGs (the framebuffer has no alpha) through utils/imageWriter.h.
+ */
+
+#define SCREENSHOT_DIR "/mnt/SDCARD/Screenshots/"
+#define SCREENSHOT_MAX_INDEX 1000
+#define SCREENSHOT_BUFFERS 2
+
+// Fast zlib level and a cheap filter: ~3x faster than libpng's defaults
+// for a few % more bytes on screenshots
+#define SCREENSHOT_PNG_LEVEL 2
+#define SCREENSHOT_PNG_FILTER PNG_FILTER_UP
+
+typedef enum { SCREENSHOT_FREE, SCREENSHOT_QUEUED, SCREENSHOT_ENCODING } ScreenshotSlotState;
+
+typedef struct {
+    uint32_t *buffer; // DISPLAY_WIDTH * DISPLAY_HEIGHT pixels
+    size_t size;
+    ScreenshotSlotState state;
+    uint32_t seq; // queue order
+    char path[512];
+    int width; // render resolution at capture time
+    int height;
+    bool save_raw;
+} ScreenshotSlot;
+
+static ScreenshotSlot __screenshot_slots[SCREENSHOT_BUFFERS];
+static uint32_t __screenshot_seq = 0;
+static pthread_mutex_t __screenshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t __screenshot_cond = PTHREAD_COND_INITIALIZER;
+static bool __screenshot_worker_started = false;
+
+// Indices in use for the current file name prefix (one directory scan per
+// prefix, instead of probing each index)
+static char __screenshot_index_prefix[STR_MAX * 2];
+static bool __screenshot_index_used[SCREENSHOT_MAX_INDEX];
+
 bool __get_path_romscreen(char *path_out)
 {
     char filename[STR_MAX];
@@ -31,12 +74,84 @@ bool __get_path_romscreen(char *path_out)
     return false;
 }
 
+static void __screenshot_scanIndices(const char *prefix)
+{
+    const char *name_prefix = strrchr(prefix, '/') + 1;
+    size_t name_prefix_len = strlen(name_prefix);
+    char dir_path[STR_MAX * 2];
+    DIR *dp;
+    struct dirent *ep;
+    int index;
+    char tail[8];
+
+    memset(__screenshot_index_used, 0, sizeof(__screenshot_index_used));
+    strcpy(__screenshot_index_prefix, prefix);
+
+    strncpy(dir_path, prefix, name_prefix - prefix);
+    dir_path[name_prefix - prefix] = '\0';
+
+    if ((dp = opendir(dir_path)) == NULL)
+        return;
+
+    while ((ep = readdir(dp)) != NULL) {
+        // "<prefix>_NNN.png"
+        const char *name = ep->d_name;
+        if (strncmp(name, name_prefix, name_prefix_len) != 0 || strlen(name) != name_prefix_len + 8)
+            continue;
+        if (sscanf(name + name_prefix_len, "_%3d%4s", &index, tail) == 2 &&
+            strcmp(tail, ".png") == 0 && index >= 0 && index < SCREENSHOT_MAX_INDEX)
+            __screenshot_index_used[index] = true;
+    }
+
+    closedir(dp);
+}
+
+/**
+ * @brief Appends "_NNN.png" to `path_out` with the lowest free index for
+ * this prefix.
+ *
+ * @return false All indices are taken
+ */
+bool __screenshot_nextIndex(char *path_out)
+{
+    char *fnptr = path_out + strlen(path_out);
+    bool rescanned = false;
+
+    if (strcmp(path_out, __screenshot_index_prefix) != 0) {
+        __screenshot_scanIndices(path_out);
+        rescanned = true;
+    }
+
+    for (int i = 0; i < SCREENSHOT_MAX_INDEX; i++) {
+        if (__screenshot_index_used[i])
+            continue;
+        sprintf(fnptr, "_%03d.png", i);
+
+        // Written by something else since the scan
+        if (exists(path_out)) {
+            __screenshot_index_used[i] = true;
+            continue;
+        }
+
+        __screenshot_index_used[i] = true;
+        return true;
+    }
+
+    if (!rescanned) {
+        // Files may have been deleted since the scan
+        *fnptr = '\0';
+        __screenshot_index_prefix[0] = '\0';
+        return __screenshot_nextIndex(path_out);
+    }
+
+    return false;
+}
+
 bool __get_path_recent(char *path_out)
 {
     char *fnptr;
-    uint32_t i;
 
-    strcpy(path_out, "/mnt/SDCARD/Screenshots/");
+    strcpy(path_out, SCREENSHOT_DIR);
     fnptr = path_out + strlen(path_out);
 
     system_state_update();
@@ -71,102 +186,233 @@ bool __get_path_recent(char *path_out)
     if (!(*fnptr))
         strcat(path_out, "Screenshot");
 
-    fnptr = path_out + strlen(path_out);
-    for (i = 0; i < 1000; i++) {
-        sprintf(fnptr, "_%03d.png", i);
-        if (!exists(path_out))
-            break;
-    }
-
-    return i <= 999;
+    return __screenshot_nextIndex(path_out);
 }
 
-uint32_t *__screenshot_buffer(void)
+/**
+ * @brief Copies the displayed frame into `buffer` (DISPLAY_WIDTH *
+ * DISPLAY_HEIGHT pixels).
+ */
+void __screenshot_capture(uint32_t *buffer)
 {
-    size_t buffer_size = DISPLAY_WIDTH * DISPLAY_HEIGHT * sizeof(uint32_t);
-    uint32_t *buffer = (uint32_t *)malloc(buffer_size);
-
     ioctl(fb_fd, FBIOGET_VSCREENINFO, &vinfo);
-    memcpy(buffer, fb_addr + DISPLAY_WIDTH * vinfo.yoffset, buffer_size);
-
-    return buffer;
+    memcpy(buffer, fb_addr + DISPLAY_WIDTH * vinfo.yoffset,
+           DISPLAY_WIDTH * DISPLAY_HEIGHT * sizeof(uint32_t));
 }
 
 /**
- * @brief Screenshot (640x480x32bpp only, rotate180, png)
- * 
- * @param buffer pointer to the frame buffer
+ * @brief Screenshot (rotate180, RGB png)
+ *
+ * @param buffer captured frame
+ * @param width render width at capture time
+ * @param height render height at capture time
  * @param screenshot_path image file save path
  * @return true Screenshot was saved
  * @return false Screenshot was not saved
  */
-bool __screenshot_save(const uint32_t *buffer, const char *screenshot_path)
+bool __screenshot_save(const uint32_t *buffer, int width, int height, const char *screenshot_path)
 {
-    uint32_t *src;
-    uint32_t line_buffer[RENDER_WIDTH], x, y, pix;
+    ImageWriterOptions options = {
+        .format = IMAGE_PNG_RGB,
+        .png_level = SCREENSHOT_PNG_LEVEL,
+        .png_filters = SCREENSHOT_PNG_FILTER,
+        .rotate180 = true};
 
-    FILE *fp;
-    png_structp png_ptr;
-    png_infop info_ptr;
+    return image_write(screenshot_path, buffer, width, height, width * sizeof(uint32_t), &options);
+}
 
-    // make sure render resolution is up to date
-    display_getRenderResolution();
+/**
+ * @brief Saves the raw cache of a rom screen (see utils/rawImage.h) in the
+ * gameSwitcher's screen format, LZ4 compressed, so it can be shown without
+ * decoding the PNG.
+ *
+ * @param buffer captured frame
+ * @param width render width at capture time
+ * @param height render height at capture time
+ * @param screenshot_path path of the PNG that was just saved from `buffer`
+ * @return true Raw cache was saved
+ */
+bool __screenshot_save_raw(const uint32_t *buffer, int width, int height, const char *screenshot_path)
+{
+    ImageWriterOptions options = {
+        .format = IMAGE_RAW_LZ4,
+        .rotate180 = true};
 
-    if (!(fp = file_open_ensure_path(screenshot_path, "wb"))) {
-        return false;
+    return image_write(screenshot_path, buffer, width, height, width * sizeof(uint32_t), &options);
+}
+
+static void __screenshot_encode(ScreenshotSlot *slot)
+{
+    if (__screenshot_save(slot->buffer, slot->width, slot->height, slot->path) && slot->save_raw)
+        __screenshot_save_raw(slot->buffer, slot->width, slot->height, slot->path);
+}
+
+static void *__screenshot_worker(void *arg)
+{
+    pthread_mutex_lock(&__screenshot_mutex);
+
+    while (true) {
+        ScreenshotSlot *next = NULL;
+
+        for (int i = 0; i < SCREENSHOT_BUFFERS; i++) {
+            ScreenshotSlot *slot = &__screenshot_slots[i];
+            if (slot->state == SCREENSHOT_QUEUED && (next == NULL || (int32_t)(slot->seq - next->seq) < 0))
+                next = slot;
+        }
+
+        if (next == NULL) {
+            pthread_cond_wait(&__screenshot_cond, &__screenshot_mutex);
+            continue;
+        }
+
+        next->state = SCREENSHOT_ENCODING;
+        pthread_mutex_unlock(&__screenshot_mutex);
+
+        __screenshot_encode(next);
+
+        pthread_mutex_lock(&__screenshot_mutex);
+        next->state = SCREENSHOT_FREE;
+        pthread_cond_broadcast(&__screenshot_cond);
     }
 
-    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
-    info_ptr = png_create_info_struct(png_ptr);
+    return NULL;
+}
 
-    png_init_io(png_ptr, fp);
-    png_set_IHDR(png_ptr, info_ptr, RENDER_WIDTH, RENDER_HEIGHT, 8,
-                 PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE,
-                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-    png_write_info(png_ptr, info_ptr);
+/**
+ * @brief Takes a free capture buffer (allocated on first use), waiting for
+ * the worker if both are being encoded.
+ *
+ * @return ScreenshotSlot* NULL if the buffer can't be allocated
+ */
+static ScreenshotSlot *__screenshot_acquire(void)
+{
+    size_t size = DISPLAY_WIDTH * DISPLAY_HEIGHT * sizeof(uint32_t);
+    ScreenshotSlot *slot = NULL;
 
-    src = (uint32_t *)buffer + RENDER_WIDTH * RENDER_HEIGHT;
+    pthread_mutex_lock(&__screenshot_mutex);
 
-    for (y = 0; y < RENDER_HEIGHT; y++) {
-        for (x = 0; x < RENDER_WIDTH; x++) {
-            pix = *--src;
-            line_buffer[x] = 0xFF000000 | (pix & 0x0000FF00) | (pix & 0x00FF0000) >> 16 | (pix & 0x000000FF) << 16;
+    while (slot == NULL) {
+        for (int i = 0; i < SCREENSHOT_BUFFERS && slot == NULL; i++) {
+            if (__screenshot_slots[i].state == SCREENSHOT_FREE)
+                slot = &__screenshot_slots[i];
         }
-        png_write_row(png_ptr, (png_bytep)line_buffer);
+        if (slot == NULL)
+            pthread_cond_wait(&__screenshot_cond, &__screenshot_mutex);
     }
 
-    png_write_end(png_ptr, info_ptr);
-    png_destroy_write_struct(&png_ptr, &info_ptr);
+    // The display resolution may have changed
+    if (slot->size != size) {
+        free(slot->buffer);
+        slot->buffer = (uint32_t *)malloc(size);
+        slot->size = slot->buffer != NULL ? size : 0;
+    }
+    if (slot->buffer == NULL)
+        slot = NULL;
+    else
+        slot->state = SCREENSHOT_ENCODING; // reserved
 
-    fflush(fp);
-    fsync(fileno(fp));
-    fclose(fp);
+    pthread_mutex_unlock(&__screenshot_mutex);
+    return slot;
+}
 
-    return true;
+static void __screenshot_release(ScreenshotSlot *slot)
+{
+    pthread_mutex_lock(&__screenshot_mutex);
+    slot->state = SCREENSHOT_FREE;
+    pthread_cond_broadcast(&__screenshot_cond);
+    pthread_mutex_unlock(&__screenshot_mutex);
 }
 
-bool __screenshot_perform(bool(get_path)(char *), pid_t p_id)
+/**
+ * @brief Allocates both capture buffers and starts the encoder, so the
+ * first screenshot doesn't pay for it.
+ */
+void screenshot_init(void)
 {
-    bool retval = false;
-    char path[512];
-    uint32_t *buffer;
+    pthread_t thread;
+    ScreenshotSlot *slots[SCREENSHOT_BUFFERS];
+
+    for (int i = 0; i < SCREENSHOT_BUFFERS; i++)
+        slots[i] = __screenshot_acquire();
+    for (int i = 0; i < SCREENSHOT_BUFFERS; i++)
+        if (slots[i] != NULL)
+            __screenshot_release(slots[i]);
+
+    pthread_mutex_lock(&__screenshot_mutex);
+    if (!__screenshot_worker_started &&
+        pthread_create(&thread, NULL, __screenshot_worker, NULL) == 0) {
+        pthread_detach(thread);
+        __screenshot_worker_started = true;
+    }
+    pthread_mutex_unlock(&__screenshot_mutex);
+}
+
+/**
+ * @brief Waits until every queued screenshot is written.
+ */
+void screenshot_flush(void)
+{
+    pthread_mutex_lock(&__screenshot_mutex);
+    for (int i = 0; i < SCREENSHOT_BUFFERS; i++) {
+        while (__screenshot_slots[i].state != SCREENSHOT_FREE && __screenshot_worker_started)
+            pthread_cond_wait(&__screenshot_cond, &__screenshot_mutex);
+    }
+    pthread_mutex_unlock(&__screenshot_mutex);
+}
+
+/**
+ * @brief Captures the screen (stopping `p_id` during the copy) and queues
+ * it for encoding.
+ *
+ * @return true Screenshot was captured and queued (or, without a worker
+ * thread, saved)
+ */
+bool __screenshot_perform(bool(get_path)(char *), pid_t p_id, bool save_raw)
+{
+    ScreenshotSlot *slot;
+
+    if (!__screenshot_worker_started)
+        screenshot_init();
+
+    if ((slot = __screenshot_acquire()) == NULL)
+        return false;
 
     if (p_id != 0) {
         kill(p_id, SIGSTOP);
     }
 
-    buffer = __screenshot_buffer();
+    __screenshot_capture(slot->buffer);
 
     if (p_id != 0) {
         kill(p_id, SIGCONT);
     }
 
-    if (get_path(path)) {
-        retval = __screenshot_save(buffer, path);
+    // make sure render resolution is up to date
+    display_getRenderResolution();
+    slot->width = RENDER_WIDTH;
+    slot->height = RENDER_HEIGHT;
+    slot->save_raw = save_raw;
+
+    if (slot->width <= 0 || slot->height <= 0 ||
+        slot->width * slot->height * sizeof(uint32_t) > slot->size ||
+        !get_path(slot->path)) {
+        __screenshot_release(slot);
+        return false;
+    }
+
+    if (!__screenshot_worker_started) {
+        __screenshot_encode(slot);
+        __screenshot_release(slot);
+        return true;
     }
 
-    free(buffer);
-    return retval;
+    pthread_mutex_lock(&__screenshot_mutex);
+    slot->seq = __screenshot_seq++;
+    slot->state = SCREENSHOT_QUEUED;
+    pthread_cond_broadcast(&__screenshot_cond);
+    pthread_mutex_unlock(&__screenshot_mutex);
+
+    return true;
 }
 
 pid_t get_game_pid(void)
@@ -180,14 +426,22 @@ pid_t get_game_pid(void)
 
 bool screenshot_recent(void)
 {
-    return __screenshot_perform(__get_path_recent, get_game_pid());
+    return __screenshot_perform(__get_path_recent, get_game_pid(), false);
 }
 
+/**
+ * @brief Saves the romScreen of the running game. Callers switch to
+ * GameSwitcher or stop the game right after, so it returns once the PNG and
+ * its raw cache are written (only screenshot_recent() is left to the
+ * worker).
+ */
 bool screenshot_system(void)
 {
     pid_t p_id = get_game_pid();
     if (p_id != 0) {
-        return __screenshot_perform(__get_path_romscreen, p_id);
+        bool retval = __screenshot_perform(__get_path_romscreen, p_id, true);
+        screenshot_flush();
+        return retval;
     }
     return false;
 }
@@ -245,6 +245,8 @@ void settings_load(void)
 
     _settings_clone(&__settings, &settings);
 
+    config_store_save();
+
     settings_loaded = true;
 }
 
@@ -361,11 +363,13 @@ void settings_save(void)
 
     config_setNumber("pwmfrequency", settings.pwmfrequency);
     // remove deprecated flags
-    remove(CONFIG_PATH ".noLowBatteryAutoSave");
-    remove(CONFIG_PATH ".noBatteryWarning");
-    remove(CONFIG_PATH ".noVibration");
-    remove(CONFIG_PATH ".menuInverted");
-    remove(CONFIG_PATH ".noGameSwitcher");
+    config_store_setFlag(".noLowBatteryAutoSave", false);
+    config_store_setFlag(".noBatteryWarning", false);
+    config_store_setFlag(".noVibration", false);
+    config_store_setFlag(".menuInverted", false);
+    config_store_setFlag(".noGameSwitcher", false);
+
+    config_store_save();
 
     _settings_save_keymap();
     _settings_save_mainui();
@@ -0,0 +1,288 @@
+#ifndef SYSTEM_SHARED_STATE_H__
+#define SYSTEM_SHARED_STATE_H__
+
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+
+#include "utils/file.h"
+#include "utils/flags.h"
+#include "utils/log.h"
+#include "utils/str.h"
+
+/**
+ * Shared system state: a SysV shared memory segment (like the KeyShmInfo
+ * settings segment) carrying the state the processes used to exchange
+ * through /tmp files. Reads are lock-free and consistent (seqlock: the
+ * sequence number is odd while a writer updates the segment, readers retry
+ * if it changed under them).
+ *
+ * The layout is versioned through the segment key, so binaries built with
+ * a different layout never share a segment. Fields that were not published
+ * yet (or when shared memory is unavailable) are read from the legacy files,
+ * and with `shared_state_compat` set the writers keep updating those files
+ * for the scripts and MainUI.
+ */
+
+#define SHARED_STATE_VERSION 1
+#define SHARED_STATE_KEY (0x4f535400 | SHARED_STATE_VERSION) // 'O','S','T',version
+#define SHARED_STATE_ROM_MAX 256
+#define SHARED_STATE_MAX_RETRIES 10000
+
+#define SHARED_STATE_PERCBAT_PATH "/tmp/percBat"
+
+typedef enum {
+    SHARED_FIELD_BATTERY = 1 << 0,
+    SHARED_FIELD_SYSTEM_STATE = 1 << 1,
+    SHARED_FIELD_ROM = 1 << 2
+} SharedStateField;
+
+typedef enum {
+    SHARED_FLAG_BATTERY_DISPLAY = 1 << 0, // the UI draws the battery (/tmp/hasBatteryDisplay)
+    SHARED_FLAG_LOW_BATTERY = 1 << 1      // quit on low battery (/tmp/.lowBat)
+} SharedStateFlag;
+
+typedef struct {
+    uint32_t published;     // SharedStateField mask of the fields set so far
+    int battery_percentage; // as in /tmp/percBat (500: charging)
+    bool charging;          //
+    int system_state;       // SystemState
+    uint32_t flags;         // SharedStateFlag values
+    uint32_t flags_known;   // flags that were set or cleared so far
+    char current_rom[SHARED_STATE_ROM_MAX];
+} SharedState;
+
+typedef struct {
+    uint32_t seq;
+    SharedState state;
+} SharedStateSegment;
+
+static key_t shared_state_key = SHARED_STATE_KEY;
+static bool shared_state_compat = true;
+static SharedStateSegment *__shared_state = NULL;
+static bool __shared_state_failed = false;
+
+static const char *__shared_state_flag_files[] = {"hasBatteryDisplay", ".lowBat"};
+
+/**
+ * @brief Attaches the segment (creating it, zeroed, if needed).
+ *
+ * @return true Shared memory is available
+ */
+bool shared_state_attach(void)
+{
+    if (__shared_state != NULL)
+        return true;
+    if (__shared_state_failed)
+        return false;
+
+    int id = shmget(shared_state_key, sizeof(SharedStateSegment), IPC_CREAT | 0666);
+    void *addr = id != -1 ? shmat(id, NULL, 0) : (void *)-1;
+
+    if (addr == (void *)-1) {
+        print_debug("shared_state: shared memory unavailable, using files");
+        __shared_state_failed = true;
+        return false;
+    }
+
+    __shared_state = (SharedStateSegment *)addr;
+    return true;
+}
+
+/**
+ * @brief Detaches the segment, and removes it if `destroy` is set.
+ */
+void shared_state_detach(bool destroy)
+{
+    if (__shared_state != NULL) {
+        shmdt(__shared_state);
+        __shared_state = NULL;
+    }
+    if (destroy) {
+        int id = shmget(shared_state_key, 0, 0);
+        if (id != -1)
+            shmctl(id, IPC_RMID, NULL);
+    }
+    __shared_state_failed = false;
+}
+
+/**
+ * @brief Takes a consistent copy of the state.
+ *
+ * @return false Shared memory is unavailable, or a writer held the segment
+ * for too long
+ */
+bool shared_state_read(SharedState *out)
+{
+    if (!shared_state_attach())
+        return false;
+
+    for (int retry = 0; retry < SHARED_STATE_MAX_RETRIES; retry++) {
+        uint32_t seq = __atomic_load_n(&__shared_state->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+
+        memcpy(out, (const void *)&__shared_state->state, sizeof(SharedState));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&__shared_state->seq, __ATOMIC_RELAXED) == seq)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Starts an update: waits for other writers and makes the sequence
+ * number odd. A segment that stays locked (its writer died mid-update) is
+ * taken over.
+ *
+ * @return uint32_t The (odd) sequence number to pass to
+ * __shared_state_end()
+ */
+static uint32_t __shared_state_begin(void)
+{
+    uint32_t seq;
+
+    for (int retry = 0;; retry++) {
+        seq = __atomic_load_n(&__shared_state->seq, __ATOMIC_RELAXED);
+        if ((seq & 1) && retry < SHARED_STATE_MAX_RETRIES) {
+            sched_yield();
+            continue;
+        }
+        uint32_t locked = (seq & 1) ? seq + 2 : seq + 1;
+        if (__atomic_compare_exchange_n(&__shared_state->seq, &seq, locked, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            return locked;
+        }
+    }
+}
+
+static void __shared_state_end(uint32_t locked)
+{
+    __atomic_store_n(&__shared_state->seq, locked + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Rewrites the compat battery file when its contents differ (it may
+ * have been edited or removed by someone else since the last update).
+ */
+static void __shared_state_syncBattery(int percentage)
+{
+    FILE *fp;
+    int current = -1;
+
+    if (percentage == -1) {
+        if (exists(SHARED_STATE_PERCBAT_PATH))
+            remove(SHARED_STATE_PERCBAT_PATH);
+        return;
+    }
+
+    file_get(fp, SHARED_STATE_PERCBAT_PATH, "%d", &current);
+    if (current != percentage)
+        file_put_sync(fp, SHARED_STATE_PERCBAT_PATH, "%d", percentage);
+}
+
+/**
+ * @brief Publishes the battery level (-1 withdraws it).
+ */
+void shared_state_setBattery(int percentage, bool charging)
+{
+    if (shared_state_attach()) {
+        uint32_t locked = __shared_state_begin();
+        SharedState *state = &__shared_state->state;
+        state->battery_percentage = percentage;
+        state->charging = charging;
+        if (percentage == -1)
+            state->published &= ~SHARED_FIELD_BATTERY;
+        else
+            state->published |= SHARED_FIELD_BATTERY;
+        __shared_state_end(locked);
+    }
+
+    if (shared_state_compat)
+        __shared_state_syncBattery(percentage);
+}
+
+void shared_state_setSystemState(int system_state)
+{
+    if (!shared_state_attach())
+        return;
+    uint32_t locked = __shared_state_begin();
+    __shared_state->state.system_state = system_state;
+    __shared_state->state.published |= SHARED_FIELD_SYSTEM_STATE;
+    __shared_state_end(locked);
+}
+
+void shared_state_setRom(const char *rom_path)
+{
+    if (!shared_state_attach())
+        return;
+    uint32_t locked = __shared_state_begin();
+    strncpy(__shared_state->state.current_rom, rom_path, SHARED_STATE_ROM_MAX - 1);
+    __shared_state->state.current_rom[SHARED_STATE_ROM_MAX - 1] = '\0';
+    __shared_state->state.published |= SHARED_FIELD_ROM;
+    __shared_state_end(locked);
+}
+
+static const char *__shared_state_flagFile(SharedStateFlag flag)
+{
+    for (size_t i = 0; i < sizeof(__shared_state_flag_files) / sizeof(char *); i++) {
+        if ((unsigned)flag == 1u << i)
+            return __shared_state_flag_files[i];
+    }
+    return NULL;
+}
+
+void shared_state_setFlag(SharedStateFlag flag, bool value)
+{
+    if (shared_state_attach()) {
+        uint32_t locked = __shared_state_begin();
+        SharedState *state = &__shared_state->state;
+        if (value)
+            state->flags |= flag;
+        else
+            state->flags &= ~flag;
+        state->flags_known |= flag;
+        __shared_state_end(locked);
+    }
+
+    // Compared against the file itself, it may have been changed externally
+    const char *file = __shared_state_flagFile(flag);
+    if (shared_state_compat && file != NULL && temp_flag_get(file) != value)
+        temp_flag_set(file, value);
+}
+
+/**
+ * @brief Battery percentage as published by batmon (500: charging).
+ *
+ * @return int -1 if not published
+ */
+int shared_state_getBatteryPercentage(bool *charging_out)
+{
+    SharedState state;
+    if (!shared_state_read(&state) || !(state.published & SHARED_FIELD_BATTERY))
+        return -1;
+    if (charging_out != NULL)
+        *charging_out = state.charging;
+    return state.battery_percentage;
+}
+
+bool shared_state_getFlag(SharedStateFlag flag)
+{
+    SharedState state;
+    if (shared_state_read(&state) && (state.flags_known & flag))
+        return (state.flags & flag) != 0;
+
+    const char *file = __shared_state_flagFile(flag);
+    return file != NULL && temp_flag_get(file);
+}
+
+#endif // SYSTEM_SHARED_STATE_H__
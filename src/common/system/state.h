@@ -10,6 +10,7 @@
 
 #include "./display.h"
 #include "./settings.h"
+#include "./shared_state.h"
 
 typedef enum system_state_e {
     MODE_UNKNOWN,
@@ -82,6 +83,31 @@ bool check_isDrastic(void)
     return false;
 }
 
+/**
+ * @brief Publishes the ROM of the running game: the last quoted argument of
+ * the command to run.
+ */
+static void __system_state_publishRom(void)
+{
+    char rom[SHARED_STATE_ROM_MAX] = "";
+
+    if (system_state == MODE_GAME || system_state == MODE_DRASTIC) {
+        const char *cmd = file_read(CMD_TO_RUN_PATH);
+        const char *end = cmd != NULL ? strrchr(cmd, '"') : NULL;
+        const char *start = end;
+
+        while (start != NULL && start > cmd && *(start - 1) != '"')
+            start--;
+        if (start != NULL && start > cmd && end - start < SHARED_STATE_ROM_MAX) {
+            memcpy(rom, start, end - start);
+            rom[end - start] = '\0';
+        }
+        free((void *)cmd);
+    }
+
+    shared_state_setRom(rom);
+}
+
 void system_state_update(void)
 {
     if (check_isGameSwitcher())
@@ -97,6 +123,9 @@ void system_state_update(void)
     else
         system_state = MODE_APPS;
 
+    shared_state_setSystemState(system_state);
+    __system_state_publishRom();
+
 #ifdef LOG_DEBUG
     switch (system_state) {
     case MODE_MAIN_UI:
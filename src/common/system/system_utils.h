@@ -22,6 +22,7 @@ void kill_mainUI(void)
     if (system_state == MODE_MAIN_UI) {
         settings_shm_read();
         kill(system_state_pid, SIGKILL);
+        process_snapshot_invalidate();
         display_reset();
     }
 }
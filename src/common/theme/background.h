@@ -12,8 +12,14 @@
 void theme_backgroundLoad(void)
 {
     char theme_path[STR_MAX];
-    resources.background =
-        rotate180(theme_loadImage(theme_getPath(theme_path), "background"));
+    const ThemeBundleEntry *entry = theme_findBundled(
+        theme_getPath(theme_path), "background" THEME_BUNDLE_ROTATED_SUFFIX);
+
+    if (entry != NULL)
+        resources.background = theme_bundle_surface(entry);
+    else
+        resources.background =
+            rotate180(theme_loadImage(theme_path, "background"));
     resources._background_loaded = true;
 }
 
@@ -0,0 +1,352 @@
+#ifndef THEME_BUNDLE_H__
+#define THEME_BUNDLE_H__
+
+#include <SDL/SDL.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "utils/str.h"
+
+/**
+ * Theme bundle: the theme images (overrides resolved, decoded, and the
+ * background already rotated) packed in a single file with an index, built
+ * by theme_compile() when a theme is installed. It is mmapped and its
+ * surfaces point into the mapping, so loading an image costs no file
+ * probing and no PNG decoding.
+ *
+ * The bundle is only used for the theme it was built for, while the
+ * directories images are looked up in list the same images (see
+ * theme_getImageDirSignatures, hidden files don't count), and while every
+ * source file has the mtime and size recorded at build time.
+ */
+
+#define THEME_BUNDLE_PATH "/mnt/SDCARD/.tmp_update/theme.bundle"
+#define THEME_BUNDLE_MAGIC 0x4e42544f // "OTBN"
+#define THEME_BUNDLE_VERSION 2
+#define THEME_BUNDLE_NAME_MAX 48
+#define THEME_BUNDLE_DIRS 4
+#define THEME_BUNDLE_ROTATED_SUFFIX "@180"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    char theme_path[STR_MAX];
+    uint32_t dir_signatures[THEME_BUNDLE_DIRS];
+    uint32_t count;
+    uint32_t size; // of the whole file
+} ThemeBundleHeader;
+
+typedef struct {
+    char name[THEME_BUNDLE_NAME_MAX]; // image name, with a suffix for variants
+    int32_t location;                 // as returned by theme_getImagePath()
+    uint32_t offset;                  // of the pixels, 0 if the image failed to load
+    uint16_t width;
+    uint16_t height;
+    uint16_t pitch;
+    uint8_t bpp;
+    uint8_t alpha;
+    uint32_t rmask;
+    uint32_t gmask;
+    uint32_t bmask;
+    uint32_t amask;
+    uint32_t flags; // SDL_SRCALPHA, SDL_SRCCOLORKEY
+    uint32_t colorkey;
+    uint32_t palette_offset;
+    uint32_t ncolors;
+    char source[STR_MAX]; // image file it was decoded from
+    int64_t source_mtime; // -1 if it was missing
+    int64_t source_size;
+} ThemeBundleEntry;
+
+static char *__theme_bundle_map = NULL;
+static size_t __theme_bundle_map_size = 0;
+static bool __theme_bundle_tried = false; // open was attempted (see theme_bundle_close)
+
+static bool __theme_bundle_samePath(const char *a, const char *b)
+{
+    size_t len_a = strlen(a), len_b = strlen(b);
+    if (len_a > 0 && a[len_a - 1] == '/')
+        len_a--;
+    if (len_b > 0 && b[len_b - 1] == '/')
+        len_b--;
+    return len_a == len_b && strncmp(a, b, len_a) == 0;
+}
+
+static void __theme_bundle_statSource(const char *path, int64_t *mtime_out, int64_t *size_out)
+{
+    struct stat st;
+
+    if (stat(path, &st) == 0) {
+        *mtime_out = (int64_t)st.st_mtime;
+        *size_out = (int64_t)st.st_size;
+    }
+    else {
+        *mtime_out = -1;
+        *size_out = -1;
+    }
+}
+
+/**
+ * @brief Whether the images were overwritten (in place, which directory
+ * mtimes don't show) since the bundle was built.
+ */
+static bool __theme_bundle_sourcesChanged(const ThemeBundleEntry *entries, uint32_t count)
+{
+    int64_t mtime, size;
+
+    for (uint32_t i = 0; i < count; i++) {
+        __theme_bundle_statSource(entries[i].source, &mtime, &size);
+        if (mtime != entries[i].source_mtime || size != entries[i].source_size)
+            return true;
+    }
+
+    return false;
+}
+
+void theme_bundle_close(void)
+{
+    if (__theme_bundle_map != NULL)
+        munmap(__theme_bundle_map, __theme_bundle_map_size);
+    __theme_bundle_map = NULL;
+    __theme_bundle_map_size = 0;
+    __theme_bundle_tried = false;
+}
+
+/**
+ * @brief Whether the bundle of `theme_path` is mapped.
+ */
+bool theme_bundle_isOpen(const char *theme_path)
+{
+    if (__theme_bundle_map == NULL)
+        return false;
+    const ThemeBundleHeader *header = (const ThemeBundleHeader *)__theme_bundle_map;
+    return __theme_bundle_samePath(header->theme_path, theme_path);
+}
+
+/**
+ * @brief Maps the bundle if it was built for `theme_path`, the lookup
+ * directories still have the signatures it was built with, and none of its
+ * source files changed.
+ *
+ * @return true The bundle is mapped
+ */
+bool theme_bundle_open(const char *theme_path, const uint32_t dir_signatures[THEME_BUNDLE_DIRS])
+{
+    if (__theme_bundle_map != NULL)
+        return theme_bundle_isOpen(theme_path);
+    __theme_bundle_tried = true;
+
+    int fd = open(THEME_BUNDLE_PATH, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+
+    if (fd == -1)
+        return false;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ThemeBundleHeader)) {
+        close(fd);
+        return false;
+    }
+
+    // Copy-on-write: the surfaces' pixels may be modified in memory
+    void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    const ThemeBundleHeader *header = (const ThemeBundleHeader *)map;
+
+    if (header->magic != THEME_BUNDLE_MAGIC ||
+        header->version != THEME_BUNDLE_VERSION ||
+        header->size != (uint32_t)st.st_size ||
+        sizeof(ThemeBundleHeader) + header->count * sizeof(ThemeBundleEntry) > (size_t)st.st_size ||
+        !__theme_bundle_samePath(header->theme_path, theme_path) ||
+        memcmp(header->dir_signatures, dir_signatures, sizeof(header->dir_signatures)) != 0 ||
+        __theme_bundle_sourcesChanged((const ThemeBundleEntry *)(header + 1), header->count)) {
+        print_debug("Theme bundle missing or out of date");
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    __theme_bundle_map = (char *)map;
+    __theme_bundle_map_size = st.st_size;
+    return true;
+}
+
+/**
+ * @brief Finds an image in the mapped bundle, if it is the bundle of
+ * `theme_path`.
+ *
+ * @return const ThemeBundleEntry* NULL if no bundle is mapped, or it
+ * doesn't contain the image
+ */
+const ThemeBundleEntry *theme_bundle_find(const char *theme_path, const char *name)
+{
+    if (!theme_bundle_isOpen(theme_path))
+        return NULL;
+
+    const ThemeBundleHeader *header = (const ThemeBundleHeader *)__theme_bundle_map;
+    const ThemeBundleEntry *entries = (const ThemeBundleEntry *)(header + 1);
+
+    for (uint32_t i = 0; i < header->count; i++) {
+        if (strncmp(entries[i].name, name, THEME_BUNDLE_NAME_MAX) == 0)
+            return &entries[i];
+    }
+
+    return NULL;
+}
+
+static uint32_t __theme_bundle_align(uint32_t offset)
+{
+    return (offset + 15) & ~15u;
+}
+
+/**
+ * @brief Writes the bundle (atomically, via rename). `surfaces[i]` may be
+ * NULL for images that failed to load; `locations[i]` is where
+ * theme_getImagePath() found `names[i]`, `sources[i]` the file it was
+ * decoded from.
+ *
+ * @return true The bundle was written
+ */
+bool theme_bundle_write(const char *theme_path, const uint32_t dir_signatures[THEME_BUNDLE_DIRS],
+                        const char **names, const char **sources, const int *locations,
+                        SDL_Surface **surfaces, int count)
+{
+    char tmp_path[STR_MAX];
+    ThemeBundleHeader header;
+    ThemeBundleEntry *entries = (ThemeBundleEntry *)calloc(count, sizeof(ThemeBundleEntry));
+    uint32_t offset = sizeof(ThemeBundleHeader) + count * sizeof(ThemeBundleEntry);
+    bool ok = true;
+
+    if (entries == NULL)
+        return false;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = THEME_BUNDLE_MAGIC;
+    header.version = THEME_BUNDLE_VERSION;
+    strncpy(header.theme_path, theme_path, STR_MAX - 1);
+    memcpy(header.dir_signatures, dir_signatures, sizeof(header.dir_signatures));
+    header.count = count;
+
+    // Layout: header, index, then each image's palette and pixels
+    for (int i = 0; i < count; i++) {
+        ThemeBundleEntry *entry = &entries[i];
+        SDL_Surface *surface = surfaces[i];
+
+        strncpy(entry->name, names[i], THEME_BUNDLE_NAME_MAX - 1);
+        strncpy(entry->source, sources[i], STR_MAX - 1);
+        __theme_bundle_statSource(entry->source, &entry->source_mtime, &entry->source_size);
+        entry->location = locations[i];
+
+        if (surface == NULL)
+            continue;
+
+        SDL_PixelFormat *format = surface->format;
+        entry->width = surface->w;
+        entry->height = surface->h;
+        entry->pitch = surface->pitch;
+        entry->bpp = format->BitsPerPixel;
+        entry->alpha = format->alpha;
+        entry->rmask = format->Rmask;
+        entry->gmask = format->Gmask;
+        entry->bmask = format->Bmask;
+        entry->amask = format->Amask;
+        entry->flags = surface->flags & (SDL_SRCALPHA | SDL_SRCCOLORKEY);
+        entry->colorkey = format->colorkey;
+
+        if (format->palette != NULL) {
+            entry->ncolors = format->palette->ncolors;
+            entry->palette_offset = offset;
+            offset += entry->ncolors * sizeof(SDL_Color);
+        }
+
+        offset = __theme_bundle_align(offset);
+        entry->offset = offset;
+        offset += (uint32_t)surface->pitch * surface->h;
+    }
+    header.size = offset;
+
+    snprintf(tmp_path, STR_MAX, "%s.tmp", THEME_BUNDLE_PATH);
+    FILE *fp = fopen(tmp_path, "wb");
+
+    if (fp == NULL) {
+        free(entries);
+        return false;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+         fwrite(entries, sizeof(ThemeBundleEntry), count, fp) == (size_t)count;
+
+    for (int i = 0; ok && i < count; i++) {
+        ThemeBundleEntry *entry = &entries[i];
+        SDL_Surface *surface = surfaces[i];
+
+        if (surface == NULL)
+            continue;
+
+        if (entry->ncolors > 0) {
+            ok = fseek(fp, entry->palette_offset, SEEK_SET) == 0 &&
+                 fwrite(surface->format->palette->colors, sizeof(SDL_Color), entry->ncolors, fp) == entry->ncolors;
+        }
+
+        size_t data_size = (size_t)entry->pitch * entry->height;
+        SDL_LockSurface(surface);
+        ok = ok && fseek(fp, entry->offset, SEEK_SET) == 0 &&
+             fwrite(surface->pixels, 1, data_size, fp) == data_size;
+        SDL_UnlockSurface(surface);
+    }
+
+    fflush(fp);
+    fsync(fileno(fp));
+    fclose(fp);
+    free(entries);
+
+    if (!ok || rename(tmp_path, THEME_BUNDLE_PATH) != 0) {
+        remove(tmp_path);
+        print_debug("Error writing theme bundle");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Creates a surface for a bundle image; its pixels stay in the
+ * mapping, so it must be freed before theme_bundle_close().
+ *
+ * @return SDL_Surface* NULL if the image failed to load when the bundle was
+ * built
+ */
+SDL_Surface *theme_bundle_surface(const ThemeBundleEntry *entry)
+{
+    if (entry->offset == 0 ||
+        entry->offset + (size_t)entry->pitch * entry->height > __theme_bundle_map_size)
+        return NULL;
+
+    SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(
+        __theme_bundle_map + entry->offset, entry->width, entry->height,
+        entry->bpp, entry->pitch, entry->rmask, entry->gmask, entry->bmask,
+        entry->amask);
+
+    if (surface == NULL)
+        return NULL;
+
+    if (entry->ncolors > 0 && entry->palette_offset + entry->ncolors * sizeof(SDL_Color) <= __theme_bundle_map_size)
+        SDL_SetColors(surface, (SDL_Color *)(__theme_bundle_map + entry->palette_offset), 0, entry->ncolors);
+    if (entry->flags & SDL_SRCCOLORKEY)
+        SDL_SetColorKey(surface, SDL_SRCCOLORKEY, entry->colorkey);
+    SDL_SetAlpha(surface, entry->flags & SDL_SRCALPHA, entry->alpha);
+
+    return surface;
+}
+
+#endif // THEME_BUNDLE_H__
@@ -0,0 +1,81 @@
+#ifndef THEME_COMPILE_H__
+#define THEME_COMPILE_H__
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_image.h>
+#include <stdbool.h>
+
+#include "utils/log.h"
+#include "utils/rotate180.h"
+
+#include "./bundle.h"
+#include "./load.h"
+
+// The images loaded through resources.h (see _loadImage)
+static const char *theme_compile_images[] = {
+    "bg-title", "miyoo-topbar", "power-0%-icon", "power-20%-icon",
+    "power-50%-icon", "power-80%-icon", "power-full-icon",
+    "power-full-icon_back", "ic-power-charge-100%", "bg-list-s", "bg-list-l",
+    "div-line-h", "progress-dot", "extra/toggle-on", "extra/toggle-off",
+    "tips-bar-bg", "icon-A-54", "icon-B-54", "icon-left-arrow-24",
+    "icon-right-arrow-24", "extra/arrowLeft", "extra/arrowRight", "pop-bg",
+    "Empty", "preview-bg", "extra/lum0", "extra/lum1", "extra/lum2",
+    "extra/lum3", "extra/lum4", "extra/lum5", "extra/lum6", "extra/lum7",
+    "extra/lum8", "extra/lum9", "extra/lum10", "extra/gs-legend",
+    "background" THEME_BUNDLE_ROTATED_SUFFIX};
+
+#define THEME_COMPILE_COUNT \
+    (int)(sizeof(theme_compile_images) / sizeof(theme_compile_images[0]))
+
+/**
+ * @brief Builds the theme bundle of `theme_path`: resolves each image
+ * (overrides, theme, fallbacks), decodes it, and rotates the background.
+ * Run when the theme or its overrides change.
+ *
+ * @return true The bundle was written
+ */
+bool theme_compile(const char *theme_path)
+{
+    SDL_Surface *surfaces[THEME_COMPILE_COUNT];
+    int locations[THEME_COMPILE_COUNT];
+    char sources[THEME_COMPILE_COUNT][STR_MAX * 2];
+    const char *source_paths[THEME_COMPILE_COUNT];
+    uint32_t signatures[THEME_BUNDLE_DIRS];
+    char name[THEME_BUNDLE_NAME_MAX];
+    size_t suffix_len = strlen(THEME_BUNDLE_ROTATED_SUFFIX);
+
+    theme_getImageDirSignatures(theme_path, signatures);
+
+    for (int i = 0; i < THEME_COMPILE_COUNT; i++) {
+        const char *image = theme_compile_images[i];
+        size_t len = strlen(image);
+        bool rotated = len > suffix_len &&
+                       strcmp(image + len - suffix_len, THEME_BUNDLE_ROTATED_SUFFIX) == 0;
+
+        strncpy(name, image, THEME_BUNDLE_NAME_MAX - 1);
+        name[THEME_BUNDLE_NAME_MAX - 1] = '\0';
+        if (rotated)
+            name[len - suffix_len] = '\0';
+
+        // Asking for the path resolves from the files, never the bundle
+        // (which may be mapped, and is replaced with rename)
+        locations[i] = theme_getImagePath(theme_path, name, sources[i]);
+        source_paths[i] = sources[i];
+        surfaces[i] = IMG_Load(sources[i]);
+
+        if (rotated && surfaces[i] != NULL)
+            surfaces[i] = rotate180(surfaces[i]);
+    }
+
+    bool success = theme_bundle_write(theme_path, signatures, theme_compile_images,
+                                      source_paths, locations, surfaces, THEME_COMPILE_COUNT);
+
+    for (int i = 0; i < THEME_COMPILE_COUNT; i++)
+        if (surfaces[i] != NULL)
+            SDL_FreeSurface(surfaces[i]);
+
+    printf_debug("Theme bundle %s for %s\n", success ? "written" : "not written", theme_path);
+    return success;
+}
+
+#endif // THEME_COMPILE_H__
@@ -4,10 +4,14 @@
 #include <SDL/SDL.h>
 #include <SDL/SDL_image.h>
 #include <SDL/SDL_ttf.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include "utils/file.h"
 #include "utils/str.h"
 
+#include "./bundle.h"
+
 #define SYSTEM_CONFIG "/mnt/SDCARD/system.json"
 #define FALLBACK_FONT "/customer/app/Exo-2-Bold-Italic.ttf"
 #define FALLBACK_PATH "/mnt/SDCARD/miyoo/app/"
@@ -15,8 +19,70 @@
 #define THEME_OVERRIDES "/mnt/SDCARD/Saves/CurrentProfile/theme"
 #define FALLBACK_THEME_PATH "/mnt/SDCARD/miyoo/app/"
 
+/**
+ * @brief Signatures of the file names in the directories
+ * theme_getImagePath() looks in (0 if missing). Adding or removing an image
+ * changes them, which makes the theme bundle out of date. Hidden files are
+ * left out: the system writes some into skin/ (e.g. .batt-perc.png).
+ */
+void theme_getImageDirSignatures(const char *theme_path, uint32_t signatures_out[THEME_BUNDLE_DIRS])
+{
+    char dirs[THEME_BUNDLE_DIRS][STR_MAX * 2];
+    DIR *dp;
+    struct dirent *ep;
+
+    snprintf(dirs[0], STR_MAX * 2, THEME_OVERRIDES "/skin");
+    snprintf(dirs[1], STR_MAX * 2, "%sskin", theme_path);
+    snprintf(dirs[2], STR_MAX * 2, FALLBACK_PATH "skin");
+    snprintf(dirs[3], STR_MAX * 2, SYSTEM_RESOURCES);
+
+    for (int i = 0; i < THEME_BUNDLE_DIRS; i++) {
+        signatures_out[i] = 0;
+
+        if ((dp = opendir(dirs[i])) == NULL)
+            continue;
+
+        // Order independent: listing order isn't stable
+        uint32_t sum = 0, count = 0;
+        while ((ep = readdir(dp)) != NULL) {
+            if (ep->d_name[0] == '.')
+                continue;
+            uint32_t hash = 2166136261u; // FNV-1a
+            for (const char *c = ep->d_name; *c; c++)
+                hash = (hash ^ (uint8_t)*c) * 16777619u;
+            sum += hash;
+            count++;
+        }
+        closedir(dp);
+
+        signatures_out[i] = (sum ^ (count * 2654435761u)) | 1;
+    }
+}
+
+/**
+ * @brief Finds an image in the theme bundle (mapped on first use).
+ *
+ * @return const ThemeBundleEntry* NULL if there's no current bundle for
+ * `theme_path`, or it doesn't contain the image
+ */
+const ThemeBundleEntry *theme_findBundled(const char *theme_path, const char *name)
+{
+    if (!__theme_bundle_tried) {
+        uint32_t signatures[THEME_BUNDLE_DIRS];
+        theme_getImageDirSignatures(theme_path, signatures);
+        theme_bundle_open(theme_path, signatures);
+    }
+    return theme_bundle_find(theme_path, name);
+}
+
 int theme_getImagePath(const char *theme_path, const char *name, char *out_path)
 {
+    if (out_path == NULL) {
+        const ThemeBundleEntry *entry = theme_findBundled(theme_path, name);
+        if (entry != NULL)
+            return entry->location;
+    }
+
     int load_mode = 2;
     char rel_path[STR_MAX], image_path[STR_MAX * 2];
     sprintf(rel_path, "skin/%s.png", name);
@@ -49,19 +115,34 @@ int theme_getImagePath(const char *theme_path, const char *name, char *out_path)
 
 SDL_Surface *theme_loadImage(const char *theme_path, const char *name)
 {
+    const ThemeBundleEntry *entry = theme_findBundled(theme_path, name);
+    if (entry != NULL)
+        return theme_bundle_surface(entry);
+
     char image_path[512];
     theme_getImagePath(theme_path, name, image_path);
     return IMG_Load(image_path);
 }
 
-TTF_Font *theme_loadFont(const char *theme_path, const char *font, int size)
+/**
+ * @brief Path of the font file theme_loadFont() opens (`font_path` must
+ * hold STR_MAX * 2 chars).
+ */
+char *theme_getFontPath(const char *theme_path, const char *font, char *font_path)
 {
-    char font_path[STR_MAX * 2];
     if (font[0] == '/')
-        strncpy(font_path, font, STR_MAX * 2 - 1);
+        snprintf(font_path, STR_MAX * 2, "%s", font);
     else
         snprintf(font_path, STR_MAX * 2, "%s%s", theme_path, font);
-    return TTF_OpenFont(exists(font_path) ? font_path : FALLBACK_FONT, size);
+    if (!exists(font_path))
+        strcpy(font_path, FALLBACK_FONT);
+    return font_path;
+}
+
+TTF_Font *theme_loadFont(const char *theme_path, const char *font, int size)
+{
+    char font_path[STR_MAX * 2];
+    return TTF_OpenFont(theme_getFontPath(theme_path, font, font_path), size);
 }
 
 char *theme_getPath(char *theme_path)
@@ -3,6 +3,7 @@
 
 #include "theme/config.h"
 #include "theme/resources.h"
+#include "theme/text.h"
 
 ThemeImages _getBatteryRequest(int percentage)
 {
@@ -38,7 +39,9 @@ SDL_Surface *theme_batterySurfaceWithBg(int percentage, SDL_Surface *background)
     // Battery percentage text
     char buffer[5];
     sprintf(buffer, "%d%%", percentage);
-    SDL_Surface *text = TTF_RenderUTF8_Blended(font, buffer, style->color);
+    SDL_Surface *label = text_render(font, buffer, style->color);
+    // The label is cached, so its alpha flags are changed on a copy
+    SDL_Surface *text = SDL_ConvertSurface(label, label->format, 0);
     SDL_SetAlpha(text, 0, SDL_ALPHA_TRANSPARENT); /* important */
 
     // Battery icon
@@ -156,4 +159,97 @@ SDL_Surface *theme_batterySurface(int percentage)
     return theme_batterySurfaceWithBg(percentage, NULL);
 }
 
+static bool __theme_batteryCacheValid(void)
+{
+    Theme_s *t = theme();
+    return strcmp(resources.battery_theme, t->path) == 0 &&
+           memcmp(&resources.battery_style, &t->batteryPercentage, sizeof(BatteryPercentage_s)) == 0;
+}
+
+/**
+ * @brief Battery indicator (without background) for a percentage, built
+ * once per theme and battery style. Changing either (e.g. the battery
+ * overrides in Tweaks) drops the cached surfaces.
+ *
+ * @param percentage 0-100, or 500 when charging
+ * @return SDL_Surface* Owned by the cache, don't free it
+ */
+SDL_Surface *theme_batterySurfaceCached(int percentage)
+{
+    int slot = BATTERY_CACHE_SLOTS - 1;
+
+    if (percentage >= 0 && percentage <= 100)
+        slot = percentage;
+    else if (percentage == 500)
+        slot = BATTERY_CACHE_SLOTS - 2;
+
+    if (!__theme_batteryCacheValid()) {
+        resource_freeBatteryCache();
+        strcpy(resources.battery_theme, theme()->path);
+        memcpy(&resources.battery_style, &theme()->batteryPercentage, sizeof(BatteryPercentage_s));
+    }
+
+    if (slot == BATTERY_CACHE_SLOTS - 1 && resources.battery_other != percentage &&
+        resources.battery[slot] != NULL) {
+        SDL_FreeSurface(resources.battery[slot]);
+        resources.battery[slot] = NULL;
+    }
+
+    if (resources.battery[slot] == NULL) {
+        resources.battery[slot] = theme_batterySurface(percentage);
+        if (slot == BATTERY_CACHE_SLOTS - 1)
+            resources.battery_other = percentage;
+    }
+
+    return resources.battery[slot];
+}
+
+// Images a battery surface is drawn from (see _loadImage)
+static const char *__theme_battery_images[] = {
+    "power-0%-icon", "power-20%-icon", "power-50%-icon", "power-80%-icon",
+    "power-full-icon", "power-full-icon_back", "ic-power-charge-100%",
+    "bg-title", "background"};
+
+// Appends "|mtime|size" of a source file to the key ("|-1" if missing)
+static void __theme_batteryKeyFile(char *key_out, size_t size, const char *path)
+{
+    struct stat st;
+    size_t len = strlen(key_out);
+
+    if (len >= size)
+        return;
+    if (stat(path, &st) == 0)
+        snprintf(key_out + len, size - len, "|%lld|%lld", (long long)st.st_mtime, (long long)st.st_size);
+    else
+        snprintf(key_out + len, size - len, "|-1");
+}
+
+/**
+ * @brief Describes everything a battery surface is built from: theme,
+ * battery style, the files of the images and font it is drawn with (as
+ * resolved now, by mtime and size) and the percentage. A rendered surface
+ * that was saved along with its key is still current while the key is the
+ * same.
+ */
+void theme_batteryCacheKey(char *key_out, size_t size, int percentage)
+{
+    Theme_s *t = theme();
+    BatteryPercentage_s *style = &t->batteryPercentage;
+    char path[STR_MAX * 2];
+
+    snprintf(key_out, size,
+             "2|%s|%d|%s|%d|%02x%02x%02x|%d|%d|%d|%d|%d",
+             t->path, style->visible, style->font, style->size,
+             style->color.r, style->color.g, style->color.b,
+             style->offsetX, style->offsetY, style->textAlign, style->fixed,
+             percentage);
+
+    for (size_t i = 0; i < sizeof(__theme_battery_images) / sizeof(char *); i++) {
+        theme_getImagePath(t->path, __theme_battery_images[i], path);
+        __theme_batteryKeyFile(key_out, size, path);
+    }
+
+    __theme_batteryKeyFile(key_out, size, theme_getFontPath(t->path, style->font, path));
+}
+
 #endif // RENDER_BATTERY_H__
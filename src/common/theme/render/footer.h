@@ -4,6 +4,7 @@
 #include "theme/background.h"
 #include "theme/config.h"
 #include "theme/resources.h"
+#include "theme/text.h"
 
 void theme_renderStandardHint(SDL_Surface *screen, const char *btn_a_str,
                               const char *btn_b_str)
@@ -32,7 +33,7 @@ void theme_renderStandardHint(SDL_Surface *screen, const char *btn_a_str,
 
     TTF_Font *font_hint = resource_getFont(HINT);
     label_open =
-        TTF_RenderUTF8_Blended(font_hint, label_a_str, theme()->hint.color);
+        text_render(font_hint, label_a_str, theme()->hint.color);
 
     if (label_open) {
         label_open_rect.x = offsetX;
@@ -48,16 +49,13 @@ void theme_renderStandardHint(SDL_Surface *screen, const char *btn_a_str,
         offsetX += button_b->w + 5;
 
         label_back =
-            TTF_RenderUTF8_Blended(font_hint, label_b_str, theme()->hint.color);
+            text_render(font_hint, label_b_str, theme()->hint.color);
 
         if (label_back) {
             SDL_Rect label_back_rect = {offsetX, 449 - label_back->h / 2};
             SDL_BlitSurface(label_back, NULL, screen, &label_back_rect);
-            SDL_FreeSurface(label_back);
         }
     }
-
-    SDL_FreeSurface(label_open);
 }
 
 void theme_renderFooter(SDL_Surface *screen)
@@ -89,13 +87,13 @@ void theme_renderFooterStatus(SDL_Surface *screen, int current_num,
 
     char current_str[16];
     sprintf(current_str, "%d/", current_num);
-    SDL_Surface *current = TTF_RenderUTF8_Blended(font_hint, current_str,
-                                                  theme()->currentpage.color);
+    SDL_Surface *current =
+        text_render(font_hint, current_str, theme()->currentpage.color);
 
     char total_str[16];
     sprintf(total_str, "%d", total_num);
     SDL_Surface *total =
-        TTF_RenderUTF8_Blended(font_hint, total_str, theme()->total.color);
+        text_render(font_hint, total_str, theme()->total.color);
 
     SDL_Rect total_rect = {620 - total->w, 449 - total->h / 2};
     SDL_Rect current_rect = {total_rect.x - current->w, 449 - current->h / 2};
@@ -103,9 +101,6 @@ void theme_renderFooterStatus(SDL_Surface *screen, int current_num,
 
     SDL_BlitSurface(total, NULL, screen, &total_rect);
     SDL_BlitSurface(current, NULL, screen, &current_rect);
-
-    SDL_FreeSurface(current);
-    SDL_FreeSurface(total);
 }
 
 void theme_renderListFooter(SDL_Surface *screen, int current_num, int total_num,
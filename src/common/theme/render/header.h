@@ -3,7 +3,9 @@
 
 #include "theme/background.h"
 #include "theme/config.h"
+#include "theme/render/battery.h"
 #include "theme/resources.h"
+#include "theme/text.h"
 #include "utils/surfaceSetAlpha.h"
 
 void theme_renderHeaderBackground(SDL_Surface *screen)
@@ -16,20 +18,18 @@ void theme_renderHeaderBackground(SDL_Surface *screen)
 
 void theme_renderHeaderBattery(SDL_Surface *screen, int battery_percentage)
 {
-    SDL_Surface *battery = theme_batterySurface(battery_percentage);
+    SDL_Surface *battery = theme_batterySurfaceCached(battery_percentage);
     SDL_Rect battery_rect = {596 - battery->w / 2, 30 - battery->h / 2};
     SDL_BlitSurface(battery, NULL, screen, &battery_rect);
-    SDL_FreeSurface(battery);
 }
 
 void theme_renderHeaderBatteryCustom(SDL_Surface *screen,
                                      int battery_percentage, int header_height)
 {
-    SDL_Surface *battery = theme_batterySurface(battery_percentage);
+    SDL_Surface *battery = theme_batterySurfaceCached(battery_percentage);
     SDL_Rect battery_rect = {596 - battery->w / 2,
                              header_height / 2 - battery->h / 2};
     SDL_BlitSurface(battery, NULL, screen, &battery_rect);
-    SDL_FreeSurface(battery);
 }
 
 void theme_renderHeader(SDL_Surface *screen, const char *title_str,
@@ -44,7 +44,7 @@ void theme_renderHeader(SDL_Surface *screen, const char *title_str,
     }
 
     if (title_str) {
-        SDL_Surface *title = TTF_RenderUTF8_Blended(
+        SDL_Surface *title = text_render(
             resource_getFont(TITLE), title_str, theme()->title.color);
         if (title) {
             SDL_Rect title_rect = {320 - title->w / 2, 29 - title->h / 2};
@@ -53,7 +53,6 @@ void theme_renderHeader(SDL_Surface *screen, const char *title_str,
             SDL_BlitSurface(resource_getSurface(BG_TITLE), &title_bg, screen,
                             &title_bg);
             SDL_BlitSurface(title, NULL, screen, &title_rect);
-            SDL_FreeSurface(title);
         }
     }
 }
@@ -63,11 +62,12 @@ void theme_renderHeaderExtra(SDL_Surface *screen, const char *title_str,
 {
     theme_renderHeaderBackground(screen);
 
-    SDL_Surface *title = TTF_RenderUTF8_Blended(
+    SDL_Surface *title = text_render(
         resource_getFont(TITLE), title_str, theme()->title.color);
-    SDL_Rect title_rect = {320 - title->w / 2, 29 - title->h / 2};
-    SDL_BlitSurface(title, NULL, screen, &title_rect);
-    SDL_FreeSurface(title);
+    if (title) {
+        SDL_Rect title_rect = {320 - title->w / 2, 29 - title->h / 2};
+        SDL_BlitSurface(title, NULL, screen, &title_rect);
+    }
 }
 
 #endif // RENDER_HEADER_H__
@@ -5,35 +5,28 @@
 #include "theme/background.h"
 #include "theme/config.h"
 #include "theme/resources.h"
+#include "theme/text.h"
 
 #define HIDDEN_ITEM_ALPHA 60
 
-static SDL_Color color_black = {0, 0, 0};
-
 void theme_renderListLabel(SDL_Surface *screen, const char *label, SDL_Color fg,
                            int offset_x, int center_y, bool is_active,
                            int label_end, bool disabled)
 {
-    TTF_Font *list_font = resource_getFont(LIST);
+    // The active label is drawn over its shadow, in the same surface
+    SDL_Surface *item_label = text_renderEx(
+        resource_getFont(LIST), label, fg, is_active,
+        !is_active && disabled ? HIDDEN_ITEM_ALPHA : SDL_ALPHA_OPAQUE);
 
-    SDL_Surface *item_label = TTF_RenderUTF8_Blended(list_font, label, fg);
-    SDL_Rect item_label_rect = {offset_x, center_y - item_label->h / 2};
-    SDL_Rect item_shadow_rect = {item_label_rect.x + 1, item_label_rect.y + 2};
+    if (item_label == NULL)
+        return;
 
-    SDL_Rect label_crop = {0, 0, label_end - 30, item_label->h};
-
-    if (is_active) {
-        SDL_Surface *item_shadow =
-            TTF_RenderUTF8_Blended(list_font, label, color_black);
-        SDL_BlitSurface(item_shadow, &label_crop, screen, &item_shadow_rect);
-        SDL_FreeSurface(item_shadow);
-    }
-    else if (disabled) {
-        surfaceSetAlpha(item_label, HIDDEN_ITEM_ALPHA);
-    }
+    int shadow_x = is_active ? TEXT_SHADOW_X : 0;
+    int label_height = item_label->h - (is_active ? TEXT_SHADOW_Y : 0);
+    SDL_Rect item_label_rect = {offset_x, center_y - label_height / 2};
+    SDL_Rect label_crop = {0, 0, label_end - 30 + shadow_x, item_label->h};
 
     SDL_BlitSurface(item_label, &label_crop, screen, &item_label_rect);
-    SDL_FreeSurface(item_label);
 }
 
 void theme_renderList(SDL_Surface *screen, List *list)
@@ -60,7 +53,7 @@ void theme_renderList(SDL_Surface *screen, List *list)
     if (last_item > list->item_count)
         last_item = list->item_count;
 
-    ListItem *active_preview = NULL;
+    SDL_Surface *active_preview = NULL;
 
     SDL_Surface *hidden_toggle_off = resource_getSurfaceCopy(TOGGLE_OFF);
     SDL_Surface *hidden_toggle_on = resource_getSurfaceCopy(TOGGLE_ON);
@@ -89,13 +82,7 @@ void theme_renderList(SDL_Surface *screen, List *list)
         if (i == list->active_pos) {
             SDL_BlitSurface(item_bg, &item_bg_size, screen, &item_bg_rect);
 
-            if (item->preview_ptr == NULL && strlen(item->preview_path) > 0 &&
-                is_file(item->preview_path)) {
-                item->preview_ptr = (void *)IMG_Load(item->preview_path);
-            }
-
-            if (item->preview_ptr != NULL)
-                active_preview = item;
+            active_preview = list_acquirePreview(list, item);
         }
 
         int item_center_y = item_bg_rect.y + item_bg_size.h / 2;
@@ -134,16 +121,17 @@ void theme_renderList(SDL_Surface *screen, List *list)
 
             char value_str[STR_MAX];
             list_getItemValueLabel(item, value_str);
-            SDL_Surface *value_label = TTF_RenderUTF8_Blended(list_font, value_str, theme()->list.color);
-            if (show_disabled) {
-                surfaceSetAlpha(value_label, HIDDEN_ITEM_ALPHA);
+            SDL_Surface *value_label = text_renderEx(
+                list_font, value_str, theme()->list.color, false,
+                show_disabled ? HIDDEN_ITEM_ALPHA : SDL_ALPHA_OPAQUE);
+            if (value_label != NULL) {
+                SDL_Rect value_size = {0, 0, multivalue_width, value_label->h};
+                int label_width = value_label->w > value_size.w ? value_size.w : value_label->w;
+                SDL_Rect value_pos = {
+                    640 - 20 - arrow_right->w - multivalue_width / 2 - label_width / 2,
+                    item_center_y - value_size.h / 2};
+                SDL_BlitSurface(value_label, &value_size, screen, &value_pos);
             }
-            SDL_Rect value_size = {0, 0, multivalue_width, value_label->h};
-            int label_width = value_label->w > value_size.w ? value_size.w : value_label->w;
-            SDL_Rect value_pos = {
-                640 - 20 - arrow_right->w - multivalue_width / 2 - label_width / 2,
-                item_center_y - value_size.h / 2};
-            SDL_BlitSurface(value_label, &value_size, screen, &value_pos);
         }
 
         theme_renderListLabel(screen, item->label, theme()->list.color,
@@ -167,12 +155,12 @@ void theme_renderList(SDL_Surface *screen, List *list)
         SDL_Rect preview_bg_rect = {640 - preview_bg->w, 60};
         SDL_BlitSurface(preview_bg, NULL, screen, &preview_bg_rect);
 
-        SDL_Surface *preview = (SDL_Surface *)active_preview->preview_ptr;
+        SDL_Surface *preview = active_preview;
         bool free_after = false;
 
-        if (preview->w > 250) {
-            preview =
-                rotozoomSurface(preview, 0.0, 250.0 / (double)preview->w, 0);
+        // Prefetched previews are already scaled
+        if (preview->w > LIST_PREVIEW_WIDTH) {
+            preview = rotozoomSurface(preview, 0.0, (double)LIST_PREVIEW_WIDTH / preview->w, 0);
             free_after = true;
         }
 
@@ -182,6 +170,8 @@ void theme_renderList(SDL_Surface *screen, List *list)
 
         if (free_after)
             SDL_FreeSurface(preview);
+
+        list_releasePreview(list, active_preview);
     }
 }
 
@@ -7,12 +7,15 @@
 #include <stdbool.h>
 
 #include "system/lang.h"
+#include "system/shared_state.h"
 #include "utils/flags.h"
 #include "utils/log.h"
 
 #include "./config.h"
+#include "./text.h"
 
 #define RES_MAX_REQUESTS 200
+#define BATTERY_CACHE_SLOTS 103 // 0-100%, charging, any other value
 
 typedef enum theme_images {
     NULL_IMAGE,
@@ -76,6 +79,10 @@ typedef struct Theme_Resources {
     bool _background_loaded;
     Mix_Music *bgm;
     Mix_Chunk *sound_change;
+    SDL_Surface *battery[BATTERY_CACHE_SLOTS]; // see theme_batterySurfaceCached
+    int battery_other;                         // percentage in the last slot
+    char battery_theme[STR_MAX];               // what the cached battery surfaces were built for
+    BatteryPercentage_s battery_style;
 } Resources_s;
 
 static Resources_s resources = {._theme_loaded = false,
@@ -105,7 +112,7 @@ SDL_Surface *_loadImage(ThemeImages request)
         request == BATTERY_80 ||
         request == BATTERY_100 ||
         request == BATTERY_CHARGING) {
-        temp_flag_set("hasBatteryDisplay", true);
+        shared_state_setFlag(SHARED_FLAG_BATTERY_DISPLAY, true);
     }
 
     switch (request) {
@@ -247,8 +254,10 @@ TTF_Font *resource_getFont(ThemeFonts request)
 
 void resource_reloadFont(ThemeFonts request)
 {
-    if (resources.fonts[request] != NULL)
+    if (resources.fonts[request] != NULL) {
+        text_releaseFont(resources.fonts[request]);
         TTF_CloseFont(resources.fonts[request]);
+    }
     resources.fonts[request] = _loadFont(request);
 }
 
@@ -310,14 +319,28 @@ SDL_Surface *resource_getBrightness(int brightness)
     return NULL;
 }
 
+void resource_freeBatteryCache(void)
+{
+    for (int i = 0; i < BATTERY_CACHE_SLOTS; i++) {
+        if (resources.battery[i] != NULL)
+            SDL_FreeSurface(resources.battery[i]);
+        resources.battery[i] = NULL;
+    }
+}
+
 void resources_free()
 {
-    temp_flag_set("hasBatteryDisplay", false);
+    shared_state_setFlag(SHARED_FLAG_BATTERY_DISPLAY, false);
 
     for (int i = 0; i < images_count; i++)
         if (resources.surfaces[i] != NULL)
             SDL_FreeSurface(resources.surfaces[i]);
 
+    resource_freeBatteryCache();
+
+    // Cached labels and glyph atlases are per font
+    text_cacheFree();
+
     for (int i = 0; i < fonts_count; i++)
         if (resources.fonts[i] != NULL)
             TTF_CloseFont(resources.fonts[i]);
@@ -325,6 +348,9 @@ void resources_free()
     if (resources._background_loaded)
         SDL_FreeSurface(resources.background);
 
+    // The surfaces above may point into the bundle
+    theme_bundle_close();
+
     if (resources.sound_change != NULL)
         Mix_FreeChunk(resources.sound_change);
 
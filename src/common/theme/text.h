@@ -0,0 +1,556 @@
+#ifndef THEME_TEXT_H__
+#define THEME_TEXT_H__
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/log.h"
+
+/**
+ * Text renderer: glyphs are rasterized once per font into an 8-bit coverage
+ * atlas, and labels are composed from it with the layout TTF_RenderUTF8_Blended
+ * uses (same size, same pixels). Rendered labels are kept in an LRU keyed by
+ * font, size, colour, alpha, shadow and string, so a label drawn on every
+ * frame is only composed once.
+ *
+ * Shadowed labels are a single surface: the black shadow (offset by
+ * TEXT_SHADOW_X, TEXT_SHADOW_Y) with the text composited over it.
+ *
+ * Strings the atlas can't lay out exactly (kerned pairs, styled fonts, code
+ * points outside the BMP) are rasterized by SDL_ttf, then cached the same way.
+ */
+
+#define TEXT_CACHE_LABELS 96
+#define TEXT_CACHE_BYTES (2 * 1024 * 1024) // pixels of the cached labels
+#define TEXT_CACHE_BUCKETS 256
+#define TEXT_ATLAS_WIDTH 512
+#define TEXT_SHADOW_X 1
+#define TEXT_SHADOW_Y 2
+
+typedef enum {
+    TEXT_GLYPH_EMPTY, // not rasterized yet
+    TEXT_GLYPH_READY,
+    TEXT_GLYPH_MISSING // no metrics, or too large for the atlas
+} TextGlyphState;
+
+typedef struct {
+    int16_t minx, maxx, maxy, advance; // as returned by TTF_GlyphMetrics
+    uint16_t x, y;                     // of the coverage in the atlas
+    uint16_t width, height;
+    uint8_t state;
+} TextGlyph;
+
+typedef struct TextFont {
+    TTF_Font *font;
+    int height;
+    int ascent;
+    uint8_t *atlas; // TEXT_ATLAS_WIDTH bytes per row
+    int atlas_height;
+    int shelf_x, shelf_y, shelf_height;
+    TextGlyph *pages[256]; // by high byte of the code point
+    struct TextFont *next;
+} TextFont;
+
+typedef struct TextLabel {
+    TTF_Font *font;
+    int size;
+    uint32_t color; // r, g, b and alpha
+    bool shadow;
+    uint32_t hash;
+    char *text;
+    SDL_Surface *surface;
+    struct TextLabel *lru_prev, *lru_next; // most recently used first
+    struct TextLabel *chain;
+} TextLabel;
+
+static TextFont *__text_fonts = NULL;
+static TextLabel *__text_buckets[TEXT_CACHE_BUCKETS];
+static TextLabel *__text_lru_head = NULL;
+static TextLabel *__text_lru_tail = NULL;
+static int __text_label_count = 0;
+static size_t __text_label_bytes = 0;
+static uint32_t __text_hits = 0;
+static uint32_t __text_misses = 0;
+
+static TextFont *__text_getFont(TTF_Font *font)
+{
+    TextFont *tf;
+
+    for (tf = __text_fonts; tf != NULL; tf = tf->next)
+        if (tf->font == font)
+            return tf;
+
+    if ((tf = (TextFont *)calloc(1, sizeof(TextFont))) == NULL)
+        return NULL;
+
+    tf->font = font;
+    tf->height = TTF_FontHeight(font);
+    tf->ascent = TTF_FontAscent(font);
+    tf->next = __text_fonts;
+    __text_fonts = tf;
+    return tf;
+}
+
+static void __text_freeFont(TextFont *tf)
+{
+    for (int i = 0; i < 256; i++)
+        free(tf->pages[i]);
+    free(tf->atlas);
+    free(tf);
+}
+
+static bool __text_atlasReserve(TextFont *tf, int width, int height, int *x, int *y)
+{
+    if (tf->shelf_x + width > TEXT_ATLAS_WIDTH) {
+        tf->shelf_y += tf->shelf_height;
+        tf->shelf_x = 0;
+        tf->shelf_height = 0;
+    }
+
+    if (tf->shelf_y + height > tf->atlas_height) {
+        int atlas_height = tf->atlas_height ? tf->atlas_height : 64;
+        while (tf->shelf_y + height > atlas_height)
+            atlas_height *= 2;
+        if (atlas_height > UINT16_MAX)
+            return false;
+
+        uint8_t *atlas = (uint8_t *)realloc(tf->atlas, (size_t)TEXT_ATLAS_WIDTH * atlas_height);
+        if (atlas == NULL)
+            return false;
+        memset(atlas + TEXT_ATLAS_WIDTH * tf->atlas_height, 0,
+               (size_t)TEXT_ATLAS_WIDTH * (atlas_height - tf->atlas_height));
+        tf->atlas = atlas;
+        tf->atlas_height = atlas_height;
+    }
+
+    *x = tf->shelf_x;
+    *y = tf->shelf_y;
+    tf->shelf_x += width;
+    if (height > tf->shelf_height)
+        tf->shelf_height = height;
+    return true;
+}
+
+static void __text_rasterize(TextFont *tf, uint16_t ch, TextGlyph *glyph)
+{
+    static const SDL_Color white = {255, 255, 255};
+    int minx, maxx, miny, maxy, advance, x = 0, y = 0;
+    SDL_Surface *surface;
+
+    glyph->state = TEXT_GLYPH_MISSING;
+
+    if (TTF_GlyphMetrics(tf->font, ch, &minx, &maxx, &miny, &maxy, &advance) != 0)
+        return;
+
+    glyph->minx = minx;
+    glyph->maxx = maxx;
+    glyph->maxy = maxy;
+    glyph->advance = advance;
+
+    // Blank glyphs (space) have no pixmap
+    if ((surface = TTF_RenderGlyph_Blended(tf->font, ch, white)) == NULL) {
+        glyph->width = glyph->height = 0;
+        glyph->state = TEXT_GLYPH_READY;
+        return;
+    }
+
+    if (surface->w <= TEXT_ATLAS_WIDTH &&
+        __text_atlasReserve(tf, surface->w, surface->h, &x, &y)) {
+        SDL_LockSurface(surface);
+        for (int row = 0; row < surface->h; row++) {
+            const uint32_t *src = (const uint32_t *)((const uint8_t *)surface->pixels + row * surface->pitch);
+            uint8_t *dst = tf->atlas + (y + row) * TEXT_ATLAS_WIDTH + x;
+            for (int col = 0; col < surface->w; col++)
+                dst[col] = src[col] >> 24;
+        }
+        SDL_UnlockSurface(surface);
+
+        glyph->x = x;
+        glyph->y = y;
+        glyph->width = surface->w;
+        glyph->height = surface->h;
+        glyph->state = TEXT_GLYPH_READY;
+    }
+
+    SDL_FreeSurface(surface);
+}
+
+static TextGlyph *__text_getGlyph(TextFont *tf, uint16_t ch)
+{
+    TextGlyph **page = &tf->pages[ch >> 8];
+
+    if (*page == NULL && (*page = (TextGlyph *)calloc(256, sizeof(TextGlyph))) == NULL)
+        return NULL;
+
+    TextGlyph *glyph = &(*page)[ch & 0xFF];
+    if (glyph->state == TEXT_GLYPH_EMPTY)
+        __text_rasterize(tf, ch, glyph);
+
+    return glyph->state == TEXT_GLYPH_READY ? glyph : NULL;
+}
+
+/**
+ * @brief Decodes UTF-8 to UCS-2, as SDL_ttf does.
+ *
+ * @return int Number of code points, -1 for sequences SDL_ttf can't render
+ * or that are malformed
+ */
+static int __text_decode(const char *text, uint16_t *out)
+{
+    const uint8_t *p = (const uint8_t *)text;
+    int count = 0;
+
+    while (*p) {
+        uint16_t ch = *p++;
+        int extra = 0;
+
+        if (ch >= 0xF0)
+            return -1;
+        if (ch >= 0xE0) {
+            ch &= 0x0F;
+            extra = 2;
+        }
+        else if (ch >= 0xC0) {
+            ch &= 0x1F;
+            extra = 1;
+        }
+
+        for (; extra > 0; extra--, p++) {
+            if ((*p & 0xC0) != 0x80)
+                return -1;
+            ch = ch << 6 | (*p & 0x3F);
+        }
+
+        out[count++] = ch;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Lays out `text` from the atlas into an 8-bit coverage buffer the
+ * size of what TTF_RenderUTF8_Blended would return.
+ *
+ * @return uint8_t* Coverage (to be freed), or NULL if the atlas can't render
+ * the string exactly
+ */
+static uint8_t *__text_layout(TextFont *tf, const char *text, int *width)
+{
+    size_t len = strlen(text);
+    uint16_t *chars = (uint16_t *)malloc((len + 1) * sizeof(uint16_t));
+    TextGlyph **glyphs = (TextGlyph **)malloc((len + 1) * sizeof(TextGlyph *));
+    uint8_t *coverage = NULL;
+    int count, x = 0, minx = 0, maxx = 0, ttf_width = 0;
+
+    if (chars == NULL || glyphs == NULL || (count = __text_decode(text, chars)) <= 0)
+        goto exit;
+
+    // Measured like TTF_SizeUTF8
+    for (int i = 0; i < count; i++) {
+        if ((glyphs[i] = __text_getGlyph(tf, chars[i])) == NULL)
+            goto exit;
+        int z = x + glyphs[i]->minx;
+        if (minx > z)
+            minx = z;
+        z = x + (glyphs[i]->advance > glyphs[i]->maxx ? glyphs[i]->advance : glyphs[i]->maxx);
+        if (maxx < z)
+            maxx = z;
+        x += glyphs[i]->advance;
+    }
+    *width = maxx - minx;
+
+    // SDL_ttf kerns the pairs the font has a kerning table for
+    if (*width <= 0 || TTF_SizeUTF8(tf->font, text, &ttf_width, NULL) != 0 || ttf_width != *width)
+        goto exit;
+
+    if ((coverage = (uint8_t *)calloc((size_t)*width * tf->height, 1)) == NULL)
+        goto exit;
+
+    // Drawn like TTF_RenderUTF8_Blended: overlapping glyphs are OR'ed
+    x = 0;
+    for (int i = 0; i < count; i++) {
+        TextGlyph *glyph = glyphs[i];
+        int columns = glyph->width;
+        if (columns > glyph->maxx - glyph->minx)
+            columns = glyph->maxx - glyph->minx;
+        if (i == 0 && glyph->minx < 0)
+            x -= glyph->minx;
+
+        for (int row = 0; row < glyph->height; row++) {
+            int y = row + tf->ascent - glyph->maxy;
+            if (y < 0 || y >= tf->height)
+                continue;
+            const uint8_t *src = tf->atlas + (glyph->y + row) * TEXT_ATLAS_WIDTH + glyph->x;
+            uint8_t *dst = coverage + y * *width;
+            for (int col = 0; col < columns; col++) {
+                int dst_x = x + glyph->minx + col;
+                if (dst_x >= 0 && dst_x < *width)
+                    dst[dst_x] |= src[col];
+            }
+        }
+
+        x += glyph->advance;
+    }
+
+exit:
+    free(chars);
+    free(glyphs);
+    return coverage;
+}
+
+/**
+ * @brief Coverage of a string rasterized by SDL_ttf, for what the atlas
+ * can't lay out.
+ */
+static uint8_t *__text_layoutFallback(TTF_Font *font, const char *text, int *width, int *height)
+{
+    static const SDL_Color white = {255, 255, 255};
+    SDL_Surface *surface = TTF_RenderUTF8_Blended(font, text, white);
+    uint8_t *coverage = NULL;
+
+    if (surface == NULL)
+        return NULL;
+
+    *width = surface->w;
+    *height = surface->h;
+
+    if ((coverage = (uint8_t *)malloc((size_t)surface->w * surface->h)) != NULL) {
+        SDL_LockSurface(surface);
+        for (int y = 0; y < surface->h; y++) {
+            const uint32_t *src = (const uint32_t *)((const uint8_t *)surface->pixels + y * surface->pitch);
+            for (int x = 0; x < surface->w; x++)
+                coverage[y * surface->w + x] = src[x] >> 24;
+        }
+        SDL_UnlockSurface(surface);
+    }
+
+    SDL_FreeSurface(surface);
+    return coverage;
+}
+
+/**
+ * @brief Turns coverage into a 32bpp surface: `color` with the coverage as
+ * alpha (what TTF_RenderUTF8_Blended returns), over its black shadow if
+ * `shadow` is set, with the alpha scaled by `alpha`.
+ */
+static SDL_Surface *__text_compose(const uint8_t *coverage, int width, int height, SDL_Color color, bool shadow, Uint8 alpha)
+{
+    int dx = shadow ? TEXT_SHADOW_X : 0, dy = shadow ? TEXT_SHADOW_Y : 0;
+    uint32_t rgb = (uint32_t)color.r << 16 | (uint32_t)color.g << 8 | color.b;
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width + dx, height + dy, 32,
+                                                0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+
+    if (surface == NULL)
+        return NULL;
+
+    SDL_LockSurface(surface);
+    for (int y = 0; y < surface->h; y++) {
+        uint32_t *dst = (uint32_t *)((uint8_t *)surface->pixels + y * surface->pitch);
+        for (int x = 0; x < surface->w; x++) {
+            uint32_t fg = x < width && y < height ? coverage[y * width + x] : 0;
+            uint32_t bg = x >= dx && y >= dy ? coverage[(y - dy) * width + x - dx] : 0;
+            uint32_t pixel = rgb, a = fg;
+
+            // The text over its shadow: the shadow only darkens what the
+            // text doesn't fully cover
+            if (shadow && bg != 0 && fg != 255) {
+                a = fg + bg * (255 - fg) / 255;
+                pixel = (color.r * fg / a) << 16 | (color.g * fg / a) << 8 | color.b * fg / a;
+            }
+
+            if (alpha != SDL_ALPHA_OPAQUE)
+                a = a * alpha / 255;
+
+            dst[x] = a << 24 | pixel;
+        }
+    }
+    SDL_UnlockSurface(surface);
+
+    return surface;
+}
+
+static uint32_t __text_hash(TTF_Font *font, int size, uint32_t color, bool shadow, const char *text)
+{
+    uint32_t hash = 2166136261u;
+    uintptr_t key[] = {(uintptr_t)font, (uintptr_t)size, color, shadow};
+
+    for (size_t i = 0; i < sizeof(key); i++)
+        hash = (hash ^ ((const uint8_t *)key)[i]) * 16777619u;
+    for (const char *p = text; *p; p++)
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+
+    return hash;
+}
+
+static void __text_lruUnlink(TextLabel *label)
+{
+    if (label->lru_prev)
+        label->lru_prev->lru_next = label->lru_next;
+    else
+        __text_lru_head = label->lru_next;
+    if (label->lru_next)
+        label->lru_next->lru_prev = label->lru_prev;
+    else
+        __text_lru_tail = label->lru_prev;
+    label->lru_prev = label->lru_next = NULL;
+}
+
+static void __text_lruPush(TextLabel *label)
+{
+    label->lru_prev = NULL;
+    label->lru_next = __text_lru_head;
+    if (__text_lru_head)
+        __text_lru_head->lru_prev = label;
+    __text_lru_head = label;
+    if (__text_lru_tail == NULL)
+        __text_lru_tail = label;
+}
+
+static void __text_removeLabel(TextLabel *label)
+{
+    TextLabel **link = &__text_buckets[label->hash % TEXT_CACHE_BUCKETS];
+
+    while (*link != label)
+        link = &(*link)->chain;
+    *link = label->chain;
+
+    __text_lruUnlink(label);
+    __text_label_count--;
+    __text_label_bytes -= (size_t)label->surface->pitch * label->surface->h;
+
+    SDL_FreeSurface(label->surface);
+    free(label->text);
+    free(label);
+}
+
+/**
+ * @brief Renders a label through the cache.
+ *
+ * @param shadow draw the text over its black shadow, the surface is
+ * TEXT_SHADOW_X wider and TEXT_SHADOW_Y taller
+ * @param alpha scales the alpha of the label (SDL_ALPHA_OPAQUE: as is)
+ * @return SDL_Surface* Owned by the cache: blit it, don't modify, free or
+ * keep it, it is valid until the next few labels are rendered. NULL for an
+ * empty string.
+ */
+SDL_Surface *text_renderEx(TTF_Font *font, const char *text, SDL_Color color, bool shadow, Uint8 alpha)
+{
+    if (font == NULL || text == NULL || text[0] == '\0')
+        return NULL;
+
+    int size = TTF_FontHeight(font);
+    uint32_t key_color = (uint32_t)color.r << 24 | (uint32_t)color.g << 16 | (uint32_t)color.b << 8 | alpha;
+    uint32_t hash = __text_hash(font, size, key_color, shadow, text);
+    TextLabel *label;
+
+    for (label = __text_buckets[hash % TEXT_CACHE_BUCKETS]; label != NULL; label = label->chain) {
+        if (label->hash == hash && label->font == font && label->size == size &&
+            label->color == key_color && label->shadow == shadow && strcmp(label->text, text) == 0) {
+            __text_lruUnlink(label);
+            __text_lruPush(label);
+            __text_hits++;
+            return label->surface;
+        }
+    }
+
+    __text_misses++;
+
+    TextFont *tf = __text_getFont(font);
+    uint8_t *coverage = NULL;
+    int width = 0, height = size;
+
+    if (tf != NULL && TTF_GetFontStyle(font) == TTF_STYLE_NORMAL)
+        coverage = __text_layout(tf, text, &width);
+    if (coverage == NULL)
+        coverage = __text_layoutFallback(font, text, &width, &height);
+    if (coverage == NULL)
+        return NULL;
+
+    SDL_Surface *surface = __text_compose(coverage, width, height, color, shadow, alpha);
+    free(coverage);
+
+    if (surface == NULL)
+        return NULL;
+
+    if ((label = (TextLabel *)calloc(1, sizeof(TextLabel))) == NULL ||
+        (label->text = strdup(text)) == NULL) {
+        print_debug("text_render: out of memory");
+        free(label);
+        SDL_FreeSurface(surface);
+        return NULL;
+    }
+
+    label->font = font;
+    label->size = size;
+    label->color = key_color;
+    label->shadow = shadow;
+    label->hash = hash;
+    label->surface = surface;
+    label->chain = __text_buckets[hash % TEXT_CACHE_BUCKETS];
+    __text_buckets[hash % TEXT_CACHE_BUCKETS] = label;
+    __text_lruPush(label);
+    __text_label_count++;
+    __text_label_bytes += (size_t)surface->pitch * surface->h;
+
+    while (__text_lru_tail != label &&
+           (__text_label_count > TEXT_CACHE_LABELS || __text_label_bytes > TEXT_CACHE_BYTES))
+        __text_removeLabel(__text_lru_tail);
+
+    return surface;
+}
+
+/**
+ * @brief Renders a label through the cache, as TTF_RenderUTF8_Blended would.
+ *
+ * @return SDL_Surface* Owned by the cache (see text_renderEx)
+ */
+SDL_Surface *text_render(TTF_Font *font, const char *text, SDL_Color color)
+{
+    return text_renderEx(font, text, color, false, SDL_ALPHA_OPAQUE);
+}
+
+/**
+ * @brief Drops the labels and the atlas of a font, call it before closing
+ * the font.
+ */
+void text_releaseFont(TTF_Font *font)
+{
+    TextLabel *label = __text_lru_head;
+
+    while (label != NULL) {
+        TextLabel *next = label->lru_next;
+        if (label->font == font)
+            __text_removeLabel(label);
+        label = next;
+    }
+
+    for (TextFont **link = &__text_fonts; *link != NULL; link = &(*link)->next) {
+        if ((*link)->font == font) {
+            TextFont *tf = *link;
+            *link = tf->next;
+            __text_freeFont(tf);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Frees all the cached labels and atlases.
+ */
+void text_cacheFree(void)
+{
+    while (__text_lru_head != NULL)
+        __text_removeLabel(__text_lru_head);
+
+    while (__text_fonts != NULL) {
+        TextFont *tf = __text_fonts;
+        __text_fonts = tf->next;
+        __text_freeFont(tf);
+    }
+}
+
+#endif // THEME_TEXT_H__
@@ -0,0 +1,84 @@
+#ifndef UTILS_ARENA_H__
+#define UTILS_ARENA_H__
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 8
+#define ARENA_MIN_BLOCK_SIZE 4096
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+/**
+ * @brief Bump allocator: allocations are never freed individually, the whole
+ * arena is released at once with arena_free(). Zero-initialize before use.
+ */
+typedef struct {
+    ArenaBlock *head;
+} Arena;
+
+/**
+ * @brief Allocates `size` bytes (8-byte aligned) from the arena. Blocks grow
+ * geometrically, so loading n items costs O(log n) mallocs.
+ *
+ * @return void* Uninitialized memory, or NULL when out of memory
+ */
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = block != NULL ? block->size * 2 : ARENA_MIN_BLOCK_SIZE;
+        while (block_size < size)
+            block_size *= 2;
+
+        ArenaBlock *new_block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + block_size);
+        if (new_block == NULL)
+            return NULL;
+
+        new_block->next = block;
+        new_block->size = block_size;
+        new_block->used = 0;
+        arena->head = block = new_block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+/**
+ * @brief Copies a string into the arena.
+ *
+ * @return char* The copy, or NULL if `str` is NULL
+ */
+char *arena_strdup(Arena *arena, const char *str)
+{
+    if (str == NULL)
+        return NULL;
+    size_t len = strlen(str) + 1;
+    char *copy = (char *)arena_alloc(arena, len);
+    if (copy != NULL)
+        memcpy(copy, str, len);
+    return copy;
+}
+
+void arena_free(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+#endif // UTILS_ARENA_H__
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <sys/stat.h>
 
+#include "configStore.h"
 #include "file.h"
 #include "flags.h"
 #include "log.h"
@@ -15,60 +16,37 @@
 #define CONFIG_INT "%d"
 #define CONFIG_STR "%[^\n]"
 
-bool config_flag_get(const char *key) { return flag_get(CONFIG_PATH, key); }
+static inline bool config_flag_get(const char *key) { return config_store_exists(key); }
 
-void config_flag_set(const char *key, bool value)
+static inline void config_flag_set(const char *key, bool value)
 {
     char hidden_flag[STR_MAX];
     concat(hidden_flag, key, "_");
-    flag_set(CONFIG_PATH, key, value);
-    flag_set(CONFIG_PATH, hidden_flag, !value);
+    config_store_setFlag(key, value);
+    config_store_setFlag(hidden_flag, !value);
 }
 
-bool config_get(const char *key, const char *format, void *dest)
+static inline bool config_get(const char *key, const char *format, void *dest)
 {
-    FILE *fp;
+    char value[CONFIG_STORE_VALUE_MAX];
 
-    char filename[STR_MAX];
-    concat(filename, CONFIG_PATH, key);
+    if (!config_store_get(key, value, sizeof(value)))
+        return false;
 
-    if (exists(filename)) {
-        file_get(fp, filename, format, dest);
-        return true;
-    }
-
-    return false;
-}
-
-void _config_prepare(const char *key, char *filename)
-{
-    concat(filename, CONFIG_PATH, key);
-
-    char dir_path[STR_MAX];
-    strcpy(dir_path, filename);
-    dirname(dir_path);
-
-    if (!exists(dir_path)) {
-        char dir_cmd[512];
-        sprintf(dir_cmd, "mkdir -p \"%s\"", dir_path);
-        system(dir_cmd);
-    }
+    sscanf(value, format, dest);
+    return true;
 }
 
-void config_setNumber(const char *key, int value)
+static inline void config_setNumber(const char *key, int value)
 {
-    FILE *fp;
-    char filename[STR_MAX];
-    _config_prepare(key, filename);
-    file_put_sync(fp, filename, "%d", value);
+    char value_str[32];
+    sprintf(value_str, "%d", value);
+    config_store_set(key, value_str);
 }
 
-void config_setString(const char *key, char *value)
+static inline void config_setString(const char *key, char *value)
 {
-    FILE *fp;
-    char filename[STR_MAX];
-    _config_prepare(key, filename);
-    file_put_sync(fp, filename, "%s", value);
+    config_store_set(key, value);
 }
 
 #endif // CONFIG_H__
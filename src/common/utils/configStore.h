@@ -0,0 +1,704 @@
+#ifndef UTILS_CONFIG_STORE_H__
+#define UTILS_CONFIG_STORE_H__
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "file.h"
+#include "log.h"
+#include "str.h"
+
+/**
+ * Config store: an index of the config directory (one file per key, which
+ * stays the source of truth since scripts read and write it directly) that
+ * is loaded with a single read into a hash table.
+ *
+ * Each directory is listed once and its mtime recorded: while it is
+ * unchanged, flag lookups are answered from the table. Value files are
+ * validated by mtime and size with a stat, and only re-read when they
+ * changed. Timestamps within CONFIG_STORE_RACY_S of the time they were
+ * recorded aren't trusted (the change may have happened in the same tick).
+ *
+ * Writes go to the legacy file (atomically) and update the table, and
+ * registered callbacks are told which key changed. The index is written
+ * back (atomically) by config_store_save(), and at exit.
+ */
+
+#define CONFIG_STORE_SLOTS 512 // power of two
+#define CONFIG_STORE_VALUE_MAX 256
+#define CONFIG_STORE_RECHECK_MS 100
+#define CONFIG_STORE_RACY_S 2
+#define CONFIG_STORE_MAX_CALLBACKS 8
+#define CONFIG_STORE_MAX_PENDING 16
+#define CONFIG_STORE_MAGIC "onion-config-store 1"
+
+typedef void (*ConfigChangeCallback)(const char *key);
+
+typedef struct {
+    char *key;         // path relative to the config root (dirs end with '/'), NULL if unused
+    bool exists;       //
+    bool loaded;       // `value` holds the file contents
+    char *value;       //
+    time_t mtime;      // when listed (dirs) or read (files), 0 if not trusted
+    off_t size;        //
+    uint64_t checked;  // last validation, in-process only
+} ConfigStoreEntry;
+
+// Config root (ends with '/') and index file, changeable for tests
+static char config_store_root[STR_MAX] = "/mnt/SDCARD/.tmp_update/config/";
+static char config_store_path[STR_MAX] = "/mnt/SDCARD/.tmp_update/config.store";
+
+static ConfigStoreEntry __config_store[CONFIG_STORE_SLOTS];
+static pthread_mutex_t __config_store_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool __config_store_loaded = false;
+static bool __config_store_dirty = false;
+
+static ConfigChangeCallback __config_store_callbacks[CONFIG_STORE_MAX_CALLBACKS];
+static int __config_store_callback_count = 0;
+static char __config_store_pending[CONFIG_STORE_MAX_PENDING][STR_MAX];
+static int __config_store_pending_count = 0;
+static bool __config_store_quiet = false; // first listing, nothing "changed"
+
+static uint64_t __config_store_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t __config_store_hash(const char *key)
+{
+    uint32_t hash = 2166136261u;
+    while (*key) {
+        hash ^= (unsigned char)*key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot of `key`, optionally inserting it (as not existing).
+ *
+ * @return ConfigStoreEntry* NULL if not found, or the table is full
+ */
+static ConfigStoreEntry *__config_store_slot(const char *key, bool insert)
+{
+    uint32_t i = __config_store_hash(key) & (CONFIG_STORE_SLOTS - 1);
+
+    for (int probe = 0; probe < CONFIG_STORE_SLOTS; probe++) {
+        ConfigStoreEntry *entry = &__config_store[i];
+        if (entry->key == NULL) {
+            if (!insert)
+                return NULL;
+            memset(entry, 0, sizeof(ConfigStoreEntry));
+            entry->key = strdup(key);
+            return entry;
+        }
+        if (strcmp(entry->key, key) == 0)
+            return entry;
+        i = (i + 1) & (CONFIG_STORE_SLOTS - 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief The key of the directory containing `key` ("./" for the root).
+ */
+static void __config_store_dirOf(const char *key, char *dir_out)
+{
+    const char *sep = strrchr(key, '/');
+    if (sep == NULL) {
+        strcpy(dir_out, "./");
+        return;
+    }
+    size_t len = sep - key + 1;
+    memcpy(dir_out, key, len);
+    dir_out[len] = '\0';
+}
+
+static void __config_store_fullPath(const char *key, char *path_out)
+{
+    if (strcmp(key, "./") == 0)
+        strcpy(path_out, config_store_root);
+    else
+        concat(path_out, config_store_root, key);
+}
+
+static time_t __config_store_trustedMtime(time_t mtime)
+{
+    return mtime >= time(NULL) - CONFIG_STORE_RACY_S ? 0 : mtime;
+}
+
+static void __config_store_notify(const char *key)
+{
+    if (__config_store_callback_count == 0 || __config_store_quiet)
+        return;
+    if (__config_store_pending_count < CONFIG_STORE_MAX_PENDING)
+        strncpy(__config_store_pending[__config_store_pending_count], key, STR_MAX - 1);
+    __config_store_pending_count++;
+}
+
+/**
+ * @brief Runs the change callbacks (without holding the lock, so they can
+ * read the config).
+ */
+static void __config_store_dispatch(void)
+{
+    char pending[CONFIG_STORE_MAX_PENDING][STR_MAX];
+    ConfigChangeCallback callbacks[CONFIG_STORE_MAX_CALLBACKS];
+    int count, callback_count;
+
+    pthread_mutex_lock(&__config_store_lock);
+    count = __config_store_pending_count;
+    callback_count = __config_store_callback_count;
+    if (count > CONFIG_STORE_MAX_PENDING)
+        count = CONFIG_STORE_MAX_PENDING;
+    memcpy(pending, __config_store_pending, count * STR_MAX);
+    memcpy(callbacks, __config_store_callbacks, sizeof(callbacks));
+    // Overflowed: report "everything changed" once
+    bool overflow = __config_store_pending_count > CONFIG_STORE_MAX_PENDING;
+    __config_store_pending_count = 0;
+    pthread_mutex_unlock(&__config_store_lock);
+
+    for (int i = 0; i < callback_count; i++) {
+        if (overflow)
+            callbacks[i](NULL);
+        else
+            for (int j = 0; j < count; j++)
+                callbacks[i](pending[j]);
+    }
+}
+
+static void __config_store_setExists(ConfigStoreEntry *entry, bool exists)
+{
+    if (entry->exists == exists)
+        return;
+    entry->exists = exists;
+    if (!exists) {
+        free(entry->value);
+        entry->value = NULL;
+        entry->loaded = false;
+    }
+    __config_store_dirty = true;
+    __config_store_notify(entry->key);
+}
+
+static void __config_store_setValue(ConfigStoreEntry *entry, const char *value, time_t mtime, off_t size)
+{
+    bool changed = !entry->loaded || strcmp(entry->value, value) != 0;
+    // Only a known value (or absence) can change, the first read can't
+    bool notify = !entry->exists || (entry->loaded && changed);
+
+    if (changed) {
+        free(entry->value);
+        entry->value = strdup(value);
+    }
+    if (changed || entry->mtime != mtime || entry->size != size)
+        __config_store_dirty = true;
+
+    entry->exists = true;
+    entry->loaded = true;
+    entry->mtime = mtime;
+    entry->size = size;
+
+    if (notify)
+        __config_store_notify(entry->key);
+}
+
+/**
+ * @brief Lists a directory, updating which of its keys exist.
+ */
+static void __config_store_scanDir(ConfigStoreEntry *dir_entry, time_t mtime)
+{
+    char path[STR_MAX];
+    bool is_root = strcmp(dir_entry->key, "./") == 0;
+    size_t prefix_len = is_root ? 0 : strlen(dir_entry->key);
+
+    __config_store_fullPath(dir_entry->key, path);
+    DIR *dir = mtime != -1 ? opendir(path) : NULL;
+    struct dirent *ent;
+    bool listed[CONFIG_STORE_SLOTS] = {false};
+
+    __config_store_quiet = !dir_entry->exists && dir_entry->mtime != -1;
+
+    while (dir != NULL && (ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.' && (ent->d_name[1] == '\0' || strcmp(ent->d_name, "..") == 0))
+            continue;
+        if (ent->d_type == DT_DIR)
+            continue;
+
+        char key[STR_MAX];
+        snprintf(key, STR_MAX, "%s%s", is_root ? "" : dir_entry->key, ent->d_name);
+        ConfigStoreEntry *entry = __config_store_slot(key, true);
+        if (entry == NULL)
+            continue;
+        __config_store_setExists(entry, true);
+        listed[entry - __config_store] = true;
+    }
+    if (dir != NULL)
+        closedir(dir);
+
+    // Keys of this directory that are gone
+    for (int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        ConfigStoreEntry *entry = &__config_store[i];
+        if (entry->key == NULL || listed[i] || !entry->exists)
+            continue;
+        const char *name = entry->key + prefix_len;
+        if (strncmp(entry->key, dir_entry->key, prefix_len) != 0 || strchr(name, '/') != NULL)
+            continue;
+        __config_store_setExists(entry, false);
+    }
+
+    __config_store_quiet = false;
+    dir_entry->exists = mtime != -1;
+    dir_entry->mtime = mtime == -1 ? -1 : __config_store_trustedMtime(mtime);
+    __config_store_dirty = true;
+}
+
+/**
+ * @brief Makes sure the directory listing of `key`'s directory is current.
+ */
+static ConfigStoreEntry *__config_store_validateDir(const char *key, uint64_t now)
+{
+    char dir_key[STR_MAX];
+    __config_store_dirOf(key, dir_key);
+
+    ConfigStoreEntry *dir_entry = __config_store_slot(dir_key, true);
+    if (dir_entry == NULL)
+        return NULL;
+
+    if (dir_entry->checked != 0 && now - dir_entry->checked < CONFIG_STORE_RECHECK_MS)
+        return dir_entry;
+
+    char path[STR_MAX];
+    struct stat st;
+    __config_store_fullPath(dir_key, path);
+    time_t mtime = stat(path, &st) == 0 ? st.st_mtime : -1;
+
+    if (mtime != dir_entry->mtime || dir_entry->mtime == 0)
+        __config_store_scanDir(dir_entry, mtime);
+
+    dir_entry->checked = now;
+    return dir_entry;
+}
+
+/**
+ * @brief Makes sure the value of `key` is current (re-reads the file if it
+ * changed). Values too large for the table are left unloaded.
+ */
+static void __config_store_validateValue(ConfigStoreEntry *entry, uint64_t now)
+{
+    if (entry->loaded && entry->checked != 0 && now - entry->checked < CONFIG_STORE_RECHECK_MS)
+        return;
+
+    char path[STR_MAX];
+    struct stat st;
+    __config_store_fullPath(entry->key, path);
+
+    if (stat(path, &st) != 0) {
+        __config_store_setExists(entry, false);
+        return;
+    }
+
+    entry->checked = now;
+
+    if (entry->loaded && entry->mtime != 0 && entry->mtime == st.st_mtime && entry->size == st.st_size)
+        return;
+
+    if (st.st_size >= CONFIG_STORE_VALUE_MAX) {
+        free(entry->value);
+        entry->value = NULL;
+        entry->loaded = false;
+        return;
+    }
+
+    char value[CONFIG_STORE_VALUE_MAX];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return;
+    ssize_t len = read(fd, value, sizeof(value) - 1);
+    close(fd);
+    if (len < 0)
+        return;
+    value[len] = '\0';
+
+    __config_store_setValue(entry, value, __config_store_trustedMtime(st.st_mtime), st.st_size);
+}
+
+static void __config_store_escape(FILE *fp, const char *value)
+{
+    for (const char *c = value; *c; c++) {
+        if (*c == '\\')
+            fputs("\\\\", fp);
+        else if (*c == '\n')
+            fputs("\\n", fp);
+        else if (*c == '\t')
+            fputs("\\t", fp);
+        else
+            fputc(*c, fp);
+    }
+}
+
+static void __config_store_unescape(char *value)
+{
+    char *out = value;
+    for (char *c = value; *c; c++) {
+        if (*c == '\\' && c[1] != '\0') {
+            c++;
+            *out++ = *c == 'n' ? '\n' : *c == 't' ? '\t' : *c;
+        }
+        else {
+            *out++ = *c;
+        }
+    }
+    *out = '\0';
+}
+
+/**
+ * @brief Parses one line of the index file:
+ * `d <mtime> <dir>`, `f <mtime> <size> <key> <value>` or `p <key>`
+ * (tab separated).
+ */
+static bool __config_store_parseLine(char *line)
+{
+    char *fields[5] = {NULL};
+    int count = 0;
+
+    fields[count++] = line;
+    for (char *c = line; *c && count < 5; c++) {
+        if (*c == '\t') {
+            *c = '\0';
+            fields[count++] = c + 1;
+        }
+    }
+
+    ConfigStoreEntry *entry;
+
+    if (strcmp(fields[0], "d") == 0 && count == 3) {
+        if ((entry = __config_store_slot(fields[2], true)) == NULL)
+            return false;
+        entry->mtime = atoll(fields[1]);
+        entry->exists = entry->mtime != -1;
+    }
+    else if (strcmp(fields[0], "f") == 0 && count == 5) {
+        if ((entry = __config_store_slot(fields[3], true)) == NULL)
+            return false;
+        __config_store_unescape(fields[4]);
+        entry->exists = true;
+        entry->loaded = true;
+        entry->value = strdup(fields[4]);
+        entry->mtime = atoll(fields[1]);
+        entry->size = atoll(fields[2]);
+    }
+    else if (strcmp(fields[0], "p") == 0 && count == 2) {
+        if ((entry = __config_store_slot(fields[1], true)) == NULL)
+            return false;
+        entry->exists = true;
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+static void __config_store_clear(void)
+{
+    for (int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        free(__config_store[i].key);
+        free(__config_store[i].value);
+    }
+    memset(__config_store, 0, sizeof(__config_store));
+}
+
+/**
+ * @brief Loads the index file with a single read. A missing, truncated or
+ * unreadable index is simply rebuilt from the config directory.
+ */
+static void __config_store_load(void)
+{
+    int fd = open(config_store_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    char *data = NULL;
+    bool valid = false;
+
+    if (fd != -1 && fstat(fd, &st) == 0 && st.st_size > 0 && (data = (char *)malloc(st.st_size + 1)) != NULL) {
+        ssize_t len = read(fd, data, st.st_size);
+        data[len > 0 ? len : 0] = '\0';
+
+        char *line = data, *next;
+        size_t magic_len = strlen(CONFIG_STORE_MAGIC);
+        if (len > 0 && strncmp(line, CONFIG_STORE_MAGIC "\n", magic_len + 1) == 0) {
+            line += magic_len + 1;
+            while ((next = strchr(line, '\n')) != NULL) {
+                *next = '\0';
+                if (strcmp(line, "end") == 0) {
+                    valid = true;
+                    break;
+                }
+                if (!__config_store_parseLine(line))
+                    break;
+                line = next + 1;
+            }
+        }
+    }
+
+    if (fd != -1)
+        close(fd);
+    free(data);
+
+    if (!valid) {
+        __config_store_clear();
+        __config_store_dirty = true;
+    }
+}
+
+static inline void config_store_save(void);
+
+static void __config_store_ensureLoaded(void)
+{
+    if (__config_store_loaded)
+        return;
+    __config_store_loaded = true;
+    __config_store_load();
+    atexit(config_store_save);
+}
+
+/**
+ * @brief Writes the index back (atomically) if anything changed.
+ */
+static inline void config_store_save(void)
+{
+    pthread_mutex_lock(&__config_store_lock);
+
+    if (!__config_store_loaded || !__config_store_dirty) {
+        pthread_mutex_unlock(&__config_store_lock);
+        return;
+    }
+
+    char tmp_path[STR_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", config_store_path);
+    FILE *fp = fopen(tmp_path, "w");
+
+    if (fp != NULL) {
+        fputs(CONFIG_STORE_MAGIC "\n", fp);
+        for (int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+            ConfigStoreEntry *entry = &__config_store[i];
+            if (entry->key == NULL)
+                continue;
+            size_t key_len = strlen(entry->key);
+            if (entry->key[key_len - 1] == '/')
+                fprintf(fp, "d\t%lld\t%s\n", (long long)entry->mtime, entry->key);
+            else if (entry->exists && entry->loaded) {
+                fprintf(fp, "f\t%lld\t%lld\t%s\t", (long long)entry->mtime, (long long)entry->size, entry->key);
+                __config_store_escape(fp, entry->value);
+                fputc('\n', fp);
+            }
+            else if (entry->exists)
+                fprintf(fp, "p\t%s\n", entry->key);
+        }
+        fputs("end\n", fp);
+
+        if (fclose(fp) == 0 && rename(tmp_path, config_store_path) == 0)
+            __config_store_dirty = false;
+        else
+            remove(tmp_path);
+    }
+
+    pthread_mutex_unlock(&__config_store_lock);
+}
+
+/**
+ * @brief Drops the in-memory table; the next lookup reloads the index.
+ */
+static inline void config_store_reset(void)
+{
+    pthread_mutex_lock(&__config_store_lock);
+    __config_store_clear();
+    __config_store_loaded = false;
+    __config_store_dirty = false;
+    __config_store_pending_count = 0;
+    pthread_mutex_unlock(&__config_store_lock);
+}
+
+/**
+ * @brief Registers a callback that is called with the key (NULL if too many
+ * changed at once) whenever a value or flag is seen to change, either by a
+ * write through the store or when a changed file is noticed.
+ */
+static inline bool config_store_onChange(ConfigChangeCallback callback)
+{
+    bool added = false;
+    pthread_mutex_lock(&__config_store_lock);
+    if (__config_store_callback_count < CONFIG_STORE_MAX_CALLBACKS) {
+        __config_store_callbacks[__config_store_callback_count++] = callback;
+        added = true;
+    }
+    pthread_mutex_unlock(&__config_store_lock);
+    return added;
+}
+
+/**
+ * @brief Whether `key` exists (a flag is set).
+ */
+static inline bool config_store_exists(const char *key)
+{
+    bool result;
+    char path[STR_MAX];
+
+    pthread_mutex_lock(&__config_store_lock);
+    __config_store_ensureLoaded();
+
+    ConfigStoreEntry *entry = NULL;
+    if (__config_store_validateDir(key, __config_store_now_ms()) != NULL)
+        entry = __config_store_slot(key, true);
+
+    if (entry != NULL) {
+        result = entry->exists;
+    }
+    else {
+        concat(path, config_store_root, key);
+        result = exists(path);
+    }
+
+    pthread_mutex_unlock(&__config_store_lock);
+    __config_store_dispatch();
+    return result;
+}
+
+/**
+ * @brief Copies the contents of `key` to `value_out` (of `size` bytes).
+ *
+ * @return true The key exists
+ */
+static inline bool config_store_get(const char *key, char *value_out, size_t size)
+{
+    bool found = false;
+    uint64_t now = __config_store_now_ms();
+
+    pthread_mutex_lock(&__config_store_lock);
+    __config_store_ensureLoaded();
+
+    ConfigStoreEntry *entry = NULL;
+    if (__config_store_validateDir(key, now) != NULL)
+        entry = __config_store_slot(key, true);
+
+    if (entry != NULL && entry->exists)
+        __config_store_validateValue(entry, now);
+
+    if (entry != NULL && entry->exists && entry->loaded) {
+        strncpy(value_out, entry->value, size - 1);
+        value_out[size - 1] = '\0';
+        found = true;
+    }
+    else if (entry == NULL || entry->exists) {
+        // Not cacheable (large file, full table): read it directly
+        char path[STR_MAX];
+        concat(path, config_store_root, key);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd != -1) {
+            ssize_t len = read(fd, value_out, size - 1);
+            value_out[len > 0 ? len : 0] = '\0';
+            close(fd);
+            found = true;
+        }
+    }
+
+    pthread_mutex_unlock(&__config_store_lock);
+    __config_store_dispatch();
+    return found;
+}
+
+/**
+ * @brief Writes `value` to the file of `key` (atomically, creating its
+ * directory if needed) and updates the table.
+ */
+static inline bool config_store_set(const char *key, const char *value)
+{
+    char path[STR_MAX], tmp_path[STR_MAX + 8], dir_path[STR_MAX];
+    bool success = false;
+
+    concat(path, config_store_root, key);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    strcpy(dir_path, path);
+    dirname(dir_path);
+
+    pthread_mutex_lock(&__config_store_lock);
+    __config_store_ensureLoaded();
+
+    if (!exists(dir_path))
+        mkdirs(dir_path);
+
+    size_t len = strlen(value);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd != -1) {
+        success = write(fd, value, len) == (ssize_t)len;
+        fsync(fd);
+        close(fd);
+        success = success && rename(tmp_path, path) == 0;
+        if (!success)
+            remove(tmp_path);
+    }
+
+    struct stat st;
+    ConfigStoreEntry *entry = __config_store_slot(key, true);
+    if (entry != NULL && success && len < CONFIG_STORE_VALUE_MAX && stat(path, &st) == 0) {
+        if (entry->exists && !entry->loaded)
+            __config_store_notify(key); // previous value unknown
+        __config_store_setValue(entry, value, __config_store_trustedMtime(st.st_mtime), st.st_size);
+        entry->checked = __config_store_now_ms();
+    }
+    else if (entry != NULL) {
+        entry->loaded = false; // re-read on the next lookup
+        entry->checked = 0;
+        __config_store_setExists(entry, exists(path));
+    }
+
+    pthread_mutex_unlock(&__config_store_lock);
+    __config_store_dispatch();
+    return success;
+}
+
+/**
+ * @brief Creates (empty) or removes the file of `key`.
+ */
+static inline void config_store_setFlag(const char *key, bool value)
+{
+    char path[STR_MAX];
+    concat(path, config_store_root, key);
+
+    pthread_mutex_lock(&__config_store_lock);
+    __config_store_ensureLoaded();
+
+    int fd = -1;
+    if (value && (fd = creat(path, 0777)) != -1)
+        close(fd);
+    else if (!value)
+        remove(path);
+
+    ConfigStoreEntry *entry = __config_store_slot(key, true);
+    if (entry != NULL) {
+        __config_store_setExists(entry, fd != -1);
+        // creat() truncates: drop the cached contents
+        free(entry->value);
+        entry->value = NULL;
+        entry->loaded = false;
+        entry->checked = 0;
+    }
+
+    pthread_mutex_unlock(&__config_store_lock);
+    __config_store_dispatch();
+}
+
+#endif // UTILS_CONFIG_STORE_H__
@@ -0,0 +1,119 @@
+#ifndef UTILS_DIRTY_RECTS_H__
+#define UTILS_DIRTY_RECTS_H__
+
+#include <SDL/SDL.h>
+#include <stdbool.h>
+
+#define DIRTY_RECTS_MAX 8
+
+/**
+ * @brief Damage tracking: elements report the rectangles they changed, and
+ * only those are composed (through the clip rect) and uploaded to the video
+ * surface. Zero-initialize before use.
+ */
+typedef struct {
+    SDL_Rect rects[DIRTY_RECTS_MAX];
+    int count;
+    SDL_Rect bounds;
+} DirtyRects;
+
+static bool __dirty_overlaps(const SDL_Rect *a, const SDL_Rect *b)
+{
+    return a->x < b->x + b->w && b->x < a->x + a->w &&
+           a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+static SDL_Rect __dirty_union(const SDL_Rect *a, const SDL_Rect *b)
+{
+    int x1 = a->x < b->x ? a->x : b->x;
+    int y1 = a->y < b->y ? a->y : b->y;
+    int x2 = a->x + a->w > b->x + b->w ? a->x + a->w : b->x + b->w;
+    int y2 = a->y + a->h > b->y + b->h ? a->y + a->h : b->y + b->h;
+    return (SDL_Rect){x1, y1, x2 - x1, y2 - y1};
+}
+
+bool dirty_isEmpty(const DirtyRects *dirty) { return dirty->count == 0; }
+
+/**
+ * @brief Marks a rectangle of `surface` as changed. Overlapping rectangles
+ * are merged; when the list is full, everything collapses into the bounding
+ * box.
+ */
+void dirty_add(DirtyRects *dirty, SDL_Surface *surface, SDL_Rect rect)
+{
+    // Clip to the surface
+    int x1 = rect.x > 0 ? rect.x : 0;
+    int y1 = rect.y > 0 ? rect.y : 0;
+    int x2 = rect.x + rect.w < surface->w ? rect.x + rect.w : surface->w;
+    int y2 = rect.y + rect.h < surface->h ? rect.y + rect.h : surface->h;
+
+    if (x2 <= x1 || y2 <= y1)
+        return;
+
+    rect = (SDL_Rect){x1, y1, x2 - x1, y2 - y1};
+
+    // Merge with every rect it overlaps (merging can create new overlaps)
+    for (int i = 0; i < dirty->count; i++) {
+        if (__dirty_overlaps(&dirty->rects[i], &rect)) {
+            rect = __dirty_union(&dirty->rects[i], &rect);
+            dirty->rects[i] = dirty->rects[--dirty->count];
+            i = -1;
+        }
+    }
+
+    dirty->bounds = dirty->count == 0 ? rect : __dirty_union(&dirty->bounds, &rect);
+
+    if (dirty->count == DIRTY_RECTS_MAX) {
+        dirty->rects[0] = dirty->bounds;
+        dirty->count = 1;
+        return;
+    }
+
+    dirty->rects[dirty->count++] = rect;
+}
+
+void dirty_addFull(DirtyRects *dirty, SDL_Surface *surface)
+{
+    dirty_add(dirty, surface, (SDL_Rect){0, 0, surface->w, surface->h});
+}
+
+/**
+ * @brief Whether `rect` needs to be redrawn.
+ */
+bool dirty_intersects(const DirtyRects *dirty, SDL_Rect rect)
+{
+    for (int i = 0; i < dirty->count; i++) {
+        if (__dirty_overlaps(&dirty->rects[i], &rect))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Restricts drawing on `surface` to the damaged area.
+ */
+void dirty_clip(const DirtyRects *dirty, SDL_Surface *surface)
+{
+    SDL_Rect bounds = dirty->bounds;
+    SDL_SetClipRect(surface, &bounds);
+}
+
+/**
+ * @brief Uploads the damaged rectangles of `screen` to `video`, flips and
+ * resets the damage.
+ */
+void dirty_flip(DirtyRects *dirty, SDL_Surface *screen, SDL_Surface *video)
+{
+    SDL_SetClipRect(screen, NULL);
+
+    for (int i = 0; i < dirty->count; i++) {
+        SDL_Rect src = dirty->rects[i];
+        SDL_Rect dst = dirty->rects[i];
+        SDL_BlitSurface(screen, &src, video, &dst);
+    }
+
+    SDL_Flip(video);
+    dirty->count = 0;
+}
+
+#endif // UTILS_DIRTY_RECTS_H__
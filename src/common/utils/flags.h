@@ -12,14 +12,14 @@
 #define temp_flag_get(key) flag_get("/tmp/", key)
 #define temp_flag_set(key, value) flag_set("/tmp/", key, value)
 
-bool flag_get(const char *path, const char *key)
+static inline bool flag_get(const char *path, const char *key)
 {
     char filename[STR_MAX];
     concat(filename, path, key);
     return exists(filename);
 }
 
-void flag_set(const char *path, const char *key, bool value)
+static inline void flag_set(const char *path, const char *key, bool value)
 {
     char filename[STR_MAX];
     concat(filename, path, key);
@@ -1,110 +1,341 @@
 #include <SDL/SDL.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
 
 #include "imageCache.h"
 #include "utils/log.h"
 
-#define IMAGECACHE_MAXSIZE 50
+static uint32_t __imageCache_ticks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
 
-static pthread_t thread_pt;
-static bool thread_active = false;
+static bool __imageCache_inWindow(ImageCache *cache, int index)
+{
+    return index >= cache->window_start && index <= cache->window_end;
+}
 
-static const int image_cache_len = IMAGECACHE_MAXSIZE;
-static SDL_Surface *image_cache[IMAGECACHE_MAXSIZE] = {NULL};
-static int image_cache_offset = -1;
+/**
+ * @brief Places the window around the focus: `capacity` images, more of
+ * them ahead than behind when the focus is moving.
+ */
+static void __imageCache_updateWindow(ImageCache *cache)
+{
+    int span = cache->capacity - 1;
+    int lead = (int)(cache->velocity * IMAGECACHE_LOOKAHEAD_MS / 1000);
+    int ahead = span / 2 + lead;
 
-static SDL_Surface *(*load_image)(int) = NULL;
-static int images_total = 0;
+    // One is kept behind, for a step back
+    if (ahead > span - 1)
+        ahead = span > 1 ? span - 1 : span;
+
+    int behind = span - ahead;
+    int start = cache->direction > 0 ? cache->focus - behind : cache->focus - ahead;
+    int end = start + span;
+
+    if (start < 0) {
+        end -= start;
+        start = 0;
+    }
+    if (end >= cache->total) {
+        start -= end - cache->total + 1;
+        end = cache->total - 1;
+    }
+    if (start < 0)
+        start = 0;
 
-int modulo(int x, int n) { return (x % n + n) % n; }
+    cache->window_start = start;
+    cache->window_end = end;
+}
 
-static void *_imageCacheThread(void *param)
+/**
+ * @brief Next image to load: nearest to the focus first, two ahead for one
+ * behind.
+ *
+ * @return int Index, -1 if the whole window is loaded
+ */
+static int __imageCache_next(ImageCache *cache)
 {
-    int offset = *((int *)param) - image_cache_len / 2;
-    int start = image_cache_offset - image_cache_len + 1;
-    int end = image_cache_offset;
+    int ahead = 0, behind = 0, turn = 0;
+
+    while (true) {
+        int index;
+        bool has_ahead = __imageCache_inWindow(cache, cache->focus + (ahead + 1) * cache->direction);
+        bool has_behind = __imageCache_inWindow(cache, cache->focus - (behind + 1) * cache->direction);
+
+        if (turn == 0 && ahead == 0 && behind == 0)
+            index = cache->focus;
+        else if (has_ahead && (turn % 3 != 2 || !has_behind))
+            index = cache->focus + ++ahead * cache->direction;
+        else if (has_behind)
+            index = cache->focus - ++behind * cache->direction;
+        else
+            return -1;
+        turn++;
+
+        if (!__imageCache_inWindow(cache, index) || index == cache->held)
+            continue;
 
-    if (offset > images_total - image_cache_len)
-        offset = images_total - image_cache_len;
-    if (offset < 0)
-        offset = 0;
+        ImageCacheSlot *slot = &cache->slots[index % cache->capacity];
+        if (slot->index != index || slot->state == IMAGECACHE_EMPTY)
+            return index;
+    }
+}
+
+static void *__imageCache_worker(void *param)
+{
+    ImageCache *cache = (ImageCache *)param;
 
-    for (int i = 0; i < image_cache_len; i++) {
-        int curr = offset + i;
+    pthread_mutex_lock(&cache->lock);
 
-        if (curr >= images_total)
-            break;
+    while (!cache->quit) {
+        int index = __imageCache_next(cache);
 
-        if (curr >= start && curr <= end)
+        if (index < 0) {
+            pthread_cond_wait(&cache->wake, &cache->lock);
             continue;
+        }
 
-        int idx = modulo(curr, image_cache_len);
+        ImageCacheSlot *slot = &cache->slots[index % cache->capacity];
 
-        if (image_cache[idx] != NULL)
-            SDL_FreeSurface(image_cache[idx]);
+        // Evicted: freed now, or when its last user releases it
+        if (slot->surface != NULL)
+            SDL_FreeSurface(slot->surface);
+        slot->surface = NULL;
+        slot->index = index;
+        slot->state = IMAGECACHE_LOADING;
+        cache->loading = index;
 
-        if (load_image != NULL)
-            image_cache[idx] = load_image(curr);
+        pthread_mutex_unlock(&cache->lock);
+        SDL_Surface *surface = cache->load(index, cache->userdata);
+        pthread_mutex_lock(&cache->lock);
+
+        cache->loading = -1;
+        cache->loads++;
+
+        if (slot->index == index && slot->state == IMAGECACHE_LOADING &&
+            __imageCache_inWindow(cache, index) && index != cache->held) {
+            slot->surface = surface;
+            slot->state = surface != NULL ? IMAGECACHE_READY : IMAGECACHE_FAILED;
+        }
+        else {
+            if (surface != NULL)
+                SDL_FreeSurface(surface);
+            if (slot->index == index && slot->state == IMAGECACHE_LOADING)
+                slot->state = IMAGECACHE_EMPTY;
+            cache->discarded++;
+        }
+
+        pthread_cond_broadcast(&cache->loaded);
     }
 
-    image_cache_offset = offset + image_cache_len - 1;
+    pthread_mutex_unlock(&cache->lock);
+    return NULL;
+}
+
+ImageCache *imageCache_create(int capacity, int total, ImageCacheLoader load, void *userdata)
+{
+    ImageCache *cache = (ImageCache *)calloc(1, sizeof(ImageCache));
+
+    if (cache == NULL || capacity <= 0)
+        goto fail;
+
+    if ((cache->slots = (ImageCacheSlot *)calloc(capacity, sizeof(ImageCacheSlot))) == NULL)
+        goto fail;
+
+    for (int i = 0; i < capacity; i++)
+        cache->slots[i].index = -1;
 
-    thread_active = false;
-    return 0;
+    cache->capacity = capacity;
+    cache->total = total;
+    cache->load = load;
+    cache->userdata = userdata;
+    cache->focus = -1;
+    cache->direction = 1;
+    cache->window_start = 0;
+    cache->window_end = -1;
+    cache->loading = -1;
+    cache->held = -1;
+
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->wake, NULL);
+    pthread_cond_init(&cache->loaded, NULL);
+
+    if (pthread_create(&cache->thread, NULL, __imageCache_worker, cache) != 0) {
+        print_debug("imageCache: worker thread failed to start");
+        pthread_mutex_destroy(&cache->lock);
+        pthread_cond_destroy(&cache->wake);
+        pthread_cond_destroy(&cache->loaded);
+        goto fail;
+    }
+
+    return cache;
+
+fail:
+    if (cache != NULL)
+        free(cache->slots);
+    free(cache);
+    return NULL;
 }
 
-void imageCache_load(int *offset, SDL_Surface *(*_load_image)(int), int total)
+void imageCache_free(ImageCache *cache)
 {
-    if (thread_active)
+    if (cache == NULL)
         return;
-    thread_active = true;
-    load_image = _load_image;
-    images_total = total;
-    pthread_create(&thread_pt, NULL, _imageCacheThread, offset);
+
+    pthread_mutex_lock(&cache->lock);
+    cache->quit = true;
+    pthread_cond_broadcast(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+
+    pthread_join(cache->thread, NULL);
+
+    for (int i = 0; i < cache->capacity; i++)
+        if (cache->slots[i].surface != NULL)
+            SDL_FreeSurface(cache->slots[i].surface);
+
+    pthread_mutex_destroy(&cache->lock);
+    pthread_cond_destroy(&cache->wake);
+    pthread_cond_destroy(&cache->loaded);
+    free(cache->slots);
+    free(cache);
 }
 
-void imageCache_removeItem(int image_index)
+void imageCache_focus(ImageCache *cache, int index)
 {
-    int start = image_cache_offset - image_cache_len + 1;
-    int end = image_cache_offset;
-
-    if (image_index < start || image_index > end)
+    if (index < 0 || index >= cache->total)
         return;
 
-    int idx = modulo(image_index, image_cache_len);
+    pthread_mutex_lock(&cache->lock);
+
+    uint32_t now = __imageCache_ticks();
+    int delta = cache->focus < 0 ? 0 : index - cache->focus;
+    uint32_t elapsed = now - cache->focus_ticks;
+
+    if (delta != 0) {
+        int distance = abs(delta);
+        double velocity = distance * 1000.0 / (elapsed > 0 ? elapsed : 1);
+
+        if (distance >= cache->capacity || elapsed > IMAGECACHE_IDLE_MS)
+            cache->velocity = 0; // a jump, or a new start: not scrolling
+        else if ((delta > 0) != (cache->direction > 0))
+            cache->velocity = velocity / 2;
+        else
+            cache->velocity = (cache->velocity + velocity) / 2;
 
-    if (image_cache[idx] != NULL) {
-        printf_debug("Removing image %d (%d)\n", image_index, idx);
-        SDL_FreeSurface(image_cache[idx]);
-        image_cache[idx] = NULL;
+        cache->direction = delta > 0 ? 1 : -1;
+        cache->focus_ticks = now;
     }
+    else if (elapsed > IMAGECACHE_IDLE_MS) {
+        cache->velocity = 0;
+        cache->focus_ticks = now;
+    }
+
+    cache->focus = index;
+    cache->held = -1;
+    __imageCache_updateWindow(cache);
+
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+}
 
-    int num_images =
-        (images_total < image_cache_len ? images_total : image_cache_len) - 1;
-    for (int i = 0; i < num_images; i++) {
-        int curr = modulo(image_index + i, image_cache_len);
-        int next = modulo(image_index + i + 1, image_cache_len);
-        image_cache[curr] = image_cache[next];
-        image_cache[next] = NULL;
+SDL_Surface *imageCache_acquire(ImageCache *cache, int index)
+{
+    SDL_Surface *surface = NULL;
+
+    if (index < 0)
+        return NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    ImageCacheSlot *slot = &cache->slots[index % cache->capacity];
+    if (slot->index == index && slot->state == IMAGECACHE_READY) {
+        surface = slot->surface;
+        surface->refcount++;
     }
+    pthread_mutex_unlock(&cache->lock);
 
-    image_cache_offset = image_index + image_cache_len - 2;
+    return surface;
 }
 
-SDL_Surface *imageCache_getItem(int *index)
+SDL_Surface *imageCache_acquireWait(ImageCache *cache, int index)
 {
-    imageCache_load(index, load_image, images_total);
-    int idx = modulo(*index, image_cache_len);
-    return image_cache[idx];
+    SDL_Surface *surface = NULL;
+
+    if (index < 0)
+        return NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    ImageCacheSlot *slot = &cache->slots[index % cache->capacity];
+
+    while (__imageCache_inWindow(cache, index) && index != cache->held &&
+           !(slot->index == index && (slot->state == IMAGECACHE_READY ||
+                                      slot->state == IMAGECACHE_FAILED)))
+        pthread_cond_wait(&cache->loaded, &cache->lock);
+
+    if (slot->index == index && slot->state == IMAGECACHE_READY) {
+        surface = slot->surface;
+        surface->refcount++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return surface;
 }
 
-bool imageCache_isActive(void) { return thread_active; }
+void imageCache_release(ImageCache *cache, SDL_Surface *surface)
+{
+    if (surface == NULL)
+        return;
 
-void imageCache_freeAll(void)
+    pthread_mutex_lock(&cache->lock);
+    SDL_FreeSurface(surface);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+bool imageCache_isLoaded(ImageCache *cache, int index)
 {
-    for (int i = 0; i < image_cache_len; i++) {
-        if (image_cache[i] != NULL)
-            SDL_FreeSurface(image_cache[i]);
+    bool loaded = false;
+
+    if (index < 0)
+        return false;
+
+    pthread_mutex_lock(&cache->lock);
+    ImageCacheSlot *slot = &cache->slots[index % cache->capacity];
+    loaded = slot->index == index && (slot->state == IMAGECACHE_READY ||
+                                      slot->state == IMAGECACHE_FAILED);
+    pthread_mutex_unlock(&cache->lock);
+
+    return loaded;
+}
+
+bool imageCache_isWanted(ImageCache *cache, int index)
+{
+    pthread_mutex_lock(&cache->lock);
+    bool wanted = !cache->quit && __imageCache_inWindow(cache, index) && index != cache->held;
+    pthread_mutex_unlock(&cache->lock);
+    return wanted;
+}
+
+void imageCache_invalidate(ImageCache *cache, int index)
+{
+    pthread_mutex_lock(&cache->lock);
+
+    cache->held = index;
+    while (cache->loading == index)
+        pthread_cond_wait(&cache->loaded, &cache->lock);
+
+    ImageCacheSlot *slot = &cache->slots[index % cache->capacity];
+    if (slot->index == index) {
+        if (slot->surface != NULL)
+            SDL_FreeSurface(slot->surface);
+        slot->surface = NULL;
+        slot->state = IMAGECACHE_EMPTY;
+        slot->index = -1;
     }
-}
\ No newline at end of file
+
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -1,12 +1,129 @@
 #ifndef UTILS_IMAGE_CACHE_H__
 #define UTILS_IMAGE_CACHE_H__
 
-typedef struct SDL_Surface SDL_Surface;
+#include <SDL/SDL.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
-void imageCache_load(int *offset, SDL_Surface *(*_load_image)(int), int total);
-void imageCache_removeItem(int image_index);
-SDL_Surface *imageCache_getItem(int *index);
-bool imageCache_isActive(void);
-void imageCache_freeAll(void);
+/**
+ * Image prefetch engine: keeps a window of decoded images around the one
+ * being shown (the focus), loaded in the background by one persistent
+ * worker thread.
+ *
+ * Slots form a ring (image `index` lives in slot `index % capacity`) guarded
+ * by the cache's mutex. Surfaces are refcounted through SDL's own
+ * `refcount`: imageCache_acquire adds a reference and imageCache_release
+ * drops it, so an image evicted while it's being drawn is only freed once
+ * released.
+ *
+ * The window leans towards the direction the focus moves in, further the
+ * faster it moves (keeping one image behind). Images are loaded nearest first, two ahead for one
+ * behind. When the focus jumps, queued loads outside the new window are
+ * never started and the one in flight is discarded when it completes
+ * (loaders can also give up early, see imageCache_isWanted).
+ */
+
+#define IMAGECACHE_LOOKAHEAD_MS 500 // prefetch what the focus reaches in that time
+#define IMAGECACHE_IDLE_MS 1000     // no move for that long: not scrolling anymore
+
+typedef SDL_Surface *(*ImageCacheLoader)(int index, void *userdata);
+
+typedef enum {
+    IMAGECACHE_EMPTY,
+    IMAGECACHE_LOADING,
+    IMAGECACHE_READY,
+    IMAGECACHE_FAILED
+} ImageCacheState;
+
+typedef struct {
+    int index;
+    ImageCacheState state;
+    SDL_Surface *surface; // the cache's reference
+} ImageCacheSlot;
+
+typedef struct ImageCache {
+    int capacity;
+    int total;
+    ImageCacheLoader load;
+    void *userdata;
+    ImageCacheSlot *slots;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;   // the window changed, or quit
+    pthread_cond_t loaded; // a load completed
+    bool quit;
+
+    int focus;
+    int direction;   // 1 or -1
+    double velocity; // indexes per second
+    uint32_t focus_ticks;
+    int window_start, window_end; // inclusive
+    int loading;                  // index being loaded, -1: none
+    int held;                     // index not to reload before the next focus, -1: none
+
+    uint32_t loads;     // completed loads
+    uint32_t discarded; // loads that left the window while in flight
+} ImageCache;
+
+/**
+ * @brief Creates a cache for `total` images and starts its worker. Nothing
+ * is loaded before the first imageCache_focus.
+ *
+ * @param capacity images kept decoded
+ * @param load called on the worker thread, returns a new surface (or NULL)
+ * @return ImageCache* NULL if the worker couldn't be started
+ */
+ImageCache *imageCache_create(int capacity, int total, ImageCacheLoader load, void *userdata);
+
+/**
+ * @brief Stops the worker (after its current load) and drops the cache's
+ * references: surfaces still acquired stay valid until released.
+ */
+void imageCache_free(ImageCache *cache);
+
+/**
+ * @brief Sets the image being shown: the window moves around it and the
+ * worker starts on what's missing.
+ */
+void imageCache_focus(ImageCache *cache, int index);
+
+/**
+ * @brief Gets a reference to a loaded image.
+ *
+ * @return SDL_Surface* NULL if it isn't loaded (yet), otherwise give it back
+ * with imageCache_release
+ */
+SDL_Surface *imageCache_acquire(ImageCache *cache, int index);
+
+/**
+ * @brief Like imageCache_acquire, but waits for the image if it's in the
+ * window and not loaded yet.
+ */
+SDL_Surface *imageCache_acquireWait(ImageCache *cache, int index);
+
+/**
+ * @brief Gives back a reference from imageCache_acquire(Wait).
+ */
+void imageCache_release(ImageCache *cache, SDL_Surface *surface);
+
+/**
+ * @brief Whether an image has been loaded (or failed to).
+ */
+bool imageCache_isLoaded(ImageCache *cache, int index);
+
+/**
+ * @brief For loaders: whether the image being loaded is still in the
+ * window, a loader may give up (return NULL) when it isn't.
+ */
+bool imageCache_isWanted(ImageCache *cache, int index);
+
+/**
+ * @brief Drops an image whose source changed. Waits for a load of it in
+ * flight, and doesn't load it again before the next imageCache_focus, so
+ * the source can be changed safely in between.
+ */
+void imageCache_invalidate(ImageCache *cache, int index);
 
 #endif // UTILS_IMAGE_CACHE_H__
@@ -0,0 +1,233 @@
+#ifndef UTILS_IMAGE_WRITER_H__
+#define UTILS_IMAGE_WRITER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "png/png.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "utils/file.h"
+#include "utils/log.h"
+#include "utils/rawImage.h"
+#include "utils/str.h"
+
+/**
+ * Image writer: saves 32bpp ARGB pixels (SDL surfaces, framebuffer grabs) as
+ * RGBA or RGB PNG with a chosen zlib level and filters, or as a raw image
+ * cache (see rawImage.h), uncompressed or LZ4. PNGs are written under a
+ * temporary name and renamed once complete.
+ */
+
+typedef enum {
+    IMAGE_PNG_RGBA, // keeps alpha
+    IMAGE_PNG_RGB,  // drops alpha (framebuffer grabs have none)
+    IMAGE_RAW,      // raw cache of `path`, stored as is
+    IMAGE_RAW_LZ4   // raw cache of `path`, LZ4 compressed
+} ImageFormat;
+
+typedef struct {
+    ImageFormat format;
+    int png_level;          // zlib level 0-9, -1: libpng's default
+    int png_filters;        // PNG_FILTER_* flags, 0: libpng's default
+    bool rotate180;         // the source is upside down
+    bool clear_transparent; // RGBA: write fully transparent pixels as 0
+} ImageWriterOptions;
+
+/**
+ * @brief Converts a row of ARGB pixels (B,G,R,A in memory) to RGBA bytes.
+ *
+ * @param reverse read `src` from the last pixel to the first
+ * @param clear_transparent zero the pixels with alpha 0
+ */
+void image_swizzleRGBA(uint8_t *dst, const uint32_t *src, int count, bool reverse, bool clear_transparent)
+{
+    int i = 0;
+#ifdef __ARM_NEON
+    uint8x8_t zero = vdup_n_u8(0);
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t in = vld4_u8((const uint8_t *)(reverse ? src + count - 8 - i : src + i));
+        uint8x8x4_t out = {{in.val[2], in.val[1], in.val[0], in.val[3]}};
+        if (reverse) {
+            for (int c = 0; c < 4; c++)
+                out.val[c] = vrev64_u8(out.val[c]);
+        }
+        if (clear_transparent) {
+            uint8x8_t transparent = vceq_u8(out.val[3], zero);
+            for (int c = 0; c < 3; c++)
+                out.val[c] = vbic_u8(out.val[c], transparent);
+        }
+        vst4_u8(dst + i * 4, out);
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t pix = reverse ? src[count - 1 - i] : src[i];
+        uint8_t *out = dst + i * 4;
+        if (clear_transparent && !(pix & 0xFF000000))
+            pix = 0;
+        out[0] = pix >> 16;
+        out[1] = pix >> 8;
+        out[2] = pix;
+        out[3] = pix >> 24;
+    }
+}
+
+/**
+ * @brief Converts a row of ARGB pixels to RGB bytes (alpha dropped).
+ */
+void image_swizzleRGB(uint8_t *dst, const uint32_t *src, int count, bool reverse)
+{
+    int i = 0;
+#ifdef __ARM_NEON
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t in = vld4_u8((const uint8_t *)(reverse ? src + count - 8 - i : src + i));
+        uint8x8x3_t out = {{in.val[2], in.val[1], in.val[0]}};
+        if (reverse) {
+            for (int c = 0; c < 3; c++)
+                out.val[c] = vrev64_u8(out.val[c]);
+        }
+        vst3_u8(dst + i * 3, out);
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t pix = reverse ? src[count - 1 - i] : src[i];
+        uint8_t *out = dst + i * 3;
+        out[0] = pix >> 16;
+        out[1] = pix >> 8;
+        out[2] = pix;
+    }
+}
+
+static const uint32_t *__image_writer_row(const uint32_t *pixels, int height, int pitch, int y, bool rotate180)
+{
+    return (const uint32_t *)((const uint8_t *)pixels + (rotate180 ? height - 1 - y : y) * pitch);
+}
+
+static bool __image_writer_png(const char *path, const uint32_t *pixels, int width, int height, int pitch, const ImageWriterOptions *options)
+{
+    bool rgb = options->format == IMAGE_PNG_RGB;
+    char tmp_path[STR_MAX * 2 + 8];
+    png_structp png_ptr;
+    png_infop info_ptr;
+    uint8_t *line_buffer;
+    FILE *fp;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    if ((line_buffer = (uint8_t *)malloc(width * 4)) == NULL)
+        return false;
+
+    if (!(fp = file_open_ensure_path(tmp_path, "wb"))) {
+        free(line_buffer);
+        return false;
+    }
+
+    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+    info_ptr = png_create_info_struct(png_ptr);
+
+    png_init_io(png_ptr, fp);
+    if (options->png_level >= 0)
+        png_set_compression_level(png_ptr, options->png_level);
+    if (options->png_filters != 0)
+        png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, options->png_filters);
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8,
+                 rgb ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGBA,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+
+    for (int y = 0; y < height; y++) {
+        const uint32_t *src = __image_writer_row(pixels, height, pitch, y, options->rotate180);
+        if (rgb)
+            image_swizzleRGB(line_buffer, src, width, options->rotate180);
+        else
+            image_swizzleRGBA(line_buffer, src, width, options->rotate180, options->clear_transparent);
+        png_write_row(png_ptr, (png_bytep)line_buffer);
+    }
+
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    free(line_buffer);
+
+    fflush(fp);
+    fsync(fileno(fp));
+    fclose(fp);
+
+    if (rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+static bool __image_writer_raw(const char *path, const uint32_t *pixels, int width, int height, int pitch, const ImageWriterOptions *options)
+{
+    uint32_t *buffer = NULL;
+    const uint32_t *data = pixels;
+
+    // Screen format: opaque ARGB, rows in display order
+    if (options->rotate180) {
+        if ((buffer = (uint32_t *)malloc(width * height * sizeof(uint32_t))) == NULL)
+            return false;
+        for (int y = 0; y < height; y++) {
+            const uint32_t *src = __image_writer_row(pixels, height, pitch, y, true) + width;
+            uint32_t *dst = buffer + y * width;
+            for (int x = 0; x < width; x++)
+                dst[x] = 0xFF000000 | *--src;
+        }
+        data = buffer;
+        pitch = width * sizeof(uint32_t);
+    }
+
+    RawImageHeader header = {
+        .bpp = 32,
+        .width = (uint32_t)width,
+        .height = (uint32_t)height,
+        .pitch = (uint32_t)pitch,
+        .rmask = 0x00FF0000,
+        .gmask = 0x0000FF00,
+        .bmask = 0x000000FF,
+        .amask = 0,
+        .compression = options->format == IMAGE_RAW_LZ4 ? RAW_IMAGE_LZ4 : RAW_IMAGE_UNCOMPRESSED};
+    bool retval = raw_image_write(path, header, data);
+
+    free(buffer);
+    return retval;
+}
+
+/**
+ * @brief Saves 32bpp ARGB pixels.
+ *
+ * @param path PNG path, or for the raw formats the image the cache is for
+ * (the cache is written next to it)
+ * @param pitch bytes per row of `pixels`
+ * @return true The image was written
+ */
+bool image_write(const char *path, const uint32_t *pixels, int width, int height, int pitch, const ImageWriterOptions *options)
+{
+    if (pixels == NULL || width <= 0 || height <= 0)
+        return false;
+
+    switch (options->format) {
+    case IMAGE_PNG_RGBA:
+    case IMAGE_PNG_RGB:
+        return __image_writer_png(path, pixels, width, height, pitch, options);
+    case IMAGE_RAW:
+    case IMAGE_RAW_LZ4:
+        return __image_writer_raw(path, pixels, width, height, pitch, options);
+    default:
+        break;
+    }
+
+    print_debug("image_write: unknown format");
+    return false;
+}
+
+#endif // UTILS_IMAGE_WRITER_H__
@@ -1,41 +1,306 @@
 #include "log.h"
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "./file.h"
 #include "./str.h"
 
+// Messages are queued in a lock-free ring buffer (bounded MPMC queue with
+// per-slot sequence numbers) and written to the log file in batches by a
+// single background thread. When the ring is full, the producer drains it
+// itself; messages are only dropped (and counted) if that keeps failing.
+
+#define LOG_RING_SIZE 128 // power of two
+#define LOG_SLOT_SIZE 1024
+#define LOG_BATCH_SIZE (16 * 1024)
+#define LOG_FLUSH_INTERVAL_MS 100
+#define LOG_FSYNC_INTERVAL_MS 2000
+#define LOG_MAX_FILE_SIZE (512 * 1024)
+
+typedef struct {
+    atomic_size_t seq;
+    LogLevel level;
+    uint32_t len;
+    char text[LOG_SLOT_SIZE];
+} LogSlot;
+
 static char _log_path[64] = "";
 
+static LogSlot _log_ring[LOG_RING_SIZE];
+static atomic_size_t _log_enqueue_pos;
+static atomic_uint _log_dropped;
+static atomic_bool _log_ready;
+static pthread_once_t _log_once = PTHREAD_ONCE_INIT;
+static sem_t _log_wakeup;
+
+// Consumer side (writer thread or log_flush), guarded by _log_consumer_lock
+static pthread_mutex_t _log_consumer_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t _log_dequeue_pos = 0;
+static int _log_fd = -1;
+static off_t _log_size = 0;
+static bool _log_unsynced = false;
+static uint64_t _log_last_sync = 0;
+
+static uint64_t _log_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void _log_sync(void)
+{
+    if (_log_fd != -1 && _log_unsynced)
+        fsync(_log_fd);
+    _log_unsynced = false;
+    _log_last_sync = _log_now_ms();
+}
+
+static void _log_write(const char *data, size_t len)
+{
+    if (len == 0)
+        return;
+
+    if (_log_fd == -1) {
+        struct stat st;
+        _log_fd = open(_log_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (_log_fd == -1)
+            return;
+        _log_size = fstat(_log_fd, &st) == 0 ? st.st_size : 0;
+    }
+
+    ssize_t written = write(_log_fd, data, len);
+    if (written > 0) {
+        _log_size += written;
+        _log_unsynced = true;
+    }
+
+    // Rotate: keep the current file as <name>.log.1
+    if (_log_size >= LOG_MAX_FILE_SIZE) {
+        char rotated_path[sizeof(_log_path) + 2];
+        snprintf(rotated_path, sizeof(rotated_path), "%s.1", _log_path);
+        _log_sync();
+        close(_log_fd);
+        _log_fd = -1;
+        rename(_log_path, rotated_path);
+    }
+}
+
+/**
+ * @brief Writes all queued messages to the log file. The file is fsynced when
+ * an error was logged, when `force_sync` is set, or on the fsync interval.
+ */
+static void _log_drain(bool force_sync)
+{
+    char batch[LOG_BATCH_SIZE];
+    size_t batch_len = 0;
+    bool urgent = force_sync;
+
+    while (true) {
+        LogSlot *slot = &_log_ring[_log_dequeue_pos & (LOG_RING_SIZE - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != _log_dequeue_pos + 1)
+            break; // empty, or the producer isn't done yet
+
+        if (batch_len + slot->len > sizeof(batch)) {
+            _log_write(batch, batch_len);
+            batch_len = 0;
+        }
+        memcpy(batch + batch_len, slot->text, slot->len);
+        batch_len += slot->len;
+        if (slot->level >= LOG_LEVEL_ERROR)
+            urgent = true;
+
+        atomic_store_explicit(&slot->seq, _log_dequeue_pos + LOG_RING_SIZE, memory_order_release);
+        _log_dequeue_pos++;
+    }
+
+    unsigned int dropped = atomic_exchange(&_log_dropped, 0);
+    if (dropped > 0 && batch_len + 64 <= sizeof(batch))
+        batch_len += sprintf(batch + batch_len, "[log] %u messages dropped\n", dropped);
+
+    _log_write(batch, batch_len);
+
+    if (_log_unsynced && (urgent || _log_now_ms() - _log_last_sync >= LOG_FSYNC_INTERVAL_MS))
+        _log_sync();
+}
+
+static void *_log_writer_thread(void *arg)
+{
+    while (true) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        sem_timedwait(&_log_wakeup, &ts);
+
+        pthread_mutex_lock(&_log_consumer_lock);
+        _log_drain(false);
+        pthread_mutex_unlock(&_log_consumer_lock);
+    }
+    return NULL;
+}
+
+static void _log_crash_handler(int sig)
+{
+    // Don't deadlock if the crash happened while draining
+    if (pthread_mutex_trylock(&_log_consumer_lock) == 0) {
+        _log_drain(true);
+        pthread_mutex_unlock(&_log_consumer_lock);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static void _log_init(void)
+{
+    for (size_t i = 0; i < LOG_RING_SIZE; i++)
+        atomic_init(&_log_ring[i].seq, i);
+    sem_init(&_log_wakeup, 0, 0);
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    if (pthread_create(&thread, &attr, _log_writer_thread, NULL) != 0) {
+        pthread_attr_destroy(&attr);
+        return;
+    }
+    pthread_attr_destroy(&attr);
+
+    // Crash-flush hook, unless the program handles these signals itself
+    int crash_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    for (int i = 0; i < sizeof(crash_signals) / sizeof(int); i++) {
+        struct sigaction current;
+        if (sigaction(crash_signals[i], NULL, &current) == 0 && current.sa_handler == SIG_DFL)
+            signal(crash_signals[i], _log_crash_handler);
+    }
+    atexit(log_flush);
+
+    atomic_store(&_log_ready, true);
+}
+
 void log_setName(const char *log_name)
 {
+    pthread_mutex_lock(&_log_consumer_lock);
     snprintf(_log_path, 63, "/mnt/SDCARD/.tmp_update/logs/%s.log", log_name);
+    if (_log_fd != -1) {
+        close(_log_fd);
+        _log_fd = -1;
+    }
+    pthread_mutex_unlock(&_log_consumer_lock);
+
     mkdirs("/mnt/SDCARD/.tmp_update/logs");
 }
 
-void log_debug(const char *file_path, int line, const char *format_str, ...)
+/**
+ * @brief Writes pending messages to disk now (and fsyncs).
+ */
+void log_flush(void)
 {
-    char log_message[1024], cmd[1024];
+    if (!atomic_load(&_log_ready))
+        return;
+    pthread_mutex_lock(&_log_consumer_lock);
+    _log_drain(true);
+    pthread_mutex_unlock(&_log_consumer_lock);
+}
 
-    va_list valist;
-    va_start(valist, format_str);
-    sprintf(log_message, "%s:%d>\t", file_path, line);
-    vsprintf(log_message + strlen(log_message), format_str, valist);
-    va_end(valist);
+static void _log_enqueue(LogLevel level, const char *message, size_t len)
+{
+    size_t pos = atomic_load_explicit(&_log_enqueue_pos, memory_order_relaxed);
+    int attempts = 0;
+    LogSlot *slot;
 
-    snprintf(cmd, 1023, "echo -n \"%s\" >/dev/stderr",
-             str_replace(log_message, "\"", "\\\""));
-    system(cmd);
+    while (true) {
+        slot = &_log_ring[pos & (LOG_RING_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&_log_enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0) {
+            // Full: the writer is behind, drain the ring from this thread
+            if (pthread_mutex_trylock(&_log_consumer_lock) != 0) {
+                if (++attempts > 1000) {
+                    atomic_fetch_add(&_log_dropped, 1);
+                    return;
+                }
+                sched_yield();
+            }
+            else {
+                _log_drain(false);
+                pthread_mutex_unlock(&_log_consumer_lock);
+            }
+            pos = atomic_load_explicit(&_log_enqueue_pos, memory_order_relaxed);
+        }
+        else {
+            pos = atomic_load_explicit(&_log_enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    memcpy(slot->text, message, len);
+    slot->len = len;
+    slot->level = level;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    // Wake the writer early for errors, or when the ring fills up
+    if (level >= LOG_LEVEL_ERROR || (pos & (LOG_RING_SIZE / 2 - 1)) == 0)
+        sem_post(&_log_wakeup);
+}
+
+void log_message(LogLevel level, const char *file_path, int line, const char *format_str, va_list valist)
+{
+    char message[LOG_SLOT_SIZE];
+
+    int len = snprintf(message, sizeof(message), "%s:%d>\t", file_path, line);
+    if (len < sizeof(message))
+        len += vsnprintf(message + len, sizeof(message) - len, format_str, valist);
+    if (len >= sizeof(message))
+        len = sizeof(message) - 1;
+
+    write(STDERR_FILENO, message, len);
 
     if (strlen(_log_path) == 0)
         return;
 
-    FILE *fp;
-    if ((fp = fopen(_log_path, "a+")) != NULL) {
-        fwrite(log_message, sizeof(char), strlen(log_message), fp);
-        fflush(fp);
-        fsync(fileno(fp));
-        fclose(fp);
-    }
+    // The writer thread and its hooks are only started by the first message,
+    // daemons that never log (debug logging off) don't pay for them
+    pthread_once(&_log_once, _log_init);
+    if (!atomic_load(&_log_ready))
+        return;
+
+    _log_enqueue(level, message, len);
+}
+
+void log_debug(const char *file_path, int line, const char *format_str, ...)
+{
+    va_list valist;
+    va_start(valist, format_str);
+    log_message(LOG_LEVEL_DEBUG, file_path, line, format_str, valist);
+    va_end(valist);
+}
+
+void log_error(const char *file_path, int line, const char *format_str, ...)
+{
+    va_list valist;
+    va_start(valist, format_str);
+    log_message(LOG_LEVEL_ERROR, file_path, line, format_str, valist);
+    va_end(valist);
 }
@@ -1,6 +1,8 @@
 #ifndef LOG_H__
 #define LOG_H__
 
+#include <stdarg.h>
+
 #define LOG_INIT "Initialized %s\n"
 #define LOG_SUCCESS "Successfully %s\n"
 #define LOG_MESSAGE "%s\n"
@@ -10,12 +12,25 @@
 #define print_debug(message) log_debug(__FILE__, __LINE__, LOG_MESSAGE, message)
 #define printf_debug(format_str, ...) \
     log_debug(__FILE__, __LINE__, format_str, __VA_ARGS__)
+#define print_error(message) log_error(__FILE__, __LINE__, LOG_MESSAGE, message)
+#define printf_error(format_str, ...) \
+    log_error(__FILE__, __LINE__, format_str, __VA_ARGS__)
 #else
 #define print_debug(message)
 #define printf_debug(format_str, ...)
+#define print_error(message)
+#define printf_error(format_str, ...)
 #endif
 
+typedef enum log_level_e {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_ERROR // written to disk (and fsynced) right away
+} LogLevel;
+
 void log_setName(const char *log_name);
+void log_message(LogLevel level, const char *filename, int line, const char *format_str, va_list valist);
 void log_debug(const char *filename, int line, const char *format_str, ...);
+void log_error(const char *filename, int line, const char *format_str, ...);
+void log_flush(void);
 
 #endif // LOG_H__
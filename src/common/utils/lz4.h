@@ -0,0 +1,188 @@
+#ifndef UTILS_LZ4_H__
+#define UTILS_LZ4_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * LZ4 block format (compatible with LZ4_compress_default and
+ * LZ4_decompress_safe, no frame header), with a small greedy compressor.
+ * Used for the raw image caches, where decoding speed is what matters.
+ */
+
+#define LZ4_HASH_BITS 12
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5 // the block always ends with literals
+#define LZ4_MFLIMIT 12      // no match may start later than this from the end
+#define LZ4_MAX_OFFSET 65535
+
+/**
+ * @brief Worst case compressed size (incompressible input).
+ */
+size_t lz4_compressBound(size_t src_size)
+{
+    return src_size + src_size / 255 + 16;
+}
+
+static uint32_t __lz4_read32(const uint8_t *ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static uint32_t __lz4_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static uint8_t *__lz4_writeLength(uint8_t *op, size_t length)
+{
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+static uint8_t *__lz4_writeLiterals(uint8_t *op, uint8_t *token, const uint8_t *literals, size_t count)
+{
+    *token = (count >= 15 ? 15 : count) << 4;
+    if (count >= 15)
+        op = __lz4_writeLength(op, count - 15);
+    memcpy(op, literals, count);
+    return op + count;
+}
+
+/**
+ * @brief Compresses `src` into `dst`.
+ *
+ * @param dst_capacity must be at least lz4_compressBound(src_size)
+ * @return size_t Compressed size, 0 if `dst` is too small
+ */
+size_t lz4_compress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity)
+{
+    uint32_t table[1 << LZ4_HASH_BITS];
+    const uint8_t *ip = src, *anchor = src, *end = src + src_size;
+    const uint8_t *match_limit = src_size > LZ4_MFLIMIT ? end - LZ4_MFLIMIT : src;
+    const uint8_t *extend_limit = src_size > LZ4_LAST_LITERALS ? end - LZ4_LAST_LITERALS : src;
+    uint8_t *op = dst, *token;
+
+    if (dst_capacity < lz4_compressBound(src_size))
+        return 0;
+
+    memset(table, 0, sizeof(table));
+
+    while (ip < match_limit) {
+        uint32_t sequence = __lz4_read32(ip);
+        uint32_t hash = __lz4_hash(sequence);
+        const uint8_t *ref = src + table[hash];
+        table[hash] = (uint32_t)(ip - src);
+
+        if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || __lz4_read32(ref) != sequence) {
+            ip++;
+            continue;
+        }
+
+        size_t length = LZ4_MIN_MATCH;
+        while (ip + length < extend_limit && ip[length] == ref[length])
+            length++;
+        while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+            ip--;
+            ref--;
+            length++;
+        }
+
+        token = op++;
+        op = __lz4_writeLiterals(op, token, anchor, ip - anchor);
+
+        uint16_t offset = (uint16_t)(ip - ref);
+        *op++ = offset & 0xFF;
+        *op++ = offset >> 8;
+
+        size_t match_length = length - LZ4_MIN_MATCH;
+        *token |= match_length >= 15 ? 15 : match_length;
+        if (match_length >= 15)
+            op = __lz4_writeLength(op, match_length - 15);
+
+        ip += length;
+        anchor = ip;
+    }
+
+    token = op++;
+    op = __lz4_writeLiterals(op, token, anchor, end - anchor);
+
+    return op - dst;
+}
+
+static bool __lz4_readLength(const uint8_t **ip, const uint8_t *end, size_t *length)
+{
+    uint8_t byte;
+    do {
+        if (*ip >= end)
+            return false;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/**
+ * @brief Decompresses a block, checking every read and write.
+ *
+ * @param dst_size exact decompressed size
+ * @return true The block was valid and filled `dst`
+ */
+bool lz4_decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *ip = src, *end = src + src_size;
+    uint8_t *op = dst, *dst_end = dst + dst_size;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+
+        if (literals == 15 && !__lz4_readLength(&ip, end, &literals))
+            return false;
+        if (literals > (size_t)(end - ip) || literals > (size_t)(dst_end - op))
+            return false;
+
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+
+        if (ip == end)
+            break; // the last sequence has no match
+
+        if (end - ip < 2)
+            return false;
+        size_t offset = ip[0] | ip[1] << 8;
+        ip += 2;
+
+        size_t length = token & 15;
+        if (length == 15 && !__lz4_readLength(&ip, end, &length))
+            return false;
+        length += LZ4_MIN_MATCH;
+
+        if (offset == 0 || offset > (size_t)(op - dst) || length > (size_t)(dst_end - op))
+            return false;
+
+        const uint8_t *match = op - offset;
+        if (offset >= length) {
+            memcpy(op, match, length);
+            op += length;
+        }
+        else {
+            // Overlapping: repeats the last `offset` bytes
+            while (length--)
+                *op++ = *match++;
+        }
+    }
+
+    return op == dst_end;
+}
+
+#endif // UTILS_LZ4_H__
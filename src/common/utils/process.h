@@ -2,50 +2,282 @@
 #define PROCESS_H__
 
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "utils/str.h"
 
 #ifndef DT_DIR
 #define DT_DIR 4
 #endif
 
-//
-//    Search pid of running executable (forward match)
-//
-pid_t process_searchpid(const char *commname)
+// proc_event's enum is nested in the struct when compiled as C++
+#ifdef __cplusplus
+#define PROC_EVENT(what) proc_event::what
+#else
+#define PROC_EVENT(what) what
+#endif
+
+#define PROCESS_SNAPSHOT_MAX 512
+// How long a snapshot is reused when process events are not available
+#define PROCESS_SNAPSHOT_TTL_MS 250
+// Safety net when process events are available (in case one was missed)
+#define PROCESS_SNAPSHOT_MAX_AGE_MS 5000
+
+typedef struct {
+    pid_t pid;
+    char comm[16];
+} ProcessEntry;
+
+/**
+ * @brief Process table snapshot: one /proc scan, in /proc order.
+ */
+typedef struct {
+    ProcessEntry entries[PROCESS_SNAPSHOT_MAX];
+    int count;
+    uint64_t taken_at;
+    bool valid;
+} ProcessSnapshot;
+
+static ProcessSnapshot __process_snapshot;
+static char process_proc_root[STR_MAX] = "/proc";
+
+// Netlink proc connector socket (-1 = not listening)
+static int __process_events_fd = -1;
+// Whether the kernel acknowledged the subscription (i.e. events will arrive)
+static bool __process_events_active = false;
+
+static uint64_t __process_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Scans /proc once and rebuilds the snapshot.
+ *
+ * @return true The process table could be read
+ */
+bool process_snapshot_refresh(void)
 {
+    ProcessSnapshot *snap = &__process_snapshot;
     DIR *procdp;
     struct dirent *dir;
-    char fname[24];
-    char comm[128];
-    pid_t pid;
-    pid_t ret = 0;
-    size_t commlen = strlen(commname);
+    char fname[STR_MAX + 32];
+
+    snap->count = 0;
+    snap->valid = false;
+
+    if ((procdp = opendir(process_proc_root)) == NULL)
+        return false;
 
-    procdp = opendir("/proc");
-    while ((dir = readdir(procdp))) {
-        if (dir->d_type == DT_DIR) {
-            pid = atoi(dir->d_name);
-            if (pid > 2) {
-                sprintf(fname, "/proc/%d/comm", pid);
-                FILE *fp = fopen(fname, "r");
-                if (fp) {
-                    fscanf(fp, "%127s", comm);
-                    fclose(fp);
-                    if (!strncmp(comm, commname, commlen)) {
-                        ret = pid;
-                        break;
-                    }
-                }
+    while ((dir = readdir(procdp)) && snap->count < PROCESS_SNAPSHOT_MAX) {
+        if (dir->d_type != DT_DIR)
+            continue;
+
+        pid_t pid = atoi(dir->d_name);
+        if (pid <= 2)
+            continue;
+
+        snprintf(fname, sizeof(fname), "%s/%d/comm", process_proc_root, pid);
+        int fd = open(fname, O_RDONLY);
+        if (fd < 0)
+            continue;
+
+        ProcessEntry *entry = &snap->entries[snap->count];
+        ssize_t len = read(fd, entry->comm, sizeof(entry->comm) - 1);
+        close(fd);
+
+        if (len <= 0)
+            continue;
+
+        entry->comm[len] = '\0';
+
+        // Only the first word is compared, as fscanf("%s") used to read it
+        char *word = entry->comm;
+        while (*word == ' ' || *word == '\t' || *word == '\n')
+            word++;
+        size_t word_len = strcspn(word, " \t\n");
+        memmove(entry->comm, word, word_len);
+        entry->comm[word_len] = '\0';
+
+        entry->pid = pid;
+        snap->count++;
+    }
+
+    closedir(procdp);
+
+    snap->taken_at = __process_now_ms();
+    snap->valid = true;
+    return true;
+}
+
+void process_snapshot_invalidate(void) { __process_snapshot.valid = false; }
+
+/**
+ * @brief Drains pending proc connector events.
+ *
+ * @return true If the process table changed (or events were lost)
+ */
+static bool __process_events_drain(void)
+{
+    char buf[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+    bool changed = false;
+    ssize_t len;
+
+    while ((len = recv(__process_events_fd, buf, sizeof(buf), 0)) > 0) {
+        for (struct nlmsghdr *nl = (struct nlmsghdr *)buf; NLMSG_OK(nl, len); nl = NLMSG_NEXT(nl, len)) {
+            struct cn_msg *cn = (struct cn_msg *)NLMSG_DATA(nl);
+            struct proc_event *ev = (struct proc_event *)cn->data;
+
+            switch (ev->what) {
+            case PROC_EVENT(PROC_EVENT_NONE):
+                // Subscription acknowledged
+                if (ev->event_data.ack.err == 0)
+                    __process_events_active = true;
+                break;
+            case PROC_EVENT(PROC_EVENT_FORK):
+                // Ignore new threads, /proc only lists processes
+                if (ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid)
+                    changed = true;
+                break;
+            case PROC_EVENT(PROC_EVENT_EXIT):
+                if (ev->event_data.exit.process_pid == ev->event_data.exit.process_tgid)
+                    changed = true;
+                break;
+            case PROC_EVENT(PROC_EVENT_EXEC):
+            case PROC_EVENT(PROC_EVENT_COMM):
+                changed = true;
+                break;
+            default:
+                break;
             }
         }
     }
-    closedir(procdp);
-    return ret;
+
+    if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        // ENOBUFS: the socket overflowed, events were lost
+        if (errno != ENOBUFS) {
+            close(__process_events_fd);
+            __process_events_fd = -1;
+            __process_events_active = false;
+        }
+        changed = true;
+    }
+
+    return changed;
+}
+
+/**
+ * @brief Listens to the netlink proc connector, so the snapshot is refreshed
+ * when processes start or exit instead of after a fixed TTL. Needs root and a
+ * kernel with CONFIG_PROC_EVENTS; the TTL is used until the kernel confirms.
+ *
+ * @return true Subscription was sent
+ */
+bool process_events_start(void)
+{
+    if (__process_events_fd != -1)
+        return true;
+
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd < 0)
+        return false;
+
+    struct sockaddr_nl addr = {0};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+
+    char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] __attribute__((aligned(NLMSG_ALIGNTO)));
+    memset(buf, 0, sizeof(buf));
+
+    struct nlmsghdr *nl = (struct nlmsghdr *)buf;
+    nl->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+    nl->nlmsg_type = NLMSG_DONE;
+    nl->nlmsg_pid = getpid();
+
+    struct cn_msg *cn = (struct cn_msg *)NLMSG_DATA(nl);
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len = sizeof(enum proc_cn_mcast_op);
+    *(enum proc_cn_mcast_op *)cn->data = PROC_CN_MCAST_LISTEN;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        send(fd, buf, nl->nlmsg_len, 0) < 0) {
+        print_debug("Process events not available");
+        close(fd);
+        return false;
+    }
+
+    __process_events_fd = fd;
+    return true;
+}
+
+void process_events_stop(void)
+{
+    if (__process_events_fd == -1)
+        return;
+    close(__process_events_fd);
+    __process_events_fd = -1;
+    __process_events_active = false;
+}
+
+/**
+ * @brief Returns the current snapshot, rescanning /proc only when processes
+ * changed (proc connector) or the TTL expired.
+ */
+ProcessSnapshot *process_snapshot(void)
+{
+    ProcessSnapshot *snap = &__process_snapshot;
+    uint64_t age = __process_now_ms() - snap->taken_at;
+    bool changed = __process_events_fd != -1 && __process_events_drain();
+
+    if (!snap->valid || changed ||
+        age >= (__process_events_active ? PROCESS_SNAPSHOT_MAX_AGE_MS : PROCESS_SNAPSHOT_TTL_MS))
+        process_snapshot_refresh();
+
+    return snap;
+}
+
+/**
+ * @brief Looks up a process by name in a snapshot (forward match, like
+ * process_searchpid): the first process in /proc order whose name starts
+ * with `commname`.
+ *
+ * @return pid_t The pid, or 0 if no process matches
+ */
+pid_t process_snapshot_find(const ProcessSnapshot *snap, const char *commname)
+{
+    size_t commlen = strlen(commname);
+
+    for (int i = 0; i < snap->count; i++) {
+        if (strncmp(snap->entries[i].comm, commname, commlen) == 0)
+            return snap->entries[i].pid;
+    }
+
+    return 0;
+}
+
+//
+//    Search pid of running executable (forward match)
+//
+pid_t process_searchpid(const char *commname)
+{
+    return process_snapshot_find(process_snapshot(), commname);
 }
 
 bool process_isRunning(const char *commname)
@@ -56,16 +288,21 @@ bool process_isRunning(const char *commname)
 void process_kill(const char *commname)
 {
     pid_t pid;
-    if ((pid = process_searchpid(commname)))
+    if ((pid = process_searchpid(commname))) {
         kill(pid, SIGKILL);
+        process_snapshot_invalidate();
+    }
 }
 
 void process_killall(const char *commname)
 {
     pid_t pid;
     int max = 999;
-    while ((pid = process_searchpid(commname)) && max-- > 0)
+    while ((pid = process_snapshot_find(process_snapshot(), commname)) && max-- > 0) {
         kill(pid, SIGKILL);
+        // Rescan, the killed process may still be listed (or have respawned)
+        process_snapshot_refresh();
+    }
 }
 
 bool process_start(const char *pname, const char *args, const char *home,
@@ -88,6 +325,7 @@ bool process_start(const char *pname, const char *args, const char *home,
     sprintf(cmd, "cd \"%s\"; %s %s %s", home != NULL ? home : ".", filename,
             args != NULL ? args : "", await ? "" : "&");
     system(cmd);
+    process_snapshot_invalidate();
 
     return true;
 }
@@ -0,0 +1,216 @@
+#ifndef UTILS_RAW_IMAGE_H__
+#define UTILS_RAW_IMAGE_H__
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "utils/lz4.h"
+#include "utils/str.h"
+
+/**
+ * Raw image cache: pre-decoded pixels in display format with a small header,
+ * meant to be mmapped and blitted directly instead of decoding a PNG.
+ *
+ * The cache file sits next to its source image (`<name>.raw`) and is only
+ * valid while the source's mtime and size match the ones stored in it.
+ * Pixels are stored as is (mapped directly) or LZ4 compressed (decompressed
+ * into memory when mapped).
+ */
+
+#define RAW_IMAGE_MAGIC 0x5752414F // "OARW"
+#define RAW_IMAGE_VERSION 2
+
+typedef enum { RAW_IMAGE_UNCOMPRESSED, RAW_IMAGE_LZ4 } RawImageCompression;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t bpp;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t rmask;
+    uint32_t gmask;
+    uint32_t bmask;
+    uint32_t amask;
+    uint32_t src_size;
+    int64_t src_mtime;
+    uint32_t compression; // RawImageCompression
+    uint32_t data_size;   // bytes stored after the header
+} RawImageHeader;
+
+typedef struct {
+    const RawImageHeader *header;
+    void *pixels;
+    void *map;
+    size_t map_size;
+    void *buffer; // decompressed pixels
+} RawImage;
+
+/**
+ * @brief Builds the cache path for a source image (extension replaced by .raw).
+ */
+void raw_image_path(char *path_out, const char *src_path)
+{
+    strcpy(path_out, src_path);
+    char *ext = strrchr(path_out, '.');
+    if (ext == NULL || strchr(ext, '/') != NULL)
+        ext = path_out + strlen(path_out);
+    strcpy(ext, ".raw");
+}
+
+/**
+ * @brief Writes a raw image cache for `src_path` (atomically, via rename).
+ * `header` describes the pixel format and the compression; its magic,
+ * version, source and size fields are filled in here. Pixels that don't
+ * compress are stored uncompressed.
+ *
+ * @return true The cache was written
+ */
+bool raw_image_write(const char *src_path, RawImageHeader header, const void *pixels)
+{
+    struct stat st;
+    char path[STR_MAX * 2];
+    char tmp_path[STR_MAX * 2 + 4];
+
+    if (stat(src_path, &st) != 0)
+        return false;
+
+    header.magic = RAW_IMAGE_MAGIC;
+    header.version = RAW_IMAGE_VERSION;
+    header.src_size = (uint32_t)st.st_size;
+    header.src_mtime = (int64_t)st.st_mtime;
+
+    size_t pixels_size = (size_t)header.pitch * header.height;
+    const void *data = pixels;
+    uint8_t *compressed = NULL;
+
+    header.data_size = pixels_size;
+
+    if (header.compression == RAW_IMAGE_LZ4) {
+        size_t bound = lz4_compressBound(pixels_size);
+        size_t compressed_size = 0;
+        if ((compressed = (uint8_t *)malloc(bound)) != NULL)
+            compressed_size = lz4_compress((const uint8_t *)pixels, pixels_size, compressed, bound);
+        if (compressed_size > 0 && compressed_size < pixels_size) {
+            data = compressed;
+            header.data_size = compressed_size;
+        }
+        else {
+            header.compression = RAW_IMAGE_UNCOMPRESSED;
+        }
+    }
+
+    raw_image_path(path, src_path);
+    sprintf(tmp_path, "%s.tmp", path);
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        free(compressed);
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(data, 1, header.data_size, fp) == header.data_size;
+
+    fflush(fp);
+    fsync(fileno(fp));
+    fclose(fp);
+    free(compressed);
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        print_debug("Error writing raw image cache");
+        return false;
+    }
+
+    return true;
+}
+
+void raw_image_unmap(RawImage *image)
+{
+    if (image->map != NULL)
+        munmap(image->map, image->map_size);
+    free(image->buffer);
+    memset(image, 0, sizeof(RawImage));
+}
+
+/**
+ * @brief Maps the raw image cache of `src_path`, if it exists and is up to
+ * date. Pages are mapped copy-on-write, so the pixels may be modified in
+ * memory without touching the file; compressed pixels are decompressed into
+ * a buffer.
+ *
+ * @return true `image_out` holds the mapping (free with raw_image_unmap)
+ */
+bool raw_image_map(const char *src_path, RawImage *image_out)
+{
+    struct stat src_st, st;
+    char path[STR_MAX * 2];
+
+    raw_image_path(path, src_path);
+
+    if (stat(src_path, &src_st) != 0)
+        return false;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RawImageHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    const RawImageHeader *header = (const RawImageHeader *)map;
+
+    if (header->magic != RAW_IMAGE_MAGIC ||
+        header->version != RAW_IMAGE_VERSION ||
+        header->src_mtime != (int64_t)src_st.st_mtime ||
+        header->src_size != (uint32_t)src_st.st_size ||
+        sizeof(RawImageHeader) + (size_t)header->data_size > (size_t)st.st_size ||
+        (header->compression == RAW_IMAGE_UNCOMPRESSED && header->data_size < (size_t)header->pitch * header->height) ||
+        header->compression > RAW_IMAGE_LZ4) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    image_out->header = header;
+    image_out->pixels = (char *)map + sizeof(RawImageHeader);
+    image_out->map = map;
+    image_out->map_size = st.st_size;
+    image_out->buffer = NULL;
+
+    if (header->compression == RAW_IMAGE_LZ4) {
+        size_t pixels_size = (size_t)header->pitch * header->height;
+        image_out->buffer = malloc(pixels_size);
+
+        if (image_out->buffer == NULL ||
+            !lz4_decompress((const uint8_t *)image_out->pixels, header->data_size, (uint8_t *)image_out->buffer, pixels_size)) {
+            print_debug("Invalid raw image cache");
+            raw_image_unmap(image_out);
+            return false;
+        }
+
+        image_out->pixels = image_out->buffer;
+    }
+
+    return true;
+}
+
+#endif // UTILS_RAW_IMAGE_H__
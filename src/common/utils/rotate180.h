@@ -1,17 +1,125 @@
 #ifndef ROTATE_180_H__
 #define ROTATE_180_H__
 
-#include "SDL/SDL_rotozoom.h"
 #include <SDL/SDL.h>
+#include <stdint.h>
 
-SDL_Surface *rotate180(SDL_Surface *original)
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * 180° rotation in place: row y is swapped with row h-1-y, each reversed
+ * (the middle row of an odd height is reversed onto itself). One pass over
+ * the pixels, no allocation. 16 and 32 bpp go through NEON when available
+ * (reversing 8 or 4 pixels per register, like RotateSurfaceNEON in
+ * clock/gfx.c); the plain loops are left for the compiler to vectorize.
+ */
+
+// Swaps top[i] with end[-1-i], for i < count (the two ranges never overlap)
+static void __rotate180_swap32(uint32_t *__restrict top, uint32_t *__restrict end, int count)
+{
+    int i = 0;
+#ifdef __ARM_NEON
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t a = vrev64q_u32(vld1q_u32(top + i));
+        uint32x4_t b = vrev64q_u32(vld1q_u32(end - 4 - i));
+        vst1q_u32(top + i, vcombine_u32(vget_high_u32(b), vget_low_u32(b)));
+        vst1q_u32(end - 4 - i, vcombine_u32(vget_high_u32(a), vget_low_u32(a)));
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t tmp = top[i];
+        top[i] = end[-1 - i];
+        end[-1 - i] = tmp;
+    }
+}
+
+static void __rotate180_swap16(uint16_t *__restrict top, uint16_t *__restrict end, int count)
+{
+    int i = 0;
+#ifdef __ARM_NEON
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t a = vrev64q_u16(vld1q_u16(top + i));
+        uint16x8_t b = vrev64q_u16(vld1q_u16(end - 8 - i));
+        vst1q_u16(top + i, vcombine_u16(vget_high_u16(b), vget_low_u16(b)));
+        vst1q_u16(end - 8 - i, vcombine_u16(vget_high_u16(a), vget_low_u16(a)));
+    }
+#endif
+    for (; i < count; i++) {
+        uint16_t tmp = top[i];
+        top[i] = end[-1 - i];
+        end[-1 - i] = tmp;
+    }
+}
+
+// Any pixel size (8 and 24 bpp)
+static void __rotate180_swapBytes(uint8_t *top, uint8_t *end, int count, int bytes_per_pixel)
+{
+    for (int i = 0; i < count; i++) {
+        uint8_t *a = top + i * bytes_per_pixel;
+        uint8_t *b = end - (i + 1) * bytes_per_pixel;
+        for (int k = 0; k < bytes_per_pixel; k++) {
+            uint8_t tmp = a[k];
+            a[k] = b[k];
+            b[k] = tmp;
+        }
+    }
+}
+
+static void __rotate180_swapRows(uint8_t *top, uint8_t *bottom, int width, int bytes_per_pixel)
 {
-    SDL_Surface *rotated = rotozoomSurface(original, 180.0, 1.0, 0);
-    SDL_FillRect(original, NULL, SDL_MapRGB(original->format, 255, 0, 0));
-    SDL_Rect rect = {-2, -2};
-    SDL_BlitSurface(rotated, NULL, original, &rect);
-    SDL_FreeSurface(rotated);
-    return original;
+    // Reversing a row onto itself only takes half the swaps
+    int count = top == bottom ? width / 2 : width;
+    uint8_t *end = bottom + width * bytes_per_pixel;
+
+    switch (bytes_per_pixel) {
+    case 4:
+        __rotate180_swap32((uint32_t *)top, (uint32_t *)end, count);
+        break;
+    case 2:
+        __rotate180_swap16((uint16_t *)top, (uint16_t *)end, count);
+        break;
+    default:
+        __rotate180_swapBytes(top, end, count, bytes_per_pixel);
+        break;
+    }
+}
+
+/**
+ * @brief Rotates the pixels of a surface by 180°, in place.
+ *
+ * @param pixels First row
+ * @param width In pixels
+ * @param height In rows
+ * @param pitch Bytes per row (rows may be padded)
+ * @param bytes_per_pixel 1 to 4
+ */
+void rotate180_pixels(void *pixels, int width, int height, int pitch, int bytes_per_pixel)
+{
+    uint8_t *data = (uint8_t *)pixels;
+
+    for (int y = 0; y < (height + 1) / 2; y++)
+        __rotate180_swapRows(data + y * pitch, data + (height - 1 - y) * pitch, width, bytes_per_pixel);
+}
+
+/**
+ * @brief Rotates `surface` by 180°, in place.
+ *
+ * @return SDL_Surface* `surface`
+ */
+SDL_Surface *rotate180(SDL_Surface *surface)
+{
+    if (surface == NULL)
+        return NULL;
+
+    if (SDL_MUSTLOCK(surface))
+        SDL_LockSurface(surface);
+    rotate180_pixels(surface->pixels, surface->w, surface->h, surface->pitch, surface->format->BytesPerPixel);
+    if (SDL_MUSTLOCK(surface))
+        SDL_UnlockSurface(surface);
+
+    return surface;
 }
 
 #endif // ROTATE_180_H__
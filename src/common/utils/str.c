@@ -34,7 +34,7 @@ char *str_split(char *str, const char *delim)
     return p + strlen(delim); // return tail substring
 }
 
-char *str_replace(char *orig, char *rep, char *with)
+char *str_replace(char *orig, const char *rep, const char *with)
 {
     char *ins;     // the next insert point
     char *tmp;     // varies
@@ -15,7 +15,7 @@
 
 bool str_getLastNumber(char *str, long *out_val);
 char *str_split(char *str, const char *delim);
-char *str_replace(char *orig, char *rep, char *with);
+char *str_replace(char *orig, const char *rep, const char *with);
 
 // Stores the trimmed input string into the given output buffer, which must be
 // large enough to store the result.  If it is too small, the output is
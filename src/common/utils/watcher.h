@@ -0,0 +1,163 @@
+#ifndef UTILS_WATCHER_H__
+#define UTILS_WATCHER_H__
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "str.h"
+
+/**
+ * File watcher: inotify watches on the parent directories of a set of paths
+ * (so files that don't exist yet, like flag files, can be watched too).
+ * Put `watcher->fd` in a poll() set and call watcher_dispatch() when it is
+ * readable; the callback of each path that changed is called once per
+ * dispatch.
+ */
+
+#define WATCHER_MAX 16
+#define WATCHER_MASK (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM)
+
+typedef enum { WATCH_CHANGED, WATCH_REMOVED } WatchEvent;
+
+typedef void (*WatcherCallback)(const char *path, WatchEvent event, void *userdata);
+
+typedef struct {
+    int wd;
+    char path[STR_MAX];
+    const char *name; // points into `path`
+    WatcherCallback callback;
+    void *userdata;
+    int pending; // -1: none, else the WatchEvent to report
+} WatchEntry;
+
+typedef struct {
+    int fd;
+    int count;
+    WatchEntry entries[WATCHER_MAX];
+} Watcher;
+
+/**
+ * @brief Initializes the watcher.
+ *
+ * @return false inotify isn't available (`watcher->fd` is -1)
+ */
+bool watcher_init(Watcher *watcher)
+{
+    memset(watcher, 0, sizeof(Watcher));
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (watcher->fd == -1) {
+        printf_debug("watcher: inotify_init1 failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Watches `path` (a file, which doesn't need to exist, in an
+ * existing directory).
+ *
+ * @return true The watch was added
+ */
+bool watcher_add(Watcher *watcher, const char *path, WatcherCallback callback, void *userdata)
+{
+    if (watcher->fd == -1 || watcher->count >= WATCHER_MAX)
+        return false;
+
+    WatchEntry *entry = &watcher->entries[watcher->count];
+    strncpy(entry->path, path, STR_MAX - 1);
+
+    char *sep = strrchr(entry->path, '/');
+    if (sep == NULL || sep[1] == '\0')
+        return false;
+
+    // Watch the directory (several entries may share the same watch)
+    *sep = '\0';
+    entry->wd = inotify_add_watch(watcher->fd, sep == entry->path ? "/" : entry->path, WATCHER_MASK);
+    *sep = '/';
+
+    if (entry->wd == -1) {
+        printf_debug("watcher: can't watch %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    entry->name = sep + 1;
+    entry->callback = callback;
+    entry->userdata = userdata;
+    entry->pending = -1;
+    watcher->count++;
+
+    return true;
+}
+
+static void __watcher_mark(Watcher *watcher, const struct inotify_event *event)
+{
+    for (int i = 0; i < watcher->count; i++) {
+        WatchEntry *entry = &watcher->entries[i];
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            // Events were lost: report the current state of everything
+            struct stat st;
+            entry->pending = stat(entry->path, &st) == 0 ? WATCH_CHANGED : WATCH_REMOVED;
+            continue;
+        }
+
+        if (entry->wd != event->wd || event->len == 0 || strcmp(entry->name, event->name) != 0)
+            continue;
+
+        entry->pending = event->mask & (IN_DELETE | IN_MOVED_FROM) ? WATCH_REMOVED : WATCH_CHANGED;
+    }
+}
+
+/**
+ * @brief Reads the pending inotify events and calls the callbacks of the
+ * paths that changed (with the last event seen for each).
+ *
+ * @return int Number of callbacks called
+ */
+int watcher_dispatch(Watcher *watcher)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    int called = 0;
+
+    if (watcher->fd == -1)
+        return 0;
+
+    while ((len = read(watcher->fd, buffer, sizeof(buffer))) > 0) {
+        for (char *ptr = buffer; ptr < buffer + len;) {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            __watcher_mark(watcher, event);
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    for (int i = 0; i < watcher->count; i++) {
+        WatchEntry *entry = &watcher->entries[i];
+        if (entry->pending == -1)
+            continue;
+        WatchEvent event = (WatchEvent)entry->pending;
+        entry->pending = -1;
+        entry->callback(entry->path, event, entry->userdata);
+        called++;
+    }
+
+    return called;
+}
+
+void watcher_close(Watcher *watcher)
+{
+    if (watcher->fd != -1)
+        close(watcher->fd);
+    watcher->fd = -1;
+    watcher->count = 0;
+}
+
+#endif // UTILS_WATCHER_H__
@@ -14,6 +14,7 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "png/png.h"
@@ -27,12 +28,14 @@
 #include "theme/sound.h"
 #include "theme/theme.h"
 #include "utils/config.h"
+#include "utils/dirtyRects.h"
 #include "utils/file.h"
 #include "utils/hash.h"
 #include "utils/json.h"
 #include "utils/keystate.h"
 #include "utils/log.h"
 #include "utils/msleep.h"
+#include "utils/rawImage.h"
 #include "utils/sdl_init.h"
 #include "utils/str.h"
 #include "utils/surfaceSetAlpha.h"
@@ -90,6 +93,7 @@ typedef struct {
     int gameIndex;
     int lineNumber;
     SDL_Surface *romScreen;
+    RawImage romScreenRaw;
     char romImagePath[STR_MAX * 4];
     char path[PATH_MAX * 2];
 } Game_s;
@@ -108,6 +112,38 @@ static cJSON *json_root = NULL;
 
 static bool __initial_romscreens_loaded = false;
 
+// Frame time counter, enabled with the `gameSwitcher/frameTime` config flag
+static bool frame_time_enabled = false;
+
+static uint64_t __frameTime_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Accumulates the time spent composing and uploading a frame, and
+ * prints the average and worst frame time every 60 frames.
+ */
+static void __frameTime_add(uint64_t frame_start)
+{
+    static uint64_t total = 0, worst = 0;
+    static int frames = 0;
+
+    uint64_t elapsed = __frameTime_now() - frame_start;
+    total += elapsed;
+    if (elapsed > worst)
+        worst = elapsed;
+
+    if (++frames == 60) {
+        printf("frame time: avg %" PRIu64 " us, max %" PRIu64 " us\n", total / frames, worst);
+        fflush(stdout);
+        total = worst = 0;
+        frames = 0;
+    }
+}
+
 void unloadRomScreen(int index)
 {
     if (index < 0 || index >= game_list_len)
@@ -118,6 +154,59 @@ void unloadRomScreen(int index)
         SDL_FreeSurface(game->romScreen);
         game->romScreen = NULL;
     }
+
+    raw_image_unmap(&game->romScreenRaw);
+}
+
+/**
+ * @brief Wraps the mmapped raw cache of a rom screen in a surface, no decoding
+ * needed. The pixels stay owned by `raw` (unmapped in unloadRomScreen).
+ */
+static SDL_Surface *__loadRomScreenRaw(RawImage *raw, const char *png_path)
+{
+    if (!raw_image_map(png_path, raw))
+        return NULL;
+
+    const RawImageHeader *h = raw->header;
+    SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(raw->pixels, h->width, h->height, h->bpp, h->pitch, h->rmask, h->gmask, h->bmask, h->amask);
+
+    if (surface == NULL)
+        raw_image_unmap(raw);
+
+    return surface;
+}
+
+/**
+ * @brief Decodes a rom screen PNG into the screen's pixel format, and saves it
+ * as an LZ4 raw cache so the next load can skip decoding.
+ */
+static SDL_Surface *__loadRomScreenPng(const char *png_path)
+{
+    SDL_Surface *image = IMG_Load(png_path);
+
+    if (image == NULL)
+        return NULL;
+
+    SDL_Surface *converted = SDL_ConvertSurface(image, screen->format, 0);
+    SDL_FreeSurface(image);
+
+    if (converted == NULL)
+        return NULL;
+
+    SDL_PixelFormat *fmt = converted->format;
+    RawImageHeader header = {
+        .bpp = fmt->BitsPerPixel,
+        .width = converted->w,
+        .height = converted->h,
+        .pitch = converted->pitch,
+        .rmask = fmt->Rmask,
+        .gmask = fmt->Gmask,
+        .bmask = fmt->Bmask,
+        .amask = fmt->Amask,
+        .compression = RAW_IMAGE_LZ4};
+    raw_image_write(png_path, header, converted->pixels);
+
+    return converted;
 }
 
 SDL_Surface *loadRomScreen(int index)
@@ -139,7 +228,16 @@ SDL_Surface *loadRomScreen(int index)
 
         if (exists(currPicture)) {
             strcpy(game->romImagePath, currPicture);
-            game->romScreen = IMG_Load(currPicture);
+
+            // Rom screens get a pre-decoded raw cache, other artwork is loaded as is
+            if (strncmp(currPicture, ROM_SCREENS_DIR, strlen(ROM_SCREENS_DIR)) == 0) {
+                game->romScreen = __loadRomScreenRaw(&game->romScreenRaw, currPicture);
+                if (game->romScreen == NULL)
+                    game->romScreen = __loadRomScreenPng(currPicture);
+            }
+            else {
+                game->romScreen = IMG_Load(currPicture);
+            }
         }
     }
 
@@ -155,14 +253,8 @@ SDL_Surface *loadRomScreen(int index)
 
 void freeRomScreens()
 {
-    for (int i = 0; i < game_list_len; i++) {
-        Game_s *game = &game_list[i];
-
-        if (game->romScreen != NULL) {
-            SDL_FreeSurface(game->romScreen);
-            game->romScreen = NULL;
-        }
-    }
+    for (int i = 0; i < game_list_len; i++)
+        unloadRomScreen(i);
 }
 
 static void *_loadRomScreensThread(void *_)
@@ -212,150 +304,215 @@ void printHistory()
     }
 }
 
+// Open-addressing set of rom paths seen while reading the history
+#define HISTORY_SET_SIZE 512
+
+typedef struct {
+    const char *path;
+    uint32_t hash;
+    bool exists;
+} HistoryEntry;
+
+static HistoryEntry *__history_set_find(HistoryEntry *set, const char *path, uint32_t hash)
+{
+    uint32_t i = hash & (HISTORY_SET_SIZE - 1);
+    while (set[i].path != NULL) {
+        if (set[i].hash == hash && strcmp(set[i].path, path) == 0)
+            break;
+        i = (i + 1) & (HISTORY_SET_SIZE - 1);
+    }
+    return &set[i];
+}
+
 /**
- * @brief History extraction
+ * @brief Copies the string value of `"key":"..."` from a recentlist line.
+ */
+static bool __history_field(const char *json, const char *key, char *out, size_t size)
+{
+    const char *start = strstr(json, key);
+    out[0] = '\0';
+    if (start == NULL)
+        return false;
+    start += strlen(key);
+    const char *end = strchr(start, '\"');
+    if (end == NULL)
+        return false;
+    size_t len = end - start < size - 1 ? end - start : size - 1;
+    memcpy(out, start, len);
+    out[len] = '\0';
+    return true;
+}
+
+typedef struct {
+    HistoryEntry roms[HISTORY_SET_SIZE];
+    int roms_len;
+    HistoryEntry launchers[MAXHISTORY];
+    int launchers_len;
+} HistoryIndex;
+
+/**
+ * @brief Launchers are shared by many games, only stat each of them once.
+ */
+static bool __history_launch_exists(HistoryIndex *index, const char *launch)
+{
+    uint32_t hash = FNV1A_Pippip_Yurii(launch, strlen(launch));
+    for (int i = 0; i < index->launchers_len; i++) {
+        if (index->launchers[i].hash == hash && strcmp(index->launchers[i].path, launch) == 0)
+            return index->launchers[i].exists;
+    }
+    bool launch_exists = exists(launch);
+    if (index->launchers_len < MAXHISTORY)
+        index->launchers[index->launchers_len++] = (HistoryEntry){strdup(launch), hash, launch_exists};
+    return launch_exists;
+}
+
+/**
+ * @brief Adds the game of a recentlist line to the game list, if its rom
+ * and launcher exist.
  *
+ * @return false If the line is a duplicate of an earlier game (to be removed)
  */
-void readHistory()
+static bool __history_addLine(HistoryIndex *index, const char *line, int lineNumber)
 {
-    FILE *file;
-    char line[STR_MAX * 3];
-    char *jsonContent;
-    int nbGame = 0;
-    int lineCounter = 0;
-    file = fopen(getMiyooRecentFilePath(), "r");
-
-    if (file == NULL) {
-        print_debug("Error opening file");
-        return;
+    char rompath[STR_MAX * 2];
+    char imgpath[STR_MAX * 2];
+    char launch[STR_MAX * 2];
+    int type = 0;
+
+    if (game_list_len >= MAXHISTORY || index->roms_len >= HISTORY_SET_SIZE / 2)
+        return true;
+
+    const char *typeStart = strstr(line, "\"type\":");
+    if (typeStart != NULL)
+        sscanf(typeStart + 7, "%d", &type);
+
+    if ((type != 5) && (type != 17))
+        return true;
+
+    __history_field(line, "\"rompath\":\"", rompath, sizeof(rompath));
+    __history_field(line, "\"imgpath\":\"", imgpath, sizeof(imgpath));
+
+    char *colonPosition = strchr(rompath, ':');
+    if (colonPosition != NULL) {
+        *colonPosition = '\0';
+        strcpy(launch, rompath);
+        memmove(rompath, colonPosition + 1, strlen(colonPosition + 1) + 1);
+        printf_debug("launch cutted: %s\n", launch);
+        printf_debug("rompath cutted: %s\n", rompath);
+    }
+    else {
+        __history_field(line, "\"launch\":\"", launch, sizeof(launch));
     }
 
-    while ((fgets(line, STR_MAX * 6, file) != NULL) && (nbGame < MAXHISTORY)) {
-        char label[STR_MAX * 2];
-        char rompath[STR_MAX * 2];
-        char imgpath[STR_MAX * 2];
-        char launch[STR_MAX * 2];
-        int type;
-        lineCounter++;
-
-        jsonContent = (char *)malloc(strlen(line) + 1);
-        if (jsonContent == NULL) {
-            print_debug("Memory allocation error");
-            fclose(file);
-            return;
-        }
+    // Search for duplicates
+    uint32_t hash = FNV1A_Pippip_Yurii(rompath, strlen(rompath));
+    HistoryEntry *entry = __history_set_find(index->roms, rompath, hash);
 
-        strcpy(jsonContent, line);
-        printf_debug("jsonContent: %s\n", jsonContent);
+    if (entry->path != NULL)
+        return !entry->exists;
 
-        sscanf(strstr(jsonContent, "\"type\":") + 7, "%d", &type);
+    entry->path = strdup(rompath);
+    entry->hash = hash;
+    entry->exists = exists(rompath) && __history_launch_exists(index, launch);
+    index->roms_len++;
 
-        if ((type != 5) && (type != 17))
-            continue;
+    if (!entry->exists)
+        return true;
 
-        print_debug("type 5");
+    Game_s *game = &game_list[game_list_len];
 
-        const char *labelStart = strstr(jsonContent, "\"label\":\"");
-        if (labelStart != NULL) {
-            labelStart += 9;
-            const char *labelEnd = strchr(labelStart, '\"');
-            strncpy(label, labelStart, labelEnd - labelStart);
-            label[labelEnd - labelStart] = '\0';
-        }
-        printf_debug("label: %s\n", label);
-        const char *rompathStart = strstr(jsonContent, "\"rompath\":\"");
-        if (rompathStart != NULL) {
-            rompathStart += 11;
-            const char *rompathEnd = strchr(rompathStart, '\"');
-            strncpy(rompath, rompathStart, rompathEnd - rompathStart);
-            rompath[rompathEnd - rompathStart] = '\0';
-        }
-        printf_debug("rompath: %s\n", rompath);
-        const char *imgpathStart = strstr(jsonContent, "\"imgpath\":\"");
-        if (imgpathStart != NULL) {
-            imgpathStart += 11;
-            const char *imgpathEnd = strchr(imgpathStart, '\"');
-            strncpy(imgpath, imgpathStart, imgpathEnd - imgpathStart);
-            imgpath[imgpathEnd - imgpathStart] = '\0';
-        }
-        printf_debug("imgpath: %s\n", imgpath);
+    game->lineNumber = lineNumber;
+    game->romScreen = NULL;
+    memset(&game->romScreenRaw, 0, sizeof(RawImage));
+    game->totalTime[0] = '\0';
 
-        char *colonPosition = strchr(rompath, ':');
-        if (colonPosition != NULL) {
+    sprintf(game->LaunchCommand, "LD_PRELOAD=/mnt/SDCARD/miyoo/app/../lib/libpadsp.so \"%s\" \"%s\"", launch, rompath);
 
-            int position = (int)(colonPosition - rompath);
+    getGameName(game->name, rompath);
+    strcpy(game->path, rompath);
+    strcpy(game->romImagePath, imgpath);
+    file_cleanName(game->shortname, game->name);
+    game->gameIndex = game_list_len + 1;
 
-            char firstPart[position + 1];
-            strncpy(firstPart, rompath, position);
-            firstPart[position] = '\0';
+    game_list_len++;
 
-            char secondPart[strlen(rompath) - position];
-            strcpy(secondPart, colonPosition + 1);
+    printf_debug("name: %s\n", game->name);
+    printf_debug("path: %s\n", game->path);
 
-            strcpy(launch, firstPart);
-            strcpy(rompath, secondPart);
-            printf_debug("launch cutted: %s\n", launch);
-            printf_debug("rompath cutted: %s\n", rompath);
-        }
-        else {
-            const char *launchStart = strstr(jsonContent, "\"launch\":\"");
-            if (launchStart != NULL) {
-                launchStart += 10;
-                const char *launchEnd = strchr(launchStart, '\"');
-                strncpy(launch, launchStart, launchEnd - launchStart);
-                launch[launchEnd - launchStart] = '\0';
-            }
-        }
+    return true;
+}
+
+/**
+ * @brief History extraction
+ *
+ * Reads the recent list in one go and deduplicates it by rom path. If
+ * duplicates were found, the file is rewritten once (atomically) without them.
+ */
+void readHistory()
+{
+    char *content = (char *)file_read(getMiyooRecentFilePath());
+
+    if (content == NULL) {
+        print_debug("Error opening file");
+        return;
+    }
 
-        printf_debug("launch: %s\n", launch);
-        free(jsonContent);
+    HistoryIndex *index = (HistoryIndex *)calloc(1, sizeof(HistoryIndex));
+    char *content_end = content + strlen(content);
 
-        if (!exists(rompath) || !exists(launch))
-            continue;
+    // Lines to keep, pointing into `content`
+    int lines_cap = 128, lines_len = 0;
+    char **lines = (char **)malloc(lines_cap * sizeof(char *));
+    bool has_duplicates = false;
 
-        // Search for duplicates
-        bool bGameExists = false;
-        for (int i = 0; i < nbGame; i++) {
-            if (strcmp(rompath, game_list[i].path) == 0) {
-                bGameExists = true;
-                break;
+    game_list_len = 0;
+
+    for (char *line = content; line < content_end;) {
+        char *next = strchr(line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+        else
+            next = content_end;
+
+        if (__history_addLine(index, line, lines_len + 1)) {
+            if (lines_len == lines_cap) {
+                lines_cap *= 2;
+                lines = (char **)realloc(lines, lines_cap * sizeof(char *));
             }
+            lines[lines_len++] = line;
         }
-        if (bGameExists) {
-            // recentlist line deletion
-            file_delete_line(getMiyooRecentFilePath(), lineCounter);
-            lineCounter--;
-            continue;
+        else {
+            has_duplicates = true;
         }
 
-        Game_s *game = &game_list[nbGame];
+        line = next;
+    }
 
-        game->lineNumber = lineCounter;
-        game->romScreen = NULL;
-        game->totalTime[0] = '\0';
-
-        sprintf(game->LaunchCommand, "LD_PRELOAD=/mnt/SDCARD/miyoo/app/../lib/libpadsp.so \"%s\" \"%s\"", launch, rompath);
-
-        getGameName(game->name, rompath);
-        strcpy(game->path, rompath);
-        strcpy(game->romImagePath, imgpath);
-        file_cleanName(game->shortname, game->name);
-        game->gameIndex = nbGame + 1;
-        game = &game_list[nbGame];
-
-        nbGame++;
-
-        printf_debug("name: %s\n", game->name);
-        printf_debug("shortname: %s\n", game->shortname);
-        printf_debug("LaunchCommand: %s\n", game->LaunchCommand);
-        printf_debug("totalTime: %i\n", game->totalTime);
-        printf_debug("gameIndex: %i\n", game->gameIndex);
-        printf_debug("lineNumber: %i\n", game->lineNumber);
-        printf_debug("romImagePath: %s\n", game->romImagePath);
-        printf_debug("path: %s\n", game->path);
+    if (has_duplicates) {
+        char tmp_path[STR_MAX];
+        snprintf(tmp_path, STR_MAX - 1, "%s.tmp", getMiyooRecentFilePath());
+        FILE *file = fopen(tmp_path, "w");
+        if (file != NULL) {
+            for (int i = 0; i < lines_len; i++) {
+                fputs(lines[i], file);
+                fputc('\n', file);
+            }
+            fflush(file);
+            fsync(fileno(file));
+            fclose(file);
+            if (rename(tmp_path, getMiyooRecentFilePath()) != 0)
+                print_debug("Error renaming temporary file");
+        }
     }
 
-    game_list_len = nbGame;
+    for (int i = 0; i < HISTORY_SET_SIZE; i++)
+        free((char *)index->roms[i].path);
+    for (int i = 0; i < index->launchers_len; i++)
+        free((char *)index->launchers[i].path);
+    free(index);
+    free(lines);
+    free(content);
+
     pthread_create(&thread_pt, NULL, _loadRomScreensThread, NULL);
 }
 
@@ -366,16 +523,16 @@ void removeCurrentItem()
     printf_debug("removing: %s\n", game->name);
     printf_debug("linenumber: %i\n", game->lineNumber);
 
-    if (game->romScreen != NULL) {
-        SDL_FreeSurface(game->romScreen);
-        game->romScreen = NULL;
-    }
+    unloadRomScreen(current_game);
 
     file_delete_line(getMiyooRecentFilePath(), game->lineNumber);
 
     if (strlen(game->romImagePath) > 0 && is_file(game->romImagePath)) {
         if (strncmp(game->romImagePath, ROM_SCREENS_DIR, strlen(ROM_SCREENS_DIR)) == 0) {
+            char raw_path[STR_MAX * 4];
+            raw_image_path(raw_path, game->romImagePath);
             remove(game->romImagePath);
+            remove(raw_path);
         }
     }
 
@@ -416,6 +573,8 @@ int main(int argc, char *argv[])
     readHistory();
     //printHistory();
 
+    play_activity_db_keep_open();
+
     settings_load();
     lang_load();
 
@@ -476,6 +635,11 @@ int main(int argc, char *argv[])
 
     SDL_Surface *current_bg = NULL;
 
+    DirtyRects dirty = {0};
+    SDL_Rect legend_rect = {0}, brightness_rect = {0};
+
+    frame_time_enabled = config_flag_get("gameSwitcher/frameTime");
+
     while (!quit) {
         uint32_t ticks = SDL_GetTicks();
         acc_ticks += ticks - last_ticks;
@@ -484,13 +648,13 @@ int main(int argc, char *argv[])
         if (show_legend && ticks - legend_start > legend_timeout) {
             show_legend = false;
             config_flag_set("gameSwitcher/hideLegend", true);
-            changed = true;
+            dirty_add(&dirty, screen, legend_rect);
         }
 
         if (brightness_changed &&
             ticks - brightness_start > brightness_timeout) {
             brightness_changed = false;
-            changed = true;
+            dirty_add(&dirty, screen, brightness_rect);
         }
 
         if (updateKeystate(keystate, &quit, true, &changed_key)) {
@@ -654,71 +818,74 @@ int main(int argc, char *argv[])
             }
         }
 
-        if (battery_hasChanged(ticks, &battery_percentage))
-            changed = true;
+        if (battery_hasChanged(ticks, &battery_percentage) && view_mode == VIEW_NORMAL)
+            dirty_add(&dirty, screen, (SDL_Rect){0, 0, 640, header_height});
 
         if (acc_ticks >= time_step) {
             acc_ticks -= time_step;
 
-            if (!changed && !brightness_changed && (surfaceGameName == NULL || surfaceGameName->w <= game_name_max_width))
-                continue;
+            SDL_Rect game_name_band = {0, 0, 640, 60};
+            if (view_mode == VIEW_NORMAL) {
+                game_name_band.x = theme()->frame.border_left;
+                game_name_band.w -= theme()->frame.border_left + theme()->frame.border_right;
+            }
+            game_name_band.y = view_mode == VIEW_NORMAL ? (480 - footer_height - 60) : 420;
 
-            if (changed) {
-                SDL_BlitSurface(theme_background(), NULL, screen, NULL);
+            // Game name marquee
+            if (view_mode != VIEW_FULLSCREEN && surfaceGameName != NULL && surfaceGameName->w > game_name_max_width)
+                dirty_add(&dirty, screen, game_name_band);
 
-                if (game_list_len == 0) {
-                    current_bg = NULL;
-                    SDL_Surface *empty = resource_getSurface(EMPTY_BG);
-                    SDL_Rect empty_rect = {320 - empty->w / 2,
-                                           240 - empty->h / 2};
-                    SDL_BlitSurface(empty, NULL, screen, &empty_rect);
-                }
-                else {
-                    current_bg = loadRomScreen(current_game);
+            if (changed)
+                dirty_addFull(&dirty, screen);
 
-                    if (current_bg != NULL) {
+            if (dirty_isEmpty(&dirty))
+                continue;
 
-                        if (current_bg->w > 640 || current_bg->h > 480) {
-                            printf_debug("Scaling screenshot from %dx%d to 640x480\n", current_bg->w, current_bg->h);
-                            SDL_Rect dest_rect = {0, 0, 640, 480};
-                            SDL_SoftStretch(current_bg, NULL, current_bg, &dest_rect);
-                            current_bg->w = 640;
-                            current_bg->h = 480;
-                        }
+            uint64_t frame_start = frame_time_enabled ? __frameTime_now() : 0;
 
-                        int offSetX = (int)(640 - current_bg->w) / 2;
-                        int offSetY = (int)(480 - current_bg->h) / 2;
+            // Everything below is clipped to the damaged area
+            dirty_clip(&dirty, screen);
 
-                        SDL_Rect game_name_bg_size = {0, 0, 640, 480};
-                        SDL_Rect game_name_bg_pos = {offSetX, offSetY};
+            if (changed)
+                current_bg = game_list_len > 0 ? loadRomScreen(current_game) : NULL;
 
-                        SDL_Rect frame = {theme()->frame.border_left, 0, 640 - theme()->frame.border_left - theme()->frame.border_right, 480};
-                        SDL_Rect frame_pos = {offSetX + theme()->frame.border_left, offSetY};
+            SDL_BlitSurface(theme_background(), NULL, screen, NULL);
 
-                        if (view_mode == VIEW_NORMAL)
-                            SDL_BlitSurface(current_bg, &frame, screen, &frame_pos);
-                        else
-                            SDL_BlitSurface(current_bg, &game_name_bg_size, screen, &game_name_bg_pos);
-                    }
-                }
+            if (game_list_len == 0) {
+                SDL_Surface *empty = resource_getSurface(EMPTY_BG);
+                SDL_Rect empty_rect = {320 - empty->w / 2,
+                                       240 - empty->h / 2};
+                SDL_BlitSurface(empty, NULL, screen, &empty_rect);
             }
+            else if (current_bg != NULL) {
+                if (current_bg->w > 640 || current_bg->h > 480) {
+                    printf_debug("Scaling screenshot from %dx%d to 640x480\n", current_bg->w, current_bg->h);
+                    SDL_Rect dest_rect = {0, 0, 640, 480};
+                    SDL_SoftStretch(current_bg, NULL, current_bg, &dest_rect);
+                    current_bg->w = 640;
+                    current_bg->h = 480;
+                }
 
-            Game_s *game = &game_list[current_game];
+                int offSetX = (int)(640 - current_bg->w) / 2;
+                int offSetY = (int)(480 - current_bg->h) / 2;
 
-            if (view_mode != VIEW_FULLSCREEN && game_list_len > 0) {
-                SDL_Rect game_name_bg_size = {0, 0, 640, 60};
-                SDL_Rect game_name_bg_pos = {0, 360};
+                SDL_Rect game_name_bg_size = {0, 0, 640, 480};
+                SDL_Rect game_name_bg_pos = {offSetX, offSetY};
 
-                if (view_mode == VIEW_NORMAL) {
+                SDL_Rect frame = {theme()->frame.border_left, 0, 640 - theme()->frame.border_left - theme()->frame.border_right, 480};
+                SDL_Rect frame_pos = {offSetX + theme()->frame.border_left, offSetY};
 
-                    game_name_bg_size.x = game_name_bg_pos.x =
-                        theme()->frame.border_left;
-                    game_name_bg_size.w -= theme()->frame.border_left +
-                                           theme()->frame.border_right;
-                }
+                if (view_mode == VIEW_NORMAL)
+                    SDL_BlitSurface(current_bg, &frame, screen, &frame_pos);
+                else
+                    SDL_BlitSurface(current_bg, &game_name_bg_size, screen, &game_name_bg_pos);
+            }
 
-                game_name_bg_size.y = game_name_bg_pos.y =
-                    view_mode == VIEW_NORMAL ? (480 - footer_height - 60) : 420;
+            Game_s *game = &game_list[current_game];
+
+            if (view_mode != VIEW_FULLSCREEN && game_list_len > 0 && dirty_intersects(&dirty, game_name_band)) {
+                SDL_Rect game_name_bg_size = game_name_band;
+                SDL_Rect game_name_bg_pos = game_name_band;
 
                 SDL_BlitSurface(current_bg, &game_name_bg_size, screen,
                                 &game_name_bg_pos);
@@ -781,13 +948,7 @@ int main(int argc, char *argv[])
                 }
             }
 
-            if (!changed) {
-                SDL_BlitSurface(screen, NULL, video, NULL);
-                SDL_Flip(video);
-                continue;
-            }
-
-            if (view_mode == VIEW_NORMAL) {
+            if (view_mode == VIEW_NORMAL && dirty_intersects(&dirty, (SDL_Rect){0, 480 - footer_height, 640, footer_height})) {
                 if (custom_footer) {
                     if (footer_height > 0) {
                         SDL_Rect footer_rect = {0, 480 - custom_footer->h};
@@ -806,7 +967,7 @@ int main(int argc, char *argv[])
                 }
             }
 
-            if (view_mode == VIEW_NORMAL) {
+            if (view_mode == VIEW_NORMAL && dirty_intersects(&dirty, (SDL_Rect){0, 0, 640, header_height})) {
                 char title_str[STR_MAX] = "GameSwitcher";
                 if (show_time && game_list_len > 0) {
                     if (strlen(game->totalTime) == 0) {
@@ -847,10 +1008,12 @@ int main(int argc, char *argv[])
 
             if (show_legend && view_mode != VIEW_FULLSCREEN) {
                 SDL_Surface *legend = resource_getSurface(LEGEND_GAMESWITCHER);
-                SDL_Rect legend_rect = {640 - legend->w,
-                                        view_mode == VIEW_NORMAL ? header_height
-                                                                 : 0};
-                SDL_BlitSurface(legend, NULL, screen, &legend_rect);
+                legend_rect = (SDL_Rect){640 - legend->w,
+                                         view_mode == VIEW_NORMAL ? header_height
+                                                                  : 0,
+                                         legend->w, legend->h};
+                SDL_Rect legend_pos = legend_rect;
+                SDL_BlitSurface(legend, NULL, screen, &legend_pos);
             }
 
             if (brightness_changed) {
@@ -858,19 +1021,23 @@ int main(int argc, char *argv[])
                 SDL_Surface *brightness =
                     resource_getBrightness(settings.brightness);
                 bool vertical = brightness->h > brightness->w;
-                SDL_Rect brightness_rect = {
+                brightness_rect = (SDL_Rect){
                     0,
-                    (view_mode == VIEW_NORMAL ? 240 : 210) - brightness->h / 2};
+                    (view_mode == VIEW_NORMAL ? 240 : 210) - brightness->h / 2,
+                    brightness->w, brightness->h};
                 if (!vertical) {
                     brightness_rect.x = 320 - brightness->w / 2;
                     brightness_rect.y =
                         view_mode == VIEW_NORMAL ? header_height : 0;
                 }
-                SDL_BlitSurface(brightness, NULL, screen, &brightness_rect);
+                SDL_Rect brightness_pos = brightness_rect;
+                SDL_BlitSurface(brightness, NULL, screen, &brightness_pos);
             }
 
-            SDL_BlitSurface(screen, NULL, video, NULL);
-            SDL_Flip(video);
+            dirty_flip(&dirty, screen, video);
+
+            if (frame_time_enabled)
+                __frameTime_add(frame_start);
 
             changed = false;
             current_game_changed = false;
@@ -907,6 +1074,8 @@ int main(int argc, char *argv[])
     if (surfaceGameName != NULL)
         SDL_FreeSurface(surfaceGameName);
 
+    play_activity_db_release();
+    cache_db_release();
     resources_free();
     SDL_FreeSurface(transparent_bg);
 
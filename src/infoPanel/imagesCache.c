@@ -1,12 +1,45 @@
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <SDL/SDL.h>
 #include <SDL/SDL_image.h>
 #include <SDL/SDL_rotozoom.h>
 
-static SDL_Surface *g_image_cache_prev = NULL;
-static SDL_Surface *g_image_cache_current = NULL;
-static SDL_Surface *g_image_cache_next = NULL;
+#include "imagesCache.h"
+#include "imagesScale.h"
+#include "utils/imageCache.h"
+
+// Decoded pages kept around the current one, loaded ahead in the
+// direction pages are turned
+#define IMAGES_CACHE_SLOTS 5
+
+static ImageCache *g_image_cache = NULL;
+static char **g_cache_paths = NULL;
+static int g_cache_paths_count = 0;
+// Size the cached images are scaled down to
+static int g_cache_width = 0;
+static int g_cache_height = 0;
+
+// Where scaled images are kept between runs, see setScaledImagesStore
+static ScaledImageLoader g_load_scaled_image = NULL;
+static ScaledImageSaver g_save_scaled_image = NULL;
+
+// Scaled copies of the images drawImage scaled down, by image and size
+// (where the target is doesn't matter)
+#define SCALED_VARIANTS_COUNT 4
+
+typedef struct {
+    SDL_Surface *image; // referenced while cached
+    int width;
+    int height;
+    SDL_Surface *scaled_image;
+    uint32_t last_used;
+} ScaledVariant;
+
+static ScaledVariant g_scaled_variants[SCALED_VARIANTS_COUNT];
+static uint32_t g_scaled_variants_clock = 0;
 
 #ifdef LOG_DEBUG
 #define DEBUG_PRINT(x) printf x
@@ -18,32 +51,102 @@ static SDL_Surface *g_image_cache_next = NULL;
 
 #define MIN(a, b) (a < b) ? (a) : (b)
 
-void drawImage(SDL_Surface *image, SDL_Surface *screen,
-               const SDL_Rect *frame)
+static SDL_Rect getTarget(const SDL_Surface *screen, const SDL_Rect *frame)
 {
-    if (!image)
-        return;
-
-    SDL_Surface *scaled_image = NULL;
     SDL_Rect target = {0, 0, screen->w, screen->h};
 
     if (frame != NULL) {
         target = *frame;
     }
 
-    // scale image to 640x480 only if bigger (v4 752x560)
-    if (image->w > target.w || image->h > target.h) {
-        double ratio_x = (double)target.w / image->w;
-        double ratio_y = (double)target.h / image->h;
-        double scale = MIN(ratio_x, ratio_y);
+    return target;
+}
+
+// Scaled copy of an image bigger than width x height (v4 752x560), NULL if
+// it already fits
+static SDL_Surface *scaleToFit(SDL_Surface *image, int width, int height)
+{
+    if (image->w <= width && image->h <= height)
+        return NULL;
+
+    double ratio_x = (double)width / image->w;
+    double ratio_y = (double)height / image->h;
+    double scale = MIN(ratio_x, ratio_y);
+    SDL_Surface *scaled_image = scaleImageDown(image, scale);
+
+    // ratios the box filter doesn't take
+    if (scaled_image == NULL)
         scaled_image = rotozoomSurface(image, 0.0, scale, true);
 
-        if (scaled_image == NULL) {
-            printf("rotozoomSurface failed: %s\n", SDL_GetError());
-        }
-        else {
-            image = scaled_image;
+    if (scaled_image == NULL) {
+        printf("rotozoomSurface failed: %s\n", SDL_GetError());
+    }
+
+    return scaled_image;
+}
+
+static void freeScaledVariant(ScaledVariant *variant)
+{
+    if (variant->scaled_image != NULL) {
+        SDL_FreeSurface(variant->scaled_image);
+        SDL_FreeSurface(variant->image);
+    }
+    memset(variant, 0, sizeof(ScaledVariant));
+}
+
+// The image scaled to fit width x height, scaled on the first call only.
+// NULL if it already fits
+static SDL_Surface *getScaledVariant(SDL_Surface *image, int width,
+                                     int height)
+{
+    ScaledVariant *variant = &g_scaled_variants[0];
+
+    for (int i = 0; i < SCALED_VARIANTS_COUNT; i++) {
+        ScaledVariant *curr = &g_scaled_variants[i];
+
+        if (curr->scaled_image != NULL && curr->image == image &&
+            curr->width == width && curr->height == height) {
+            curr->last_used = ++g_scaled_variants_clock;
+            return curr->scaled_image;
         }
+
+        if (curr->last_used < variant->last_used)
+            variant = curr;
+    }
+
+    SDL_Surface *scaled_image = scaleToFit(image, width, height);
+
+    if (scaled_image == NULL)
+        return NULL;
+
+    DEBUG_PRINT(("caching %dx%d variant of %dx%d image\n", scaled_image->w,
+                 scaled_image->h, image->w, image->h));
+
+    // The least recently used one goes
+    freeScaledVariant(variant);
+    image->refcount++;
+    variant->image = image;
+    variant->width = width;
+    variant->height = height;
+    variant->scaled_image = scaled_image;
+    variant->last_used = ++g_scaled_variants_clock;
+
+    return scaled_image;
+}
+
+void drawImage(SDL_Surface *image, SDL_Surface *screen,
+               const SDL_Rect *frame)
+{
+    if (!image)
+        return;
+
+    SDL_Rect target = getTarget(screen, frame);
+
+    // scale image to 640x480 only if bigger (v4 752x560), kept for redraws
+    SDL_Surface *scaled_image = getScaledVariant(image, target.w, target.h);
+
+    if (scaled_image != NULL) {
+        image = scaled_image;
     }
 
     SDL_Rect image_pos = {
@@ -51,15 +154,71 @@ void drawImage(SDL_Surface *image, SDL_Surface *screen,
         target.y + (target.h - image->h) / 2};
 
     SDL_BlitSurface(image, NULL, screen, &image_pos);
+}
+
+// Runs on the cache's worker: images are decoded and scaled to the frame
+// once, then drawn as they are
+static SDL_Surface *loadImage(int index, void *userdata)
+{
+    const char *image_path = g_cache_paths[index];
+    DEBUG_PRINT(("loading image '%s' for index #%d\n", image_path, index));
+
+    SDL_Surface *image = NULL;
+
+    if (g_load_scaled_image != NULL &&
+        (image = g_load_scaled_image(image_path, g_cache_width,
+                                     g_cache_height)) != NULL) {
+        return image;
+    }
+
+    image = IMG_Load(image_path);
+
+    if (image == NULL) {
+        printf("failed to load '%s'\n", image_path);
+        return NULL;
+    }
+
+    SDL_Surface *scaled_image =
+        scaleToFit(image, g_cache_width, g_cache_height);
 
     if (scaled_image != NULL) {
-        SDL_FreeSurface(scaled_image);
+        SDL_FreeSurface(image);
+        image = scaled_image;
+
+        if (g_save_scaled_image != NULL)
+            g_save_scaled_image(image_path, image);
     }
+
+    return image;
+}
+
+// (Re)creates the cache for a set of images drawn at a given size
+static bool prepareCache(char **images_paths, const int images_paths_count,
+                         const SDL_Rect *target)
+{
+    if (g_image_cache != NULL && g_cache_paths == images_paths &&
+        g_cache_paths_count == images_paths_count &&
+        g_cache_width == target->w && g_cache_height == target->h) {
+        return true;
+    }
+
+    DEBUG_PRINT(("invalidating cache\n"));
+    cleanImagesCache();
+
+    g_cache_paths = images_paths;
+    g_cache_paths_count = images_paths_count;
+    g_cache_width = target->w;
+    g_cache_height = target->h;
+    g_image_cache = imageCache_create(IMAGES_CACHE_SLOTS, images_paths_count,
+                                      loadImage, NULL);
+
+    return g_image_cache != NULL;
 }
 
 char *drawImageByIndex(const int new_image_index, const int image_index,
                        char **images_paths, const int images_paths_count,
-                       SDL_Surface *screen, SDL_Rect *frame, bool *cache_used)
+                       SDL_Surface *screen, const SDL_Rect *frame,
+                       bool *cache_used)
 {
     DEBUG_PRINT(("image_index: %d, new_image_index: %d\n", image_index,
                  new_image_index));
@@ -71,87 +230,59 @@ char *drawImageByIndex(const int new_image_index, const int image_index,
     }
     char *image_path_to_draw = images_paths[new_image_index];
     DEBUG_PRINT(("image_path_to_draw: %s\n", image_path_to_draw));
-    if (new_image_index == image_index) {
-        if (g_image_cache_current == NULL) {
-            DEBUG_PRINT(("invalidating cache\n"));
-            g_image_cache_prev =
-                new_image_index == 0
-                    ? NULL
-                    : IMG_Load(images_paths[new_image_index - 1]);
-            g_image_cache_current = IMG_Load(images_paths[new_image_index]);
-            g_image_cache_next =
-                new_image_index == images_paths_count - 1
-                    ? NULL
-                    : IMG_Load(images_paths[new_image_index + 1]);
-
-            drawImage(g_image_cache_current, screen, frame);
-
-            *cache_used = false;
-            return image_path_to_draw;
-        }
-    }
-    if (abs(new_image_index - image_index) > 1) {
-        DEBUG_PRINT(("random jump, not implemented yet\n"));
-        return NULL;
-    }
 
-    int move_direction = new_image_index - image_index;
+    SDL_Rect target = getTarget(screen, frame);
 
-    if (move_direction > 0) {
-        DEBUG_PRINT(("moving forward\n"));
-        if (g_image_cache_prev)
-            SDL_FreeSurface(g_image_cache_prev);
-        g_image_cache_prev = g_image_cache_current;
-        g_image_cache_current = g_image_cache_next;
-        if (new_image_index == images_paths_count - 1) {
-            g_image_cache_next = NULL;
-        }
-        else {
-            const int next_image_index = new_image_index + 1;
-            char *image_path_to_load = images_paths[next_image_index];
-            DEBUG_PRINT(("preloading next image '%s' for index #%d\n",
-                         image_path_to_load, next_image_index));
-            g_image_cache_next = IMG_Load(image_path_to_load);
-        }
-        *cache_used = true;
+    if (!prepareCache(images_paths, images_paths_count, &target)) {
+        // no worker, load it here
+        SDL_Surface *image = IMG_Load(image_path_to_draw);
+        drawImage(image, screen, frame);
+        if (image != NULL)
+            SDL_FreeSurface(image);
+        *cache_used = false;
+        return image_path_to_draw;
     }
-    else if (move_direction < 0) {
-        DEBUG_PRINT(("moving backward\n"));
-
-        if (g_image_cache_next)
-            SDL_FreeSurface(g_image_cache_next);
-        g_image_cache_next = g_image_cache_current;
-        g_image_cache_current = g_image_cache_prev;
-        if (new_image_index == 0) {
-            g_image_cache_prev = NULL;
-        }
-        else {
-            const int prev_image_index = new_image_index - 1;
-            char *image_path_to_load = images_paths[prev_image_index];
-            DEBUG_PRINT(("preloading prev image '%s' for index #%d\n",
-                         image_path_to_load, prev_image_index));
-            g_image_cache_prev = IMG_Load(image_path_to_load);
-        }
 
-        *cache_used = true;
-    }
-    else {
-        DEBUG_PRINT(("same slide\n"));
-        *cache_used = true;
+    // Taken before moving the focus, which wakes the worker: cache_used
+    // means the image was already loaded when asked for
+    SDL_Surface *image = imageCache_acquire(g_image_cache, new_image_index);
+    *cache_used = image != NULL;
+
+    // Any index, the cache follows: steps and jumps within the window are
+    // served from it, prefetching moves on in the direction of travel
+    imageCache_focus(g_image_cache, new_image_index);
+
+    if (image == NULL) {
+        DEBUG_PRINT(("waiting for image #%d\n", new_image_index));
+        image = imageCache_acquireWait(g_image_cache, new_image_index);
     }
 
-    drawImage(g_image_cache_current, screen, frame);
+    drawImage(image, screen, frame);
+    imageCache_release(g_image_cache, image);
 
     return image_path_to_draw;
 }
 
+void setScaledImagesStore(ScaledImageLoader load, ScaledImageSaver save)
+{
+    g_load_scaled_image = load;
+    g_save_scaled_image = save;
+}
+
+bool isImageCached(const int image_index)
+{
+    return g_image_cache != NULL &&
+           imageCache_isLoaded(g_image_cache, image_index);
+}
+
 void cleanImagesCache()
 {
     DEBUG_PRINT(("cleaning images cache\n"));
-    if (g_image_cache_prev)
-        SDL_FreeSurface(g_image_cache_prev);
-    if (g_image_cache_current)
-        SDL_FreeSurface(g_image_cache_current);
-    if (g_image_cache_next)
-        SDL_FreeSurface(g_image_cache_next);
-}
\ No newline at end of file
+    imageCache_free(g_image_cache);
+    g_image_cache = NULL;
+    g_cache_paths = NULL;
+    g_cache_paths_count = 0;
+
+    for (int i = 0; i < SCALED_VARIANTS_COUNT; i++)
+        freeScaledVariant(&g_scaled_variants[i]);
+}
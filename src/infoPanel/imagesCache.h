@@ -6,12 +6,21 @@ extern "C" {
 #endif
 
 #include <SDL/SDL.h>
+#include <stdbool.h>
+
+// Scaled copies of the images bigger than the frame they are drawn in
+typedef SDL_Surface *(*ScaledImageLoader)(const char *image_path, int width, int height);
+typedef void (*ScaledImageSaver)(const char *image_path, SDL_Surface *scaled_image);
 
 void drawImage(SDL_Surface *image_to_draw, SDL_Surface *screen, const SDL_Rect *frame);
 char *drawImageByIndex(const int index, const int image_index,
                        char **images_paths, const int images_paths_count,
                        SDL_Surface *screen, const SDL_Rect *frame,
                        bool *cache_used);
+// Keeps the images the cache scales down (to be loaded back instead of
+// scaled again), both are called from the cache's worker thread
+void setScaledImagesStore(ScaledImageLoader load, ScaledImageSaver save);
+bool isImageCached(const int image_index);
 void cleanImagesCache();
 
 #ifdef __cplusplus
@@ -0,0 +1,227 @@
+#include "imagesScale.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Weight of a whole source pixel; a pixel straddling two destination
+// pixels is split between them
+#define WEIGHT_ONE 128
+
+// Each source pixel maps to a destination pixel `index`, giving it `weight`
+// and the rest to the next one
+typedef struct {
+    int index;
+    int weight;
+} ScaleTap;
+
+static ScaleTap *makeTaps(int src_size, int dst_size, uint32_t *totals)
+{
+    ScaleTap *taps = (ScaleTap *)malloc(src_size * sizeof(ScaleTap));
+
+    if (taps == NULL)
+        return NULL;
+
+    memset(totals, 0, (dst_size + 1) * sizeof(uint32_t));
+
+    // In units where a source pixel is dst_size long and a destination
+    // pixel src_size long
+    for (int i = 0; i < src_size; i++) {
+        int start = i * dst_size;
+        int index = start / src_size;
+        int boundary = (index + 1) * src_size;
+        int weight = WEIGHT_ONE;
+
+        if (start + dst_size > boundary)
+            weight = WEIGHT_ONE * (boundary - start) / dst_size;
+
+        taps[i].index = index;
+        taps[i].weight = weight;
+        totals[index] += weight;
+        totals[index + 1] += WEIGHT_ONE - weight;
+    }
+
+    return taps;
+}
+
+// Source as 32bpp, converted the way rotozoomSurface does
+static SDL_Surface *toRGBA(SDL_Surface *image)
+{
+    if (image->format->BitsPerPixel == 32)
+        return image;
+
+    SDL_Surface *converted =
+        SDL_CreateRGBSurface(SDL_SWSURFACE, image->w, image->h, 32,
+                             0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+
+    if (converted != NULL)
+        SDL_BlitSurface(image, NULL, converted, NULL);
+
+    return converted;
+}
+
+// Whole ratios: plain sums over blocks of kx * ky pixels
+static void scaleBlocks(SDL_Surface *src, SDL_Surface *dst, int kx, int ky,
+                        uint32_t *sums)
+{
+    const uint32_t count = kx * ky;
+
+    for (int y = 0; y < dst->h; y++) {
+        memset(sums, 0, dst->w * 4 * sizeof(uint32_t));
+
+        for (int sy = y * ky; sy < (y + 1) * ky; sy++) {
+            const uint8_t *in = (const uint8_t *)src->pixels + sy * src->pitch;
+            uint32_t *sum = sums;
+
+            for (int x = 0; x < dst->w; x++, sum += 4)
+                for (int i = 0; i < kx; i++, in += 4) {
+                    sum[0] += in[0];
+                    sum[1] += in[1];
+                    sum[2] += in[2];
+                    sum[3] += in[3];
+                }
+        }
+
+        uint8_t *out = (uint8_t *)dst->pixels + y * dst->pitch;
+        for (int i = 0; i < dst->w * 4; i++)
+            out[i] = (sums[i] + count / 2) / count;
+    }
+}
+
+// Any ratio >= 1: every source pixel is read once and added to the (up to
+// 2x2) destination pixels it overlaps, rows are written out once complete
+static void scaleBox(SDL_Surface *src, SDL_Surface *dst, const ScaleTap *taps_x,
+                     const uint32_t *totals_x, const ScaleTap *taps_y,
+                     const uint32_t *totals_y, uint32_t *row, uint32_t *acc,
+                     uint32_t *acc_next)
+{
+    const int row_size = (dst->w + 1) * 4;
+
+    memset(acc, 0, row_size * sizeof(uint32_t));
+    memset(acc_next, 0, row_size * sizeof(uint32_t));
+
+    for (int sy = 0; sy < src->h; sy++) {
+        const uint8_t *in = (const uint8_t *)src->pixels + sy * src->pitch;
+
+        memset(row, 0, row_size * sizeof(uint32_t));
+
+        for (int sx = 0; sx < src->w; sx++, in += 4) {
+            uint32_t *out = row + taps_x[sx].index * 4;
+            uint32_t weight = taps_x[sx].weight;
+
+            if (weight == WEIGHT_ONE) {
+                out[0] += in[0] * WEIGHT_ONE;
+                out[1] += in[1] * WEIGHT_ONE;
+                out[2] += in[2] * WEIGHT_ONE;
+                out[3] += in[3] * WEIGHT_ONE;
+            }
+            else {
+                uint32_t rest = WEIGHT_ONE - weight;
+                out[0] += in[0] * weight;
+                out[1] += in[1] * weight;
+                out[2] += in[2] * weight;
+                out[3] += in[3] * weight;
+                out[4] += in[0] * rest;
+                out[5] += in[1] * rest;
+                out[6] += in[2] * rest;
+                out[7] += in[3] * rest;
+            }
+        }
+
+        int y = taps_y[sy].index;
+        uint32_t weight = taps_y[sy].weight;
+
+        for (int i = 0; i < dst->w * 4; i++)
+            acc[i] += row[i] * weight;
+
+        if (weight < WEIGHT_ONE) {
+            uint32_t rest = WEIGHT_ONE - weight;
+            for (int i = 0; i < dst->w * 4; i++)
+                acc_next[i] += row[i] * rest;
+        }
+
+        if (sy + 1 < src->h && taps_y[sy + 1].index == y)
+            continue;
+
+        if (y < dst->h) {
+            uint8_t *out = (uint8_t *)dst->pixels + y * dst->pitch;
+            for (int x = 0; x < dst->w; x++) {
+                uint32_t total = totals_x[x] * totals_y[y];
+                for (int c = 0; c < 4; c++)
+                    out[x * 4 + c] = (acc[x * 4 + c] + total / 2) / total;
+            }
+        }
+
+        uint32_t *done = acc;
+        acc = acc_next;
+        acc_next = done;
+        memset(acc_next, 0, row_size * sizeof(uint32_t));
+    }
+}
+
+SDL_Surface *scaleImageDown(SDL_Surface *image, double scale)
+{
+    int width = (int)((double)image->w * scale);
+    int height = (int)((double)image->h * scale);
+
+    if (width < 1)
+        width = 1;
+    if (height < 1)
+        height = 1;
+
+    // Ratios the sums can't hold, or not a downscale
+    if (width > image->w || height > image->h ||
+        image->w > width * SCALE_MAX_RATIO ||
+        image->h > height * SCALE_MAX_RATIO)
+        return NULL;
+
+    SDL_Surface *src = toRGBA(image);
+
+    if (src == NULL)
+        return NULL;
+
+    SDL_Surface *dst = SDL_CreateRGBSurface(
+        SDL_SWSURFACE, width, height, 32, src->format->Rmask,
+        src->format->Gmask, src->format->Bmask, src->format->Amask);
+
+    uint32_t *buffers = (uint32_t *)malloc((width + 1) * 4 * 3 * sizeof(uint32_t));
+    uint32_t *totals = (uint32_t *)malloc((width + height + 2) * sizeof(uint32_t));
+    ScaleTap *taps_x = NULL, *taps_y = NULL;
+    bool ok = dst != NULL && buffers != NULL && totals != NULL;
+
+    if (ok && image->w % width == 0 && image->h % height == 0) {
+        SDL_LockSurface(src);
+        scaleBlocks(src, dst, image->w / width, image->h / height, buffers);
+        SDL_UnlockSurface(src);
+    }
+    else if (ok) {
+        uint32_t *totals_x = totals, *totals_y = totals + width + 1;
+        taps_x = makeTaps(image->w, width, totals_x);
+        taps_y = makeTaps(image->h, height, totals_y);
+        ok = taps_x != NULL && taps_y != NULL;
+
+        if (ok) {
+            uint32_t *row = buffers, *acc = buffers + (width + 1) * 4,
+                     *acc_next = buffers + (width + 1) * 8;
+            SDL_LockSurface(src);
+            scaleBox(src, dst, taps_x, totals_x, taps_y, totals_y, row, acc,
+                     acc_next);
+            SDL_UnlockSurface(src);
+        }
+    }
+
+    free(taps_x);
+    free(taps_y);
+    free(totals);
+    free(buffers);
+
+    if (src != image)
+        SDL_FreeSurface(src);
+
+    if (!ok && dst != NULL) {
+        SDL_FreeSurface(dst);
+        dst = NULL;
+    }
+
+    return dst;
+}
@@ -0,0 +1,29 @@
+#ifndef IMAGES_SCALE_H__
+#define IMAGES_SCALE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL/SDL.h>
+#include <stdbool.h>
+
+// Largest downscale ratio the filter's sums hold
+#define SCALE_MAX_RATIO 16
+
+/**
+ * @brief Scales an image down by `scale` (<= 1) with a box filter: every
+ * output pixel is the average of the source area it covers. Output sizes
+ * are the ones rotozoomSurface gives, whole ratios (2:1, 3:1...) take a
+ * faster path.
+ *
+ * @return SDL_Surface* New 32bpp surface, NULL if `scale` isn't a supported
+ * downscale (or out of memory)
+ */
+SDL_Surface *scaleImageDown(SDL_Surface *image, double scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMAGES_SCALE_H__
@@ -14,6 +14,7 @@
 #include "utils/file.h"
 #include "utils/json.h"
 #include "utils/msleep.h"
+#include "utils/rawImage.h"
 #include "utils/sdl_init.h"
 #include "utils/str.h"
 
@@ -109,6 +110,53 @@ static void sdlQuit(SDL_Surface *screen, SDL_Surface *video)
     SDL_Quit();
 }
 
+/**
+ * @brief Loads back an image scaled down by a previous run (its raw cache,
+ * see saveScaledImage), if it was scaled for a `width` x `height` frame.
+ */
+static SDL_Surface *loadScaledImage(const char *image_path, int width, int height)
+{
+    RawImage raw;
+
+    if (!raw_image_map(image_path, &raw))
+        return NULL;
+
+    const RawImageHeader *h = raw.header;
+    SDL_Surface *image = NULL;
+
+    // Scaled to fit: it fills one of the dimensions
+    if (h->bpp == 32 && (int)h->width <= width && (int)h->height <= height &&
+        ((int)h->width == width || (int)h->height == height)) {
+        image = SDL_CreateRGBSurface(SDL_SWSURFACE, h->width, h->height, 32, h->rmask, h->gmask, h->bmask, h->amask);
+        for (uint32_t y = 0; image != NULL && y < h->height; y++)
+            memcpy((uint8_t *)image->pixels + y * image->pitch, (uint8_t *)raw.pixels + y * h->pitch, h->width * 4);
+    }
+
+    raw_image_unmap(&raw);
+    return image;
+}
+
+/**
+ * @brief Keeps a scaled down image next to its source, as an LZ4 raw cache.
+ */
+static void saveScaledImage(const char *image_path, SDL_Surface *image)
+{
+    SDL_PixelFormat *fmt = image->format;
+    RawImageHeader header = {
+        .bpp = fmt->BitsPerPixel,
+        .width = image->w,
+        .height = image->h,
+        .pitch = image->pitch,
+        .rmask = fmt->Rmask,
+        .gmask = fmt->Gmask,
+        .bmask = fmt->Bmask,
+        .amask = fmt->Amask,
+        .compression = RAW_IMAGE_LZ4};
+
+    if (!raw_image_write(image_path, header, image->pixels))
+        print_debug("Scaled image not saved (read-only?)");
+}
+
 const SDL_Rect *getControlsAwareFrame(const SDL_Rect *frame)
 {
     if (g_show_theme_controls) {
@@ -157,6 +205,8 @@ int main(int argc, char *argv[])
                 wait_confirm = false;
             else if (strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--no-footer") == 0)
                 no_footer = true;
+            else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--cache-scaled") == 0)
+                setScaledImagesStore(loadScaledImage, saveScaledImage);
             else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--persistent") == 0) {
                 wait_confirm = false;
                 is_persistent = true;
@@ -421,6 +471,9 @@ int main(int argc, char *argv[])
             break;
     }
 
+    // Its worker may be loading one of the paths
+    cleanImagesCache();
+
     if (g_images_paths != NULL) {
         for (int i = 0; i < g_images_paths_count; i++)
             free(g_images_paths[i]);
@@ -441,8 +494,6 @@ int main(int argc, char *argv[])
     else if (!wait_confirm)
         msleep(2000);
 
-    cleanImagesCache();
-
     if (static_image != NULL) {
         SDL_FreeSurface(static_image);
     }
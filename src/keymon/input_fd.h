@@ -6,6 +6,7 @@
 #include <sys/ioctl.h>
 #include <sys/poll.h>
 
+#include "system/keyinject.h"
 #include "utils/msleep.h"
 
 // for ev.value
@@ -28,7 +29,7 @@
 // Global Variables
 static int input_fd;
 static struct input_event ev;
-static struct pollfd fds[1];
+static struct pollfd fds[2]; // input device, keymon's file watcher
 static bool keyinput_disabled = false;
 static int ignore_queue[QUEUE_MAX][2];
 static int ignore_queue_count = 0;
@@ -75,11 +76,9 @@ void keyinput_send(unsigned short code, signed int value)
 {
     if (keyinput_disabled)
         return;
-    char cmd[100];
-    sprintf(cmd, "sendkeys %d %d", code, value);
     printf_debug("Send keys: code=%d, value=%d\n", code, value);
     _ignoreQueue_add(code, value);
-    system(cmd);
+    keyinject_send(code, value);
     print_debug("Keys sent");
 }
 
@@ -87,18 +86,12 @@ void keyinput_sendMulti(int n, int code_value_pairs[n][2])
 {
     if (keyinput_disabled)
         return;
-    char cmd[512];
-    strcpy(cmd, "./bin/sendkeys ");
-
-    for (int i = 0; i < n; i++) {
-        int code = code_value_pairs[i][0];
-        int value = code_value_pairs[i][1];
-        _ignoreQueue_add(code, value);
-        sprintf(cmd + strlen(cmd), "%d %d ", code, value);
-    }
 
-    printf_debug("Send keys: %s\n", cmd);
-    system(cmd);
+    for (int i = 0; i < n; i++)
+        _ignoreQueue_add(code_value_pairs[i][0], code_value_pairs[i][1]);
+
+    printf_debug("Send keys: %d events\n", n);
+    keyinject_sendMulti(n, code_value_pairs);
     print_debug("Keys sent");
 }
 
@@ -29,11 +29,15 @@
 #include "utils/log.h"
 #include "utils/process.h"
 #include "utils/str.h"
+#include "utils/watcher.h"
 
 #include "./input_fd.h"
 #include "./menuButtonAction.h"
 
 #define FAVORITES_PATH "/mnt/SDCARD/Roms/favourite.json"
+#define SETTINGS_CHANGED_PATH "/tmp/settings_changed"
+#define STATE_CHANGED_PATH "/tmp/state_changed"
+#define BLUE_LIGHT_SCRIPT "/mnt/SDCARD/.tmp_update/script/blue_light.sh"
 
 // for proc_stat flags
 #define PF_KTHREAD 0x00200000
@@ -46,6 +50,11 @@
 
 uint32_t suspendpid[PIDMAX];
 
+static Watcher watcher = {.fd = -1};
+static bool state_changed = false; // mirrors STATE_CHANGED_PATH
+static time_t fav_last_modified;
+static bool fav_watched = false;
+
 const int KONAMI_CODE[] = {HW_BTN_UP, HW_BTN_UP, HW_BTN_DOWN, HW_BTN_DOWN,
                            HW_BTN_LEFT, HW_BTN_RIGHT, HW_BTN_LEFT, HW_BTN_RIGHT,
                            HW_BTN_B, HW_BTN_A};
@@ -135,6 +144,9 @@ int suspend(uint32_t mode)
     }
     closedir(procdp);
 
+    if (mode && ret)
+        process_snapshot_invalidate();
+
     // reset display when anything killed
     if (mode == 2 && ret)
         display_reset();
@@ -160,9 +172,13 @@ void resume(void)
 //
 void quit(int exitcode)
 {
+    screenshot_flush();
     display_free();
     if (input_fd > 0)
         close(input_fd);
+    process_events_stop();
+    watcher_close(&watcher);
+    keyinject_close();
     system_clock_get();
     system_rtc_set();
     system_clock_save();
@@ -172,7 +188,7 @@ void quit(int exitcode)
 //
 //    Shutdown
 //
-void shutdown(void)
+void powerOff(void)
 {
     set_system_shutdown();
     screenshot_system();
@@ -180,6 +196,7 @@ void shutdown(void)
     terminate_drastic();
     system_clock_get();
     system_clock_save();
+    screenshot_flush();
     sync();
     system("shutdown");
     while (1)
@@ -202,6 +219,7 @@ void deepsleep(void)
         short_pulse();
         set_system_shutdown();
         kill(system_state_pid, SIGTERM);
+        process_snapshot_invalidate();
     }
     else if (system_state == MODE_GAME) {
         if (check_autosave()) {
@@ -215,6 +233,7 @@ void deepsleep(void)
         short_pulse();
         set_system_shutdown();
         kill(system_state_pid, SIGQUIT);
+        process_snapshot_invalidate();
     }
     else if (system_state == MODE_APPS) {
         short_pulse();
@@ -232,7 +251,7 @@ void deepsleep(void)
     sleep(10);
     // catch the resolution change signal on MMV4
     sleep(20);
-    shutdown();
+    powerOff();
 }
 
 //
@@ -323,6 +342,62 @@ void turnOffScreen(void)
     suspend_exec(stay_awake ? -1 : timeout);
 }
 
+//
+//    File watches
+//
+void onSettingsChanged(const char *path, WatchEvent event, void *userdata)
+{
+    if (event != WATCH_CHANGED)
+        return;
+    settings_load();
+    remove(SETTINGS_CHANGED_PATH);
+    sync();
+}
+
+void onStateChanged(const char *path, WatchEvent event, void *userdata)
+{
+    state_changed = event == WATCH_CHANGED;
+    if (!state_changed)
+        return;
+
+    system_state_update();
+    if (system_state == MODE_MAIN_UI)
+        display_setBrightness(settings.brightness);
+}
+
+void onFavoritesChanged(const char *path, WatchEvent event, void *userdata)
+{
+    if (event != WATCH_CHANGED || system_state != MODE_MAIN_UI)
+        return;
+
+    if (file_isModified(FAVORITES_PATH, &fav_last_modified)) {
+        system("tools favfix");
+        sync();
+        // Don't react to favfix's own write
+        file_isModified(FAVORITES_PATH, &fav_last_modified);
+    }
+}
+
+/**
+ * @brief Blue light schedule changed: let the script decide whether the
+ * filter has to be switched now.
+ */
+void onBlueLightChanged(const char *path, WatchEvent event, void *userdata)
+{
+    system(BLUE_LIGHT_SCRIPT " check &");
+}
+
+/**
+ * @brief Without inotify, the flag files are checked on each input event
+ * (and favorites when B/X is released).
+ */
+void pollWatchedFiles(void)
+{
+    if (exists(SETTINGS_CHANGED_PATH))
+        onSettingsChanged(SETTINGS_CHANGED_PATH, WATCH_CHANGED, NULL);
+    state_changed = exists(STATE_CHANGED_PATH);
+}
+
 //
 //    Main
 //
@@ -351,12 +426,34 @@ int main(void)
 
     display_init();
 
+    // Capture buffers and PNG encoder thread for screenshots
+    screenshot_init();
+
+    // Refresh the process table snapshot on process events instead of a TTL
+    process_events_start();
+
     // Prepare for Poll button input
     input_fd = open("/dev/input/event0", O_RDONLY);
     memset(&fds, 0, sizeof(fds));
     fds[0].fd = input_fd;
     fds[0].events = POLLIN;
 
+    // React to the settings/state flags and favorites when they change
+    fav_last_modified = time(NULL);
+    state_changed = exists(STATE_CHANGED_PATH);
+    if (watcher_init(&watcher)) {
+        watcher_add(&watcher, SETTINGS_CHANGED_PATH, onSettingsChanged, NULL);
+        watcher_add(&watcher, STATE_CHANGED_PATH, onStateChanged, NULL);
+        fav_watched = watcher_add(&watcher, FAVORITES_PATH, onFavoritesChanged, NULL);
+        if (DEVICE_ID == MIYOO354) {
+            watcher_add(&watcher, "/mnt/SDCARD/.tmp_update/config/.blf", onBlueLightChanged, NULL);
+            watcher_add(&watcher, "/mnt/SDCARD/.tmp_update/config/display/blueLightTime", onBlueLightChanged, NULL);
+            watcher_add(&watcher, "/mnt/SDCARD/.tmp_update/config/display/blueLightTimeOff", onBlueLightChanged, NULL);
+        }
+    }
+    fds[1].fd = watcher.fd;
+    fds[1].events = POLLIN;
+
     // Main Loop
     uint32_t button_flag = 0;
     uint32_t repeat_LR = 0;
@@ -386,10 +483,13 @@ int main(void)
     bool delete_flag = false;
     bool settings_changed = false;
 
-    time_t fav_last_modified = time(NULL);
-
     while (1) {
-        if (poll(fds, 1, (CHECK_SEC - elapsed_sec) * 1000) > 0) {
+        int ready = poll(fds, 2, (CHECK_SEC - elapsed_sec) * 1000);
+
+        if (ready > 0 && (fds[1].revents & POLLIN))
+            watcher_dispatch(&watcher);
+
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
             if (!keyinput_isValid())
                 continue;
             val = ev.value;
@@ -397,18 +497,17 @@ int main(void)
             printf_debug("Keymon input: code=%d, value=%d\n", ev.code,
                          ev.value);
 
-            if (exists("/tmp/settings_changed")) {
-                settings_load();
-                remove("/tmp/settings_changed");
-                sync();
-            }
+            if (watcher.fd == -1)
+                pollWatchedFiles();
 
-            if (exists("/tmp/state_changed")) {
+            // The state may settle after the flag was set, keep updating
+            if (state_changed) {
                 system_state_update();
 
                 if (delete_flag) {
                     system_state_update();
-                    remove("/tmp/state_changed");
+                    remove(STATE_CHANGED_PATH);
+                    state_changed = false;
                     sync();
                     delete_flag = false;
                 }
@@ -431,13 +530,8 @@ int main(void)
                     comboKey_menu = true;
             }
 
-            if (system_state == MODE_MAIN_UI && (ev.code == HW_BTN_B || ev.code == HW_BTN_X) && val == RELEASED) {
-                // Check if favorite file changed
-                if (file_isModified(FAVORITES_PATH, &fav_last_modified)) {
-                    system("tools favfix");
-                    sync();
-                }
-            }
+            if (!fav_watched && (ev.code == HW_BTN_B || ev.code == HW_BTN_X) && val == RELEASED)
+                onFavoritesChanged(FAVORITES_PATH, WATCH_CHANGED, NULL);
 
             switch (ev.code) {
             case HW_BTN_POWER:
@@ -451,7 +545,7 @@ int main(void)
                     else if (repeat_power >= REPEAT_SEC(5)) {
                         short_pulse();
                         remove(CMD_TO_RUN_PATH);
-                        shutdown(); // 10sec force shutdown
+                        powerOff(); // 10sec force shutdown
                     }
                     break;
                 }
@@ -709,11 +803,11 @@ int main(void)
             // toggle blue light filter
             if (menuAndBPressed && (getMilliseconds() - menuAndBPressedTime >= 2000)) {
                 if (access("/tmp/.blfOn", F_OK) != -1) {
-                    system("/mnt/SDCARD/.tmp_update/script/blue_light.sh disable &");
+                    system(BLUE_LIGHT_SCRIPT " disable &");
                     system("touch /tmp/.blfIgnoreSchedule");
                 }
                 else {
-                    system("/mnt/SDCARD/.tmp_update/script/blue_light.sh enable &");
+                    system(BLUE_LIGHT_SCRIPT " enable &");
                     system("touch /tmp/.blfIgnoreSchedule");
                 }
 
@@ -767,16 +861,20 @@ int main(void)
             }
 
             hibernate_start = getMilliseconds();
-            elapsed_sec = (hibernate_start - ticks) / 1000;
+        }
+
+        if (ready > 0) {
+            elapsed_sec = (getMilliseconds() - ticks) / 1000;
             if (elapsed_sec < CHECK_SEC)
                 continue;
         }
 
         // Comes here every CHECK_SEC(def:15) seconds interval
         if (delete_flag) {
-            if (exists("/tmp/state_changed")) {
+            if (state_changed) {
                 system_state_update();
-                remove("/tmp/state_changed");
+                remove(STATE_CHANGED_PATH);
+                state_changed = false;
                 sync();
             }
             delete_flag = false;
@@ -803,12 +901,12 @@ int main(void)
 
         // Check bluelight filter
         if (DEVICE_ID == MIYOO354) {
-            system("/mnt/SDCARD/.tmp_update/script/blue_light.sh check");
+            system(BLUE_LIGHT_SCRIPT " check");
         }
 
         // Quit RetroArch / auto-save when battery too low
         if (settings.low_battery_autosave_at && battery_getPercentage() <= settings.low_battery_autosave_at && check_autosave()) {
-            temp_flag_set(".lowBat", true);
+            shared_state_setFlag(SHARED_FLAG_LOW_BATTERY, true);
             screenshot_system();
             terminate_retroarch();
             terminate_drastic();
@@ -89,6 +89,7 @@ bool terminate_retroarch(void)
         uint32_t count = 20; // 4s
         while (--count && exists(fname))
             usleep(200000); // 0.2s
+        process_snapshot_invalidate();
         return true;
     }
     return false;
@@ -103,15 +104,16 @@ bool terminate_drastic(void)
     char fname[20];
 
     if (pid) {
-        system("sendkeys 1 1, 18 1");
+        keyinject_sendMulti(2, (int[][2]){{1, 1}, {18, 1}});
         usleep(200000); // 0.2s
-        system("sendkeys 1 0, 18 0");
+        keyinject_sendMulti(2, (int[][2]){{1, 0}, {18, 0}});
 
         sprintf(fname, "/proc/%d", pid);
         uint32_t count = 150; // 30s
 
         while (--count && exists(fname))
             usleep(200000); // 0.2s
+        process_snapshot_invalidate();
         return true;
     }
     return false;
@@ -55,19 +55,36 @@ void drawBatteryPercentage(void)
 
     printf_debug("theme_path: %s\n", theme_path);
 
-    char icon_path[STR_MAX + 20];
+    char icon_path[STR_MAX + 20], key_path[STR_MAX + 20];
     snprintf(icon_path, STR_MAX + 19, "%sskin/.batt-perc.png", theme_path);
+    snprintf(key_path, STR_MAX + 19, "%sskin/.batt-perc.key", theme_path);
 
     printf_debug("icon_path: %s\n", icon_path);
 
+    int percentage = battery_getPercentage();
+
+    // The saved icon was built from the same theme, style and percentage
+    char key[STR_MAX * 4];
+    const char *saved_key = NULL;
+    theme_batteryCacheKey(key, sizeof(key), percentage);
+    if (percentage != 500 && is_file(icon_path) && (saved_key = file_read(key_path)) != NULL &&
+        strcmp(saved_key, key) == 0) {
+        print_debug("battery icon is up to date");
+        free((void *)saved_key);
+        resources_free();
+        return;
+    }
+    free((void *)saved_key);
+
     TTF_Init();
 
-    int percentage = battery_getPercentage();
     SDL_Surface *image = theme_batterySurfaceWithBg(percentage, theme_background());
 
     // Save custom battery icon
-    if (image != NULL && percentage != 500)
+    if (image != NULL && percentage != 500) {
         IMG_Save(image, icon_path);
+        file_write(key_path, key, strlen(key));
+    }
 
     SDL_FreeSurface(image);
     resources_free();
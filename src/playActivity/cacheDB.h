@@ -96,58 +96,380 @@ int cache_get_path(char *cache_path_out, char *cache_name_out, const char *rom_p
     return cache_version;
 }
 
-CacheDBItem *cache_db_find(const char *path_or_name)
+#define CACHE_DB_INDEX_FILE "/mnt/SDCARD/Saves/CurrentProfile/play_activity/cache_index.sqlite"
+#define CACHE_DB_LOCATIONS_MAX 16
+#define CACHE_DB_POOL_SIZE 4
+
+// Strips everything up to and including the first "/Roms/" (absolute,
+// "../../Roms/" or MainUI's "/mnt/SDCARD/Emu/<EMU>/../../Roms/")
+#define CACHE_DB_REL_PATH_SQL(col)                                                                               \
+    "CASE WHEN instr(" col ", '/Roms/') > 0 THEN substr(" col ", instr(" col ", '/Roms/') + 6) ELSE " col " END"
+
+typedef struct {
+    char dir[PATH_MAX];
+    char cache_path[STR_MAX];
+    char cache_name[STR_MAX];
+    int version;
+    bool index_checked;
+    bool index_synced;
+} CacheDBLocation;
+
+typedef struct {
+    char cache_path[STR_MAX];
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    unsigned int last_used;
+} CacheDBHandle;
+
+static CacheDBLocation __cache_locations[CACHE_DB_LOCATIONS_MAX];
+static int __cache_locations_len = 0;
+static int __cache_locations_next = 0;
+
+// Result of the last lookup without a cache, not remembered
+static CacheDBLocation __cache_location_missing;
+
+static CacheDBHandle __cache_pool[CACHE_DB_POOL_SIZE];
+static unsigned int __cache_pool_clock = 0;
+
+static sqlite3 *__cache_index_db = NULL;
+static sqlite3_stmt *__cache_index_lookup = NULL;
+static bool __cache_index_writable = false;
+static bool __cache_index_failed = false;
+
+CacheDBLocation *__cache_locate(const char *rom_path)
 {
-    printf_debug("cache_db_find('%s')\n", path_or_name);
+    char dir[PATH_MAX];
+    strncpy(dir, rom_path, PATH_MAX - 1);
+    dir[PATH_MAX - 1] = '\0';
+    char *slash = strrchr(dir, '/');
+    if (slash != NULL)
+        *slash = '\0';
 
-    CacheDBItem *cache_db_item = NULL;
-    char cache_db_file_path[STR_MAX];
-    char cache_type[STR_MAX];
+    for (int i = 0; i < __cache_locations_len; i++) {
+        CacheDBLocation *location = &__cache_locations[i];
+        if (strcmp(location->dir, dir) == 0) {
+            return location;
+        }
+    }
 
-    char rel_path[PATH_MAX];
-    if (!file_path_relative_to(rel_path, "/mnt/SDCARD/Roms", path_or_name)) {
-        if (strstr(path_or_name, "../../Roms/") != NULL) {
-            strcpy(rel_path, str_split(strdup((const char *)path_or_name), "../../Roms/"));
+    CacheDBLocation *location = &__cache_location_missing;
+    strcpy(location->dir, dir);
+    location->cache_name[0] = '\0';
+    location->version = cache_get_path(location->cache_path, location->cache_name, rom_path);
+    location->index_checked = false;
+    location->index_synced = false;
+
+    // Only found caches are remembered, MainUI may create one later
+    if (location->version == CACHE_NOT_FOUND)
+        return location;
+
+    if (__cache_locations_len < CACHE_DB_LOCATIONS_MAX) {
+        location = &__cache_locations[__cache_locations_len++];
+    }
+    else {
+        location = &__cache_locations[__cache_locations_next];
+        __cache_locations_next = (__cache_locations_next + 1) % CACHE_DB_LOCATIONS_MAX;
+    }
+    *location = __cache_location_missing;
+
+    return location;
+}
+
+/**
+ * @brief Same as cache_get_path(), but remembers the cache found for each
+ * rom directory, so its parent directories are only probed once.
+ */
+int cache_resolve(char *cache_path_out, char *cache_name_out, const char *rom_path)
+{
+    CacheDBLocation *location = __cache_locate(rom_path);
+    strcpy(cache_path_out, location->cache_path);
+    strcpy(cache_name_out, location->cache_name);
+    return location->version;
+}
+
+/**
+ * @brief Returns a pooled read-only handle for a MainUI cache, with its
+ * exact-match lookup statement prepared. The least recently used handle
+ * is recycled when the pool is full.
+ */
+CacheDBHandle *cache_db_pool_get(const char *cache_db_file_path, const char *cache_type, int cache_version)
+{
+    CacheDBHandle *handle = NULL;
+
+    for (int i = 0; i < CACHE_DB_POOL_SIZE; i++) {
+        if (__cache_pool[i].db != NULL && strcmp(__cache_pool[i].cache_path, cache_db_file_path) == 0) {
+            handle = &__cache_pool[i];
+            handle->last_used = ++__cache_pool_clock;
+            sqlite3_reset(handle->stmt);
+            sqlite3_clear_bindings(handle->stmt);
+            return handle;
         }
-        else {
-            strcpy(rel_path, str_replace(strdup((const char *)path_or_name), "/mnt/SDCARD/Roms/", ""));
+        if (handle == NULL || __cache_pool[i].db == NULL ||
+            (handle->db != NULL && __cache_pool[i].last_used < handle->last_used)) {
+            handle = &__cache_pool[i];
         }
     }
 
-    char *sql;
-    int cache_version = cache_get_path(cache_db_file_path, cache_type, path_or_name);
+    if (handle->db != NULL) {
+        sqlite3_finalize(handle->stmt);
+        sqlite3_close(handle->db);
+        handle->db = NULL;
+        handle->stmt = NULL;
+    }
+
+    if (sqlite3_open_v2(cache_db_file_path, &handle->db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+        sqlite3_close(handle->db);
+        handle->db = NULL;
+        return NULL;
+    }
+
+    // Stored paths are compared by their part after "/Roms/", whatever the prefix
+    char *sql = sqlite3_mprintf("SELECT %s, path, imgpath FROM \"%w_roms\" WHERE " CACHE_DB_REL_PATH_SQL("path") " = ?1 COLLATE NOCASE "
+                                "UNION ALL SELECT * FROM (SELECT %s, path, imgpath FROM \"%w_roms\" WHERE disp = ?2 COLLATE NOCASE LIMIT 1) LIMIT 1;",
+                                cache_version == 6 ? "pinyin" : "disp", cache_type,
+                                cache_version == 6 ? "pinyin" : "disp", cache_type);
+    int rc = sqlite3_prepare_v2(handle->db, sql, -1, &handle->stmt, NULL);
+    sqlite3_free(sql);
+
+    if (rc != SQLITE_OK) {
+        printf_debug("%s\n", sqlite3_errmsg(handle->db));
+        sqlite3_close(handle->db);
+        handle->db = NULL;
+        return NULL;
+    }
+
+    snprintf(handle->cache_path, STR_MAX, "%s", cache_db_file_path);
+    handle->last_used = ++__cache_pool_clock;
+
+    return handle;
+}
+
+void __cache_index_close(void)
+{
+    sqlite3_finalize(__cache_index_lookup);
+    __cache_index_lookup = NULL;
+    sqlite3_close(__cache_index_db);
+    __cache_index_db = NULL;
+    __cache_index_writable = false;
+}
 
-    char *game_name = file_removeExtension(basename(strdup(path_or_name)));
+/**
+ * @brief Opens the sidecar index. Lookups open an existing index read-only,
+ * only cache_db_index_build() creates or writes it.
+ */
+bool __cache_index_open(bool writable)
+{
+    if (__cache_index_db != NULL && (__cache_index_writable || !writable))
+        return true;
+    if (__cache_index_failed && !writable)
+        return false;
 
-    if (cache_version == 2) {
-        sql = sqlite3_mprintf("SELECT disp, path, imgpath FROM %q_roms WHERE path LIKE '%%%q' OR disp = %Q LIMIT 1;", cache_type, rel_path, game_name);
+    __cache_index_close();
+
+    if (!writable && !is_file(CACHE_DB_INDEX_FILE)) {
+        __cache_index_failed = true;
+        return false;
     }
-    else if (cache_version == 6) {
-        sql = sqlite3_mprintf("SELECT pinyin, path, imgpath FROM %q_roms WHERE path LIKE '%%%q' OR disp = %Q LIMIT 1;", cache_type, rel_path, game_name);
+
+    int flags = writable ? SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE : SQLITE_OPEN_READONLY;
+    if (sqlite3_open_v2(CACHE_DB_INDEX_FILE, &__cache_index_db, flags, NULL) != SQLITE_OK ||
+        (writable && sqlite3_exec(__cache_index_db,
+                                  "CREATE TABLE IF NOT EXISTS cache_source(cache_path TEXT PRIMARY KEY, mtime INTEGER, size INTEGER);"
+                                  "CREATE TABLE IF NOT EXISTS cache_index(cache_path TEXT, rel_path TEXT COLLATE NOCASE, name TEXT, disp TEXT COLLATE NOCASE, "
+                                  "path TEXT, imgpath TEXT, PRIMARY KEY(cache_path, rel_path)) WITHOUT ROWID;"
+                                  "CREATE INDEX IF NOT EXISTS cache_index_disp_index ON cache_index(cache_path, disp);",
+                                  NULL, NULL, NULL) != SQLITE_OK)) {
+        printf_debug("Cache index unavailable: %s\n", sqlite3_errmsg(__cache_index_db));
+        __cache_index_close();
+        __cache_index_failed = true;
+        return false;
     }
-    else {
+
+    __cache_index_writable = writable;
+    __cache_index_failed = false;
+    return true;
+}
+
+/**
+ * @brief Checks that the sidecar index holds the current content of a
+ * MainUI cache (same mtime and size). When `build` is set, a stale or
+ * missing copy is rebuilt, keyed by normalized relative path.
+ */
+bool __cache_index_sync(const char *cache_db_file_path, const char *cache_type, int cache_version, bool build)
+{
+    struct stat st;
+    if (stat(cache_db_file_path, &st) != 0)
+        return false;
+
+    sqlite3_stmt *stmt = NULL;
+    bool up_to_date = false;
+    if (sqlite3_prepare_v2(__cache_index_db, "SELECT mtime = ?2 AND size = ?3 FROM cache_source WHERE cache_path = ?1;", -1, &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, cache_db_file_path, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, (sqlite3_int64)st.st_mtime);
+        sqlite3_bind_int64(stmt, 3, (sqlite3_int64)st.st_size);
+        up_to_date = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    if (up_to_date || !build)
+        return up_to_date;
+
+    printf_debug("Indexing cache: %s\n", cache_db_file_path);
+
+    char *sql = sqlite3_mprintf(
+        "ATTACH DATABASE %Q AS src;"
+        "BEGIN;"
+        "DELETE FROM cache_index WHERE cache_path = %Q;"
+        "INSERT OR IGNORE INTO cache_index(cache_path, rel_path, name, disp, path, imgpath) "
+        "SELECT %Q, " CACHE_DB_REL_PATH_SQL("path") ", %s, disp, path, imgpath FROM src.\"%w_roms\";"
+        "INSERT OR REPLACE INTO cache_source(cache_path, mtime, size) VALUES(%Q, %lld, %lld);"
+        "COMMIT;",
+        cache_db_file_path, cache_db_file_path, cache_db_file_path,
+        cache_version == 6 ? "pinyin" : "disp", cache_type,
+        cache_db_file_path, (long long)st.st_mtime, (long long)st.st_size);
+    int rc = sqlite3_exec(__cache_index_db, sql, NULL, NULL, NULL);
+    sqlite3_free(sql);
+
+    if (rc != SQLITE_OK) {
+        printf_debug("%s\n", sqlite3_errmsg(__cache_index_db));
+        sqlite3_exec(__cache_index_db, "ROLLBACK;", NULL, NULL, NULL);
+    }
+    sqlite3_exec(__cache_index_db, "DETACH DATABASE src;", NULL, NULL, NULL);
+
+    return rc == SQLITE_OK;
+}
+
+void __cache_column_copy(char *dest, size_t size, sqlite3_stmt *stmt, int column)
+{
+    const char *text = (const char *)sqlite3_column_text(stmt, column);
+    snprintf(dest, size, "%s", text != NULL ? text : "");
+}
+
+CacheDBItem *__cache_item_from_row(sqlite3_stmt *stmt, const char *cache_db_file_path)
+{
+    CacheDBItem *cache_db_item = (CacheDBItem *)malloc(sizeof(CacheDBItem));
+    snprintf(cache_db_item->cache_path, PATH_MAX, "%s", cache_db_file_path);
+    __cache_column_copy(cache_db_item->name, STR_MAX, stmt, 0);
+    __cache_column_copy(cache_db_item->path, PATH_MAX, stmt, 1);
+    __cache_column_copy(cache_db_item->imgpath, PATH_MAX, stmt, 2);
+    printf_debug("cache item found: %s\n", cache_db_item->name);
+    return cache_db_item;
+}
+
+CacheDBItem *cache_db_find(const char *path_or_name)
+{
+    printf_debug("cache_db_find('%s')\n", path_or_name);
+
+    CacheDBItem *cache_db_item = NULL;
+    char rel_path[PATH_MAX];
+    if (!file_path_relative_to(rel_path, "/mnt/SDCARD/Roms", path_or_name)) {
+        const char *roms_dir = strstr(path_or_name, "/Roms/");
+        strncpy(rel_path, roms_dir != NULL ? roms_dir + 6 : path_or_name, PATH_MAX - 1);
+        rel_path[PATH_MAX - 1] = '\0';
+    }
+
+    CacheDBLocation *location = __cache_locate(path_or_name);
+    const char *cache_db_file_path = location->cache_path;
+    const char *cache_type = location->cache_name;
+    int cache_version = location->version;
+
+    if (cache_version != 2 && cache_version != 6) {
         printf("No cache db found\n");
         return NULL;
     }
 
-    sqlite3_stmt *stmt = cache_db_prepare(cache_db_file_path, sql);
-    sqlite3_free(sql);
+    char *base_name = strdup(path_or_name);
+    char *game_name = file_removeExtension(basename(base_name));
+    free(base_name);
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        cache_db_item = (CacheDBItem *)malloc(sizeof(CacheDBItem));
-        strcpy(cache_db_item->cache_path, cache_db_file_path);
-        strcpy(cache_db_item->name, (const char *)sqlite3_column_text(stmt, 0));
-        strcpy(cache_db_item->path, (const char *)sqlite3_column_text(stmt, 1));
-        strcpy(cache_db_item->imgpath, (const char *)sqlite3_column_text(stmt, 2));
-        printf_debug("cache item found: %s\n", cache_db_item->name);
+    // The index is only used when already up to date, it is never built here
+    if (!location->index_checked && __cache_index_open(false)) {
+        location->index_synced = __cache_index_sync(cache_db_file_path, cache_type, cache_version, false);
+        location->index_checked = true;
+    }
+
+    if (location->index_synced) {
+        sqlite3_stmt *stmt = __cache_index_lookup;
+        if (stmt == NULL) {
+            sqlite3_prepare_v2(__cache_index_db,
+                               "SELECT name, path, imgpath FROM cache_index WHERE cache_path = ?1 AND rel_path = ?2 "
+                               "UNION ALL SELECT * FROM (SELECT name, path, imgpath FROM cache_index WHERE cache_path = ?1 AND disp = ?3 LIMIT 1) "
+                               "LIMIT 1;",
+                               -1, &stmt, NULL);
+            __cache_index_lookup = stmt;
+        }
+        sqlite3_bind_text(stmt, 1, cache_db_file_path, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, rel_path, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, game_name, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            cache_db_item = __cache_item_from_row(stmt, cache_db_file_path);
+        }
+        sqlite3_reset(stmt);
     }
     else {
-        printf("Game not found in this cache db\n");
+        CacheDBHandle *handle = cache_db_pool_get(cache_db_file_path, cache_type, cache_version);
+        if (handle != NULL) {
+            sqlite3_bind_text(handle->stmt, 1, rel_path, -1, SQLITE_STATIC);
+            sqlite3_bind_text(handle->stmt, 2, game_name, -1, SQLITE_STATIC);
+            if (sqlite3_step(handle->stmt) == SQLITE_ROW) {
+                cache_db_item = __cache_item_from_row(handle->stmt, cache_db_file_path);
+            }
+            sqlite3_reset(handle->stmt);
+        }
     }
 
-    sqlite3_finalize(stmt);
+    if (cache_db_item == NULL) {
+        printf("Game not found in this cache db\n");
+    }
 
+    free(game_name);
     return cache_db_item;
 }
 
+/**
+ * @brief Copies the MainUI cache of a rom into the sidecar index, unless
+ * the index is already up to date. Copying a large cache takes a while, so
+ * this runs off the UI path (`playActivity index_cache`), never from
+ * cache_db_find().
+ */
+bool cache_db_index_build(const char *rom_path)
+{
+    CacheDBLocation *location = __cache_locate(rom_path);
+
+    if (location->version != 2 && location->version != 6) {
+        printf("No cache db found\n");
+        return false;
+    }
+
+    if (!__cache_index_open(true))
+        return false;
+
+    location->index_synced = __cache_index_sync(location->cache_path, location->cache_name, location->version, true);
+    location->index_checked = true;
+
+    return location->index_synced;
+}
+
+/**
+ * @brief Closes the pooled cache handles and the sidecar index.
+ */
+void cache_db_release(void)
+{
+    for (int i = 0; i < CACHE_DB_POOL_SIZE; i++) {
+        CacheDBHandle *handle = &__cache_pool[i];
+        if (handle->db == NULL)
+            continue;
+        sqlite3_finalize(handle->stmt);
+        sqlite3_close(handle->db);
+        handle->db = NULL;
+        handle->stmt = NULL;
+    }
+    __cache_index_close();
+    __cache_index_failed = false;
+    for (int i = 0; i < __cache_locations_len; i++) {
+        __cache_locations[i].index_checked = false;
+        __cache_locations[i].index_synced = false;
+    }
+}
+
 #endif
@@ -12,7 +12,69 @@ void printUsage()
            "       playActivity stop [rom_path]  -> Stop the counter for this rom\n"
            "       playActivity stop_all         -> Stop the counter for all roms\n"
            "       playActivity migrate          -> Migrate the old database (prior to Onion 4.2.0) to SQLite\n"
-           "       playActivity fix_paths        -> Change all absolute paths to relative paths\n");
+           "       playActivity fix_paths        -> Change all absolute paths to relative paths\n"
+           "       playActivity check_stats      -> Verify the per-rom stats against the activity history\n"
+           "       playActivity fix_stats        -> Rebuild the per-rom stats if they are out of sync\n"
+           "       playActivity batch < commands -> Run start/stop/resume/stop_all lines from stdin in one transaction\n"
+           "       playActivity index_cache [rom_path] -> Copy the MainUI cache of this rom into the lookup index\n");
+}
+
+/**
+ * @brief Runs one command per line (e.g. `stop /path/to/rom`) on a single
+ * database handle, committing everything at once at the end. A failing
+ * command only rolls back its own changes.
+ *
+ * @return int Number of failed commands
+ */
+int runBatch(FILE *input)
+{
+    char line[PATH_MAX + 16];
+    int failed = 0;
+
+    play_activity_db_keep_open();
+    play_activity_db_open();
+    play_activity_db_begin();
+
+    while (fgets(line, sizeof(line), input) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        char *arg = strchr(line, ' ');
+        if (arg != NULL) {
+            *arg++ = '\0';
+            arg += strspn(arg, " ");
+        }
+
+        if (strlen(line) == 0) {
+            continue;
+        }
+
+        int rc = EXIT_SUCCESS;
+        if (strcmp(line, "start") == 0 && arg != NULL && strlen(arg) > 0) {
+            rc = play_activity_start(arg);
+        }
+        else if (strcmp(line, "stop") == 0 && arg != NULL && strlen(arg) > 0) {
+            rc = play_activity_stop(arg);
+        }
+        else if (strcmp(line, "resume") == 0) {
+            rc = play_activity_resume();
+        }
+        else if (strcmp(line, "stop_all") == 0) {
+            play_activity_stop_all();
+        }
+        else {
+            printf("Error: Invalid batch command '%s'\n", line);
+            rc = EXIT_FAILURE;
+        }
+
+        if (rc != EXIT_SUCCESS) {
+            failed++;
+        }
+    }
+
+    play_activity_db_commit();
+    play_activity_db_release();
+
+    return failed;
 }
 
 int main(int argc, char *argv[])
@@ -27,7 +89,9 @@ int main(int argc, char *argv[])
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "start") == 0) {
             if (i + 1 < argc) {
-                play_activity_start(argv[++i]);
+                if (play_activity_start(argv[++i]) != EXIT_SUCCESS) {
+                    return EXIT_FAILURE;
+                }
             }
             else {
                 printf("Error: Missing rom_path argument\n");
@@ -36,11 +100,15 @@ int main(int argc, char *argv[])
             }
         }
         else if (strcmp(argv[i], "resume") == 0) {
-            play_activity_resume();
+            if (play_activity_resume() != EXIT_SUCCESS) {
+                return EXIT_FAILURE;
+            }
         }
         else if (strcmp(argv[i], "stop") == 0) {
             if (i + 1 < argc) {
-                play_activity_stop(argv[++i]);
+                if (play_activity_stop(argv[++i]) != EXIT_SUCCESS) {
+                    return EXIT_FAILURE;
+                }
             }
             else {
                 printf("Error: Missing rom_path argument\n");
@@ -57,6 +125,31 @@ int main(int argc, char *argv[])
         else if (strcmp(argv[i], "fix_paths") == 0) {
             play_activity_fix_paths();
         }
+        else if (strcmp(argv[i], "check_stats") == 0) {
+            if (play_activity_check_stats(false) > 0) {
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "fix_stats") == 0) {
+            play_activity_check_stats(true);
+        }
+        else if (strcmp(argv[i], "batch") == 0) {
+            if (runBatch(stdin) > 0) {
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "index_cache") == 0) {
+            if (i + 1 < argc) {
+                if (!cache_db_index_build(argv[++i])) {
+                    return EXIT_FAILURE;
+                }
+            }
+            else {
+                printf("Error: Missing rom_path argument\n");
+                printUsage();
+                return EXIT_FAILURE;
+            }
+        }
         else if (strcmp(argv[i], "list") == 0) {
             play_activity_list_all();
         }
@@ -10,6 +10,7 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include "utils/arena.h"
 #include "utils/file.h"
 #include "utils/log.h"
 
@@ -20,6 +21,9 @@
 #define CMD_TO_RUN "/mnt/SDCARD/.tmp_update/cmd_to_run.sh"
 #define ROM_NOT_FOUND -1
 
+// Bumped whenever __db_upgrade_schema() gains a new step
+#define PLAY_ACTIVITY_DB_VERSION 1
+
 typedef struct ROM ROM;
 typedef struct PlayActivity PlayActivity;
 typedef struct PlayActivities PlayActivities;
@@ -43,31 +47,163 @@ struct PlayActivities {
     PlayActivity **play_activity;
     int count;
     int play_time_total;
+    Arena arena;
 };
 
+#define PLAY_ACTIVITY_STMT_CACHE_MAX 16
+
+typedef struct {
+    const char *sql;
+    sqlite3_stmt *stmt;
+} PlayActivityStmt;
+
 sqlite3 *play_activity_db = NULL;
 
+// Database file, changeable for tests
+static char play_activity_db_path[PATH_MAX] = PLAY_ACTIVITY_DB_NEW_FILE;
+
+static bool __db_keep_open = false;
+static PlayActivityStmt __db_stmt_cache[PLAY_ACTIVITY_STMT_CACHE_MAX];
+static int __db_stmt_cache_len = 0;
+static int __db_stmt_cache_next = 0;
+
+void __db_stmt_cache_clear(void)
+{
+    for (int i = 0; i < __db_stmt_cache_len; i++) {
+        sqlite3_finalize(__db_stmt_cache[i].stmt);
+        __db_stmt_cache[i].stmt = NULL;
+        __db_stmt_cache[i].sql = NULL;
+    }
+    __db_stmt_cache_len = 0;
+    __db_stmt_cache_next = 0;
+}
+
 void play_activity_db_close()
 {
+    if (__db_keep_open)
+        return;
+    __db_stmt_cache_clear();
     sqlite3_close(play_activity_db);
     play_activity_db = NULL;
 }
 
+#define ROM_STATS_SELECT_FROM_ACTIVITY                                       \
+    "SELECT rom_id, COUNT(ROWID) AS play_count, "                            \
+    "COALESCE(SUM(play_time), 0) AS play_time_total, "                       \
+    "COALESCE(SUM(play_time), 0) / COUNT(ROWID) AS play_time_average, "      \
+    "MIN(created_at) AS first_played_at, MAX(created_at) AS last_played_at " \
+    "FROM play_activity "
+
+/**
+ * @brief Creates the `rom_stats` summary table (one row per played ROM) and
+ * the triggers keeping it in sync with `play_activity`, then backfills it
+ * from the existing history.
+ */
+int __db_create_rom_stats(void)
+{
+    return sqlite3_exec(
+        play_activity_db,
+        "CREATE TABLE IF NOT EXISTS rom_stats(rom_id INTEGER PRIMARY KEY, play_count INTEGER NOT NULL DEFAULT 0, "
+        "play_time_total INTEGER NOT NULL DEFAULT 0, play_time_average INTEGER NOT NULL DEFAULT 0, "
+        "first_played_at INTEGER, last_played_at INTEGER);"
+        "CREATE INDEX IF NOT EXISTS rom_stats_play_time_total_index ON rom_stats(play_time_total);"
+
+        // New activity: fold it into the running totals
+        "CREATE TRIGGER IF NOT EXISTS rom_stats_insert AFTER INSERT ON play_activity WHEN NEW.rom_id IS NOT NULL BEGIN "
+        "  INSERT INTO rom_stats(rom_id, play_count, play_time_total, play_time_average, first_played_at, last_played_at) "
+        "  VALUES(NEW.rom_id, 1, COALESCE(NEW.play_time, 0), COALESCE(NEW.play_time, 0), NEW.created_at, NEW.created_at) "
+        "  ON CONFLICT(rom_id) DO UPDATE SET "
+        "    play_count = play_count + 1, "
+        "    play_time_total = play_time_total + excluded.play_time_total, "
+        "    play_time_average = (play_time_total + excluded.play_time_total) / (play_count + 1), "
+        "    first_played_at = MIN(COALESCE(first_played_at, excluded.first_played_at), COALESCE(excluded.first_played_at, first_played_at)), "
+        "    last_played_at = MAX(COALESCE(last_played_at, excluded.last_played_at), COALESCE(excluded.last_played_at, last_played_at)); "
+        "END;"
+
+        // Closed activity (play_time set): apply the delta
+        "CREATE TRIGGER IF NOT EXISTS rom_stats_update AFTER UPDATE OF play_time ON play_activity "
+        "WHEN NEW.rom_id IS OLD.rom_id AND NEW.created_at IS OLD.created_at BEGIN "
+        "  UPDATE rom_stats SET "
+        "    play_time_total = play_time_total - COALESCE(OLD.play_time, 0) + COALESCE(NEW.play_time, 0), "
+        "    play_time_average = (play_time_total - COALESCE(OLD.play_time, 0) + COALESCE(NEW.play_time, 0)) / play_count "
+        "  WHERE rom_id = NEW.rom_id; "
+        "END;"
+
+        // Activity moved to another rom or re-dated: recompute both roms
+        "CREATE TRIGGER IF NOT EXISTS rom_stats_update_rebuild AFTER UPDATE OF rom_id, created_at ON play_activity "
+        "WHEN NEW.rom_id IS NOT OLD.rom_id OR NEW.created_at IS NOT OLD.created_at BEGIN "
+        "  DELETE FROM rom_stats WHERE rom_id IN (OLD.rom_id, NEW.rom_id); "
+        "  INSERT INTO rom_stats " ROM_STATS_SELECT_FROM_ACTIVITY "WHERE rom_id IN (OLD.rom_id, NEW.rom_id) GROUP BY rom_id; "
+        "END;"
+
+        "CREATE TRIGGER IF NOT EXISTS rom_stats_delete AFTER DELETE ON play_activity BEGIN "
+        "  DELETE FROM rom_stats WHERE rom_id = OLD.rom_id; "
+        "  INSERT INTO rom_stats " ROM_STATS_SELECT_FROM_ACTIVITY "WHERE rom_id = OLD.rom_id GROUP BY rom_id; "
+        "END;"
+
+        "DELETE FROM rom_stats;"
+        "INSERT INTO rom_stats " ROM_STATS_SELECT_FROM_ACTIVITY "WHERE rom_id IS NOT NULL GROUP BY rom_id;",
+        NULL, NULL, NULL);
+}
+
+void __db_upgrade_schema(void)
+{
+    int version = 0;
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(play_activity_db, "PRAGMA user_version;", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    if (version >= PLAY_ACTIVITY_DB_VERSION)
+        return;
+
+    printf_debug("Upgrading play activity DB from version %d\n", version);
+    sqlite3_exec(play_activity_db, "BEGIN;", NULL, NULL, NULL);
+
+    int rc = SQLITE_OK;
+    if (version < 1)
+        rc = __db_create_rom_stats();
+
+    if (rc != SQLITE_OK) {
+        printf("%s\n", sqlite3_errmsg(play_activity_db));
+        sqlite3_exec(play_activity_db, "ROLLBACK;", NULL, NULL, NULL);
+        return;
+    }
+
+    char *sql = sqlite3_mprintf("PRAGMA user_version = %d;", PLAY_ACTIVITY_DB_VERSION);
+    sqlite3_exec(play_activity_db, sql, NULL, NULL, NULL);
+    sqlite3_free(sql);
+    sqlite3_exec(play_activity_db, "COMMIT;", NULL, NULL, NULL);
+}
+
 void play_activity_db_open(void)
 {
     if (play_activity_db != NULL)
         return;
 
-    bool play_activity_db_created = is_file(PLAY_ACTIVITY_DB_NEW_FILE);
+    bool play_activity_db_created = is_file(play_activity_db_path);
 
-    mkdir("/mnt/SDCARD/Saves/CurrentProfile/play_activity/", 0777);
+    char dir_path[PATH_MAX];
+    strcpy(dir_path, play_activity_db_path);
+    mkdir(dirname(dir_path), 0777);
 
-    if (sqlite3_open(PLAY_ACTIVITY_DB_NEW_FILE, &play_activity_db) != SQLITE_OK) {
+    if (sqlite3_open(play_activity_db_path, &play_activity_db) != SQLITE_OK) {
         printf("%s\n", sqlite3_errmsg(play_activity_db));
-        play_activity_db_close();
+        sqlite3_close(play_activity_db);
+        play_activity_db = NULL;
         return;
     }
 
+    // WAL + synchronous=NORMAL: a commit appends to the log without the
+    // rollback journal's extra fsyncs, which stall on FAT32 SD cards
+    sqlite3_busy_timeout(play_activity_db, 2000);
+    sqlite3_exec(play_activity_db,
+                 "PRAGMA journal_mode = WAL;"
+                 "PRAGMA synchronous = NORMAL;",
+                 NULL, NULL, NULL);
+
     if (!play_activity_db_created) {
         sqlite3_exec(play_activity_db,
                      "DROP TABLE IF EXISTS rom;"
@@ -80,6 +216,46 @@ void play_activity_db_open(void)
                      "CREATE INDEX play_activity_rom_id_index ON play_activity(rom_id);",
                      NULL, NULL, NULL);
     }
+
+    __db_upgrade_schema();
+}
+
+/**
+ * @brief Keep the database handle (and its prepared statements) open for the
+ * rest of the process, instead of reopening the file on every call.
+ * The handle is opened lazily on first use.
+ */
+void play_activity_db_keep_open(void)
+{
+    __db_keep_open = true;
+}
+
+/**
+ * @brief Close a handle kept open by play_activity_db_keep_open().
+ */
+void play_activity_db_release(void)
+{
+    __db_keep_open = false;
+    play_activity_db_close();
+}
+
+/**
+ * @brief Starts a (nestable) transaction. Must be paired with
+ * play_activity_db_commit() or play_activity_db_rollback().
+ */
+void play_activity_db_begin(void)
+{
+    sqlite3_exec(play_activity_db, "SAVEPOINT play_activity;", NULL, NULL, NULL);
+}
+
+void play_activity_db_commit(void)
+{
+    sqlite3_exec(play_activity_db, "RELEASE play_activity;", NULL, NULL, NULL);
+}
+
+void play_activity_db_rollback(void)
+{
+    sqlite3_exec(play_activity_db, "ROLLBACK TO play_activity; RELEASE play_activity;", NULL, NULL, NULL);
 }
 
 int play_activity_db_transaction(int (*exec_transaction)(void))
@@ -91,7 +267,7 @@ int play_activity_db_transaction(int (*exec_transaction)(void))
     return retval;
 }
 
-int play_activity_db_execute(char *sql)
+int play_activity_db_execute(const char *sql)
 {
     printf_debug("play_activity_db_execute(%s)\n", sql);
     play_activity_db_open();
@@ -100,7 +276,7 @@ int play_activity_db_execute(char *sql)
     return rc;
 }
 
-sqlite3_stmt *play_activity_db_prepare(char *sql)
+sqlite3_stmt *play_activity_db_prepare(const char *sql)
 {
     printf_debug("play_activity_db_prepare(%s)\n", sql);
     if (play_activity_db == NULL) {
@@ -114,101 +290,175 @@ sqlite3_stmt *play_activity_db_prepare(char *sql)
     return stmt;
 }
 
+/**
+ * @brief Returns a reset prepared statement for `sql`, reusing it while the
+ * database stays open. Parameters must be bound with sqlite3_bind_*, and
+ * `sql` must stay valid while cached (use string literals).
+ * The statement is owned by the cache: call sqlite3_reset() when done,
+ * never sqlite3_finalize().
+ */
+sqlite3_stmt *play_activity_db_cached(const char *sql)
+{
+    if (play_activity_db == NULL) {
+        printf("DB is not open");
+        return NULL;
+    }
+
+    for (int i = 0; i < __db_stmt_cache_len; i++) {
+        PlayActivityStmt *entry = &__db_stmt_cache[i];
+        if (entry->sql == sql || strcmp(entry->sql, sql) == 0) {
+            sqlite3_reset(entry->stmt);
+            sqlite3_clear_bindings(entry->stmt);
+            return entry->stmt;
+        }
+    }
+
+    printf_debug("play_activity_db_cached(%s)\n", sql);
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v3(play_activity_db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL) != SQLITE_OK) {
+        printf("%s: %s\n", sqlite3_errmsg(play_activity_db), sql);
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
+    PlayActivityStmt *entry;
+    if (__db_stmt_cache_len < PLAY_ACTIVITY_STMT_CACHE_MAX) {
+        entry = &__db_stmt_cache[__db_stmt_cache_len++];
+    }
+    else {
+        entry = &__db_stmt_cache[__db_stmt_cache_next];
+        __db_stmt_cache_next = (__db_stmt_cache_next + 1) % PLAY_ACTIVITY_STMT_CACHE_MAX;
+        sqlite3_finalize(entry->stmt);
+    }
+    entry->sql = sql;
+    entry->stmt = stmt;
+
+    return stmt;
+}
+
 int play_activity_get_total_play_time(void)
 {
     int total_play_time = 0;
-    char *sql =
-        "SELECT SUM(play_time_total) FROM (SELECT SUM(play_time) AS play_time_total FROM play_activity GROUP BY rom_id) "
-        "WHERE play_time_total > 60;";
-    sqlite3_stmt *stmt;
+    const char *sql =
+        "SELECT SUM(play_time_total) FROM rom_stats WHERE play_time_total > 60;";
 
     play_activity_db_open();
-    stmt = play_activity_db_prepare(sql);
+    sqlite3_stmt *stmt = play_activity_db_cached(sql);
 
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         total_play_time = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     play_activity_db_close();
 
     return total_play_time;
 }
 
-PlayActivities *play_activity_find_all(void)
+#define PLAY_ACTIVITY_SELECT                                                                \
+    "SELECT rom.id, rom.type, rom.name, rom.file_path, rom.image_path, "                    \
+    "       rom_stats.play_count, rom_stats.play_time_total, rom_stats.play_time_average, " \
+    "       datetime(rom_stats.first_played_at, 'unixepoch'), "                             \
+    "       datetime(rom_stats.last_played_at, 'unixepoch') "                               \
+    "FROM rom_stats JOIN rom ON rom.id = rom_stats.rom_id "                                 \
+    "WHERE rom_stats.play_time_total > 60 "                                                 \
+    "ORDER BY rom_stats.play_time_total DESC, rom_stats.rom_id "
+
+/**
+ * @brief Reads all rows of `stmt` in a single pass. Entries, roms and strings
+ * are allocated from the result's arena; the pointer array grows geometrically.
+ */
+PlayActivities *__db_load_play_activities(sqlite3_stmt *stmt)
 {
-    PlayActivities *play_activities = NULL;
-    char *sql =
-        "SELECT * FROM ("
-        "    SELECT rom.id, rom.type, rom.name, rom.file_path, rom.image_path, "
-        "           COUNT(play_activity.ROWID) AS play_count_total, "
-        "           SUM(play_activity.play_time) AS play_time_total, "
-        "           SUM(play_activity.play_time)/COUNT(play_activity.ROWID) AS play_time_average, "
-        "           datetime(MIN(play_activity.created_at), 'unixepoch') AS first_played_at, "
-        "           datetime(MAX(play_activity.created_at), 'unixepoch') AS last_played_at "
-        "    FROM rom LEFT JOIN play_activity ON rom.id = play_activity.rom_id "
-        "    GROUP BY rom.id) "
-        "WHERE play_time_total > 60 "
-        "ORDER BY play_time_total DESC;";
-    sqlite3_stmt *stmt;
-
-    play_activity_db_open();
+    PlayActivities *play_activities = (PlayActivities *)calloc(1, sizeof(PlayActivities));
+    if (play_activities == NULL)
+        return NULL;
 
-    stmt = play_activity_db_prepare(sql);
+    Arena *arena = &play_activities->arena;
+    int capacity = 0;
 
-    int play_activity_count = 0;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        play_activity_count++;
-    }
-    sqlite3_reset(stmt);
-
-    play_activities = (PlayActivities *)malloc(sizeof(PlayActivities));
-    play_activities->count = play_activity_count;
-    play_activities->play_time_total = 0;
-    play_activities->play_activity = (PlayActivity **)malloc(sizeof(PlayActivity *) * play_activities->count);
+        if (play_activities->count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 16;
+            PlayActivity **items = (PlayActivity **)realloc(play_activities->play_activity, sizeof(PlayActivity *) * capacity);
+            if (items == NULL)
+                break;
+            play_activities->play_activity = items;
+        }
 
-    for (int i = 0; i < play_activities->count; i++) {
-        if (sqlite3_step(stmt) != SQLITE_ROW)
+        PlayActivity *entry = (PlayActivity *)arena_alloc(arena, sizeof(PlayActivity));
+        ROM *rom = (ROM *)arena_alloc(arena, sizeof(ROM));
+        if (entry == NULL || rom == NULL)
             break;
 
-        PlayActivity *entry = play_activities->play_activity[i] = (PlayActivity *)malloc(sizeof(PlayActivity));
-        ROM *rom = play_activities->play_activity[i]->rom = (ROM *)malloc(sizeof(ROM));
-
         rom->id = sqlite3_column_int(stmt, 0);
-        rom->type = strdup((const char *)sqlite3_column_text(stmt, 1));
-        rom->name = strdup((const char *)sqlite3_column_text(stmt, 2));
-        if (sqlite3_column_text(stmt, 3) != NULL) {
-            rom->file_path = strdup((const char *)sqlite3_column_text(stmt, 3));
-        }
-        if (sqlite3_column_text(stmt, 4) != NULL) {
-            rom->image_path = strdup((const char *)sqlite3_column_text(stmt, 4));
-        }
+        rom->type = arena_strdup(arena, (const char *)sqlite3_column_text(stmt, 1));
+        rom->name = arena_strdup(arena, (const char *)sqlite3_column_text(stmt, 2));
+        rom->file_path = arena_strdup(arena, (const char *)sqlite3_column_text(stmt, 3));
+        rom->image_path = arena_strdup(arena, (const char *)sqlite3_column_text(stmt, 4));
 
+        entry->rom = rom;
         entry->play_count = sqlite3_column_int(stmt, 5);
         entry->play_time_total = sqlite3_column_int(stmt, 6);
         entry->play_time_average = sqlite3_column_int(stmt, 7);
-        if (sqlite3_column_text(stmt, 8) != NULL) {
-            entry->first_played_at = strdup((const char *)sqlite3_column_text(stmt, 8));
-        }
-        if (sqlite3_column_text(stmt, 9) != NULL) {
-            entry->last_played_at = strdup((const char *)sqlite3_column_text(stmt, 9));
-        }
+        entry->first_played_at = arena_strdup(arena, (const char *)sqlite3_column_text(stmt, 8));
+        entry->last_played_at = arena_strdup(arena, (const char *)sqlite3_column_text(stmt, 9));
 
+        play_activities->play_activity[play_activities->count++] = entry;
         play_activities->play_time_total += entry->play_time_total;
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
+
+    return play_activities;
+}
+
+PlayActivities *play_activity_find_all(void)
+{
+    play_activity_db_open();
+    PlayActivities *play_activities = __db_load_play_activities(play_activity_db_cached(PLAY_ACTIVITY_SELECT ";"));
     play_activity_db_close();
+    return play_activities;
+}
 
+/**
+ * @brief Loads only `limit` entries starting at `offset`, in the same order
+ * as play_activity_find_all().
+ */
+PlayActivities *play_activity_find_page(int offset, int limit)
+{
+    play_activity_db_open();
+    sqlite3_stmt *stmt = play_activity_db_cached(PLAY_ACTIVITY_SELECT "LIMIT ? OFFSET ?;");
+    sqlite3_bind_int(stmt, 1, limit);
+    sqlite3_bind_int(stmt, 2, offset);
+    PlayActivities *play_activities = __db_load_play_activities(stmt);
+    play_activity_db_close();
     return play_activities;
 }
 
-void free_play_activities(PlayActivities *pa_ptr)
+/**
+ * @brief Number of entries play_activity_find_all() would return.
+ */
+int play_activity_count_all(void)
 {
-    for (int i = 0; i < pa_ptr->count; i++) {
-        free(pa_ptr->play_activity[i]->rom);
-        free(pa_ptr->play_activity[i]);
+    int count = 0;
+    play_activity_db_open();
+    sqlite3_stmt *stmt = play_activity_db_cached(
+        "SELECT COUNT(*) FROM rom_stats JOIN rom ON rom.id = rom_stats.rom_id "
+        "WHERE rom_stats.play_time_total > 60;");
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int(stmt, 0);
     }
+    sqlite3_reset(stmt);
+    play_activity_db_close();
+    return count;
+}
+
+void free_play_activities(PlayActivities *pa_ptr)
+{
+    if (pa_ptr == NULL)
+        return;
+    arena_free(&pa_ptr->arena);
     free(pa_ptr->play_activity);
     free(pa_ptr);
 }
@@ -232,16 +482,16 @@ int __db_insert_rom(const char *rom_type, const char *rom_name, const char *file
     char rel_path[PATH_MAX];
     __ensure_rel_path(rel_path, file_path);
 
-    char *sql = sqlite3_mprintf("INSERT INTO rom(type, name, file_path, image_path) VALUES(%Q, %Q, %Q, %Q);",
-                                rom_type, rom_name, rel_path, image_path);
-    sqlite3_exec(play_activity_db, sql, NULL, NULL, NULL);
-    sqlite3_free(sql);
+    sqlite3_stmt *stmt = play_activity_db_cached("INSERT INTO rom(type, name, file_path, image_path) VALUES(?, ?, ?, ?);");
+    sqlite3_bind_text(stmt, 1, rom_type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, rom_name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, rel_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, image_path, -1, SQLITE_STATIC);
 
-    sqlite3_stmt *stmt = play_activity_db_prepare("SELECT id FROM rom WHERE ROWID = last_insert_rowid()");
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        rom_id = sqlite3_column_int(stmt, 0);
+    if (sqlite3_step(stmt) == SQLITE_DONE) {
+        rom_id = (int)sqlite3_last_insert_rowid(play_activity_db);
     }
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
 
     return rom_id;
 }
@@ -256,10 +506,14 @@ void __db_update_rom(int rom_id, const char *rom_type, const char *rom_name, con
     char rel_path[PATH_MAX];
     __ensure_rel_path(rel_path, file_path);
 
-    char *sql = sqlite3_mprintf("UPDATE rom SET type = %Q, name = %Q, file_path = %Q, image_path = %Q WHERE id = %d;",
-                                rom_type, rom_name, rel_path, image_path, rom_id);
-    sqlite3_exec(play_activity_db, sql, NULL, NULL, NULL);
-    sqlite3_free(sql);
+    sqlite3_stmt *stmt = play_activity_db_cached("UPDATE rom SET type = ?, name = ?, file_path = ?, image_path = ? WHERE id = ?;");
+    sqlite3_bind_text(stmt, 1, rom_type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, rom_name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, rel_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, image_path, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 5, rom_id);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
 }
 
 void __db_update_rom_from_cache(int rom_id, CacheDBItem *cache_db_item)
@@ -273,15 +527,15 @@ int __db_get_orphan_rom_id(const char *rom_path)
     char *file_name = basename(strdup(rom_path));
     char *rom_name = file_removeExtension(file_name);
 
-    char *sql = sqlite3_mprintf("SELECT id FROM rom WHERE (name=%Q OR name=%Q) AND type='ORPHAN' LIMIT 1;", rom_name, file_name);
-    sqlite3_stmt *stmt = play_activity_db_prepare(sql);
-    sqlite3_free(sql);
+    sqlite3_stmt *stmt = play_activity_db_cached("SELECT id FROM rom WHERE (name = ? OR name = ?) AND type = 'ORPHAN' LIMIT 1;");
+    sqlite3_bind_text(stmt, 1, rom_name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, file_name, -1, SQLITE_STATIC);
 
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         rom_id = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
 
     return rom_id;
 }
@@ -293,15 +547,14 @@ int __db_get_rom_id_by_path(const char *rom_path)
     char rel_path[PATH_MAX];
     __ensure_rel_path(rel_path, rom_path);
 
-    char *sql = sqlite3_mprintf("SELECT id FROM rom WHERE file_path=%Q LIMIT 1;", rel_path);
-    sqlite3_stmt *stmt = play_activity_db_prepare(sql);
-    sqlite3_free(sql);
+    sqlite3_stmt *stmt = play_activity_db_cached("SELECT id FROM rom WHERE file_path = ? LIMIT 1;");
+    sqlite3_bind_text(stmt, 1, rel_path, -1, SQLITE_STATIC);
 
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         rom_id = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
 
     return rom_id;
 }
@@ -370,13 +623,12 @@ int play_activity_get_play_time(const char *rom_path)
     play_activity_db_open();
     int rom_id = __db_rom_find_by_file_path(rom_path, false);
     if (rom_id != ROM_NOT_FOUND) {
-        char *sql = sqlite3_mprintf("SELECT SUM(play_time) FROM play_activity WHERE rom_id = %d;", rom_id);
-        sqlite3_stmt *stmt = play_activity_db_prepare(sql);
-        sqlite3_free(sql);
+        sqlite3_stmt *stmt = play_activity_db_cached("SELECT play_time_total FROM rom_stats WHERE rom_id = ?;");
+        sqlite3_bind_int(stmt, 1, rom_id);
         if (sqlite3_step(stmt) == SQLITE_ROW) {
             play_time = sqlite3_column_int(stmt, 0);
         }
-        sqlite3_finalize(stmt);
+        sqlite3_reset(stmt);
     }
     play_activity_db_close();
     return play_time;
@@ -421,49 +673,93 @@ int __db_get_active_closed_activity(void)
         return ROM_NOT_FOUND;
     }
 
-    char *sql = sqlite3_mprintf("SELECT * FROM play_activity WHERE rom_id = %d AND play_time IS NULL;", rom_id);
-    sqlite3_stmt *stmt = play_activity_db_prepare(sql);
+    sqlite3_stmt *stmt = play_activity_db_cached("SELECT 1 FROM play_activity WHERE rom_id = ? AND play_time IS NULL LIMIT 1;");
+    sqlite3_bind_int(stmt, 1, rom_id);
 
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         // Activity is not closed
         rom_id = ROM_NOT_FOUND;
     }
 
-    sqlite3_free(sql);
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
 
     return rom_id;
 }
 
-void play_activity_start(char *rom_file_path)
+void __db_insert_activity(int rom_id)
+{
+    sqlite3_stmt *stmt = play_activity_db_cached("INSERT INTO play_activity(rom_id) VALUES(?);");
+    sqlite3_bind_int(stmt, 1, rom_id);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+}
+
+void __db_close_activity(int rom_id)
+{
+    sqlite3_stmt *stmt = play_activity_db_cached(
+        "UPDATE play_activity SET play_time = (strftime('%s', 'now')) - created_at, updated_at = (strftime('%s', 'now')) "
+        "WHERE rom_id = ? AND play_time IS NULL;");
+    sqlite3_bind_int(stmt, 1, rom_id);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+}
+
+/**
+ * @brief Resolves (or creates) the rom and opens a new activity for it, in a
+ * single transaction.
+ *
+ * @return int EXIT_SUCCESS, or EXIT_FAILURE if the rom could not be resolved
+ */
+int play_activity_start(const char *rom_file_path)
 {
     printf_debug("\n:: play_activity_start(%s)\n", rom_file_path);
-    int rom_id = play_activity_transaction_rom_find_by_file_path(rom_file_path, true);
-    if (rom_id == ROM_NOT_FOUND) {
-        exit(1);
+    play_activity_db_open();
+    play_activity_db_begin();
+    int rom_id = __db_rom_find_by_file_path(rom_file_path, true);
+    if (rom_id != ROM_NOT_FOUND) {
+        __db_insert_activity(rom_id);
+        play_activity_db_commit();
     }
-    play_activity_db_execute(sqlite3_mprintf("INSERT INTO play_activity(rom_id) VALUES(%d);", rom_id));
+    else {
+        play_activity_db_rollback();
+    }
+    play_activity_db_close();
+    return rom_id != ROM_NOT_FOUND ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-void play_activity_resume(void)
+int play_activity_resume(void)
 {
     print_debug("\n:: play_activity_resume()");
-    int rom_id = play_activity_db_transaction(__db_get_active_closed_activity);
-    if (rom_id == ROM_NOT_FOUND) {
+    play_activity_db_open();
+    play_activity_db_begin();
+    int rom_id = __db_get_active_closed_activity();
+    if (rom_id != ROM_NOT_FOUND) {
+        __db_insert_activity(rom_id);
+        play_activity_db_commit();
+    }
+    else {
         printf("Error: no active rom\n");
-        exit(1);
+        play_activity_db_rollback();
     }
-    play_activity_db_execute(sqlite3_mprintf("INSERT INTO play_activity(rom_id) VALUES(%d);", rom_id));
+    play_activity_db_close();
+    return rom_id != ROM_NOT_FOUND ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-void play_activity_stop(char *rom_file_path)
+int play_activity_stop(const char *rom_file_path)
 {
     printf_debug("\n:: play_activity_stop(%s)\n", rom_file_path);
-    int rom_id = play_activity_transaction_rom_find_by_file_path(rom_file_path, false);
-    if (rom_id == ROM_NOT_FOUND) {
-        exit(1);
+    play_activity_db_open();
+    play_activity_db_begin();
+    int rom_id = __db_rom_find_by_file_path(rom_file_path, false);
+    if (rom_id != ROM_NOT_FOUND) {
+        __db_close_activity(rom_id);
+        play_activity_db_commit();
+    }
+    else {
+        play_activity_db_rollback();
     }
-    play_activity_db_execute(sqlite3_mprintf("UPDATE play_activity SET play_time = (strftime('%%s', 'now')) - created_at, updated_at = (strftime('%%s', 'now')) WHERE rom_id = %d AND play_time IS NULL;", rom_id));
+    play_activity_db_close();
+    return rom_id != ROM_NOT_FOUND ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 void play_activity_stop_all(void)
@@ -496,20 +792,80 @@ void play_activity_fix_paths(void)
         char rel_path[PATH_MAX];
         __ensure_rel_path(rel_path, file_path);
 
-        char *sql;
-        if (cache_version == CACHE_NOT_FOUND) {
-            sql = sqlite3_mprintf("UPDATE rom SET file_path = %Q WHERE id = %d;", rel_path, rom_id);
+        sqlite3_stmt *update_stmt = play_activity_db_cached("UPDATE rom SET file_path = ?, type = COALESCE(?, type) WHERE id = ?;");
+        sqlite3_bind_text(update_stmt, 1, rel_path, -1, SQLITE_STATIC);
+        if (cache_version != CACHE_NOT_FOUND) {
+            sqlite3_bind_text(update_stmt, 2, cache_path, -1, SQLITE_STATIC);
         }
-        else {
-            sql = sqlite3_mprintf("UPDATE rom SET file_path = %Q, type = %Q WHERE id = %d;", rel_path, cache_path, rom_id);
+        sqlite3_bind_int(update_stmt, 3, rom_id);
+        sqlite3_step(update_stmt);
+        sqlite3_reset(update_stmt);
+    }
+
+    sqlite3_finalize(stmt);
+    play_activity_db_close();
+}
+
+/**
+ * @brief Runs SQLite's quick integrity check, then compares `rom_stats` with
+ * aggregates computed from the raw `play_activity` history, printing every
+ * problem found.
+ *
+ * @param fix Rebuild `rom_stats` from the history when mismatches are found
+ * @return int Number of integrity errors plus mismatching roms
+ */
+int play_activity_check_stats(bool fix)
+{
+    print_debug("\n:: play_activity_check_stats()");
+    int errors = 0;
+    int mismatches = 0;
+
+    play_activity_db_open();
+
+    sqlite3_stmt *stmt = play_activity_db_prepare("PRAGMA quick_check;");
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *result = (const char *)sqlite3_column_text(stmt, 0);
+        if (strcmp(result, "ok") != 0) {
+            printf("quick_check: %s\n", result);
+            errors++;
         }
-        printf_debug("%s\n", sql);
-        sqlite3_exec(play_activity_db, sql, NULL, NULL, NULL);
-        sqlite3_free(sql);
     }
+    sqlite3_finalize(stmt);
+
+    stmt = play_activity_db_prepare(
+        "SELECT a.rom_id, a.play_count, s.play_count, a.play_time_total, s.play_time_total "
+        "FROM (" ROM_STATS_SELECT_FROM_ACTIVITY "WHERE rom_id IS NOT NULL GROUP BY rom_id) AS a "
+        "LEFT JOIN rom_stats AS s ON s.rom_id = a.rom_id "
+        "WHERE a.play_count IS NOT s.play_count OR a.play_time_total IS NOT s.play_time_total "
+        "   OR a.play_time_average IS NOT s.play_time_average "
+        "   OR a.first_played_at IS NOT s.first_played_at OR a.last_played_at IS NOT s.last_played_at "
+        "UNION ALL "
+        "SELECT s.rom_id, 0, s.play_count, 0, s.play_time_total FROM rom_stats AS s "
+        "WHERE NOT EXISTS (SELECT 1 FROM play_activity WHERE play_activity.rom_id = s.rom_id);");
 
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        printf("rom %d: plays %d (stats: %d), time %d (stats: %d)\n",
+               sqlite3_column_int(stmt, 0),
+               sqlite3_column_int(stmt, 1), sqlite3_column_int(stmt, 2),
+               sqlite3_column_int(stmt, 3), sqlite3_column_int(stmt, 4));
+        mismatches++;
+    }
     sqlite3_finalize(stmt);
+
+    printf("%d mismatching rom(s) in rom_stats\n", mismatches);
+
+    if (fix && mismatches > 0) {
+        sqlite3_exec(play_activity_db,
+                     "BEGIN;"
+                     "DELETE FROM rom_stats;"
+                     "INSERT INTO rom_stats " ROM_STATS_SELECT_FROM_ACTIVITY "WHERE rom_id IS NOT NULL GROUP BY rom_id;"
+                     "COMMIT;",
+                     NULL, NULL, NULL);
+        printf("rom_stats rebuilt\n");
+    }
+
     play_activity_db_close();
+    return errors + mismatches;
 }
 
 void play_activity_list_all(void)
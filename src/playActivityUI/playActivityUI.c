@@ -24,7 +24,8 @@ static TTF_Font *font30;
 static TTF_Font *fontCJKRomName25;
 static TTF_Font *font18;
 
-static PlayActivities *play_activities;
+static PlayActivities *play_activities; // entries of the current page only
+static int play_activities_count = 0;
 
 static SDL_Color color_white = {255, 255, 255};
 static SDL_Color color_purple = {136, 97, 252};
@@ -56,6 +57,7 @@ void init(void)
 
 void free_resources(void)
 {
+    text_cacheFree();
     TTF_CloseFont(font40);
     TTF_CloseFont(font30);
     TTF_CloseFont(fontCJKRomName25);
@@ -70,19 +72,19 @@ void free_resources(void)
     SDL_Quit();
 
     free_play_activities(play_activities);
+    play_activity_db_release();
 }
 
 int _renderText(const char *text, TTF_Font *font, SDL_Color color, SDL_Rect *rect, bool right_align)
 {
     int text_width = 0;
-    SDL_Surface *textSurface = TTF_RenderUTF8_Blended(font, text, color);
+    SDL_Surface *textSurface = text_render(font, text, color);
     if (textSurface != NULL) {
         text_width = textSurface->w;
         if (right_align)
             SDL_BlitSurface(textSurface, NULL, screen, &(SDL_Rect){rect->x - textSurface->w, rect->y, rect->w, rect->h});
         else
             SDL_BlitSurface(textSurface, NULL, screen, rect);
-        SDL_FreeSurface(textSurface);
     }
     return text_width;
 }
@@ -134,10 +136,10 @@ void renderPage(int current_page)
     for (int row = 0; row < 4; row++) {
         int index = current_page * 4 + row;
 
-        if (index >= play_activities->count)
+        if (row >= play_activities->count)
             break;
 
-        PlayActivity *entry = play_activities->play_activity[index];
+        PlayActivity *entry = play_activities->play_activity[row];
         ROM *rom = entry->rom;
 
         sprintf(num_str, "%d", index + 1);
@@ -177,19 +179,22 @@ int main(int argc, char *argv[])
     SDL_Rect rectPages = {620, 430, 90, 44};
     SDL_Rect rectMileage = {484, 8, 170, 42};
 
-    play_activities = play_activity_find_all();
-    printf_debug("found %d roms\n", play_activities->count);
+    play_activity_db_keep_open();
+    play_activities_count = play_activity_count_all();
+    printf_debug("found %d roms\n", play_activities_count);
 
-    int num_pages = (int)ceil((double)play_activities->count / (double)4);
+    int num_pages = (int)ceil((double)play_activities_count / (double)4);
     int current_page = 0;
+    int loaded_page = 0;
 
+    play_activities = play_activity_find_page(0, 4);
     renderPage(current_page);
 
     char num_pages_str[25];
     sprintf(num_pages_str, "%d/%d", current_page + 1, num_pages);
     renderTextAlignRight(num_pages_str, font30, color_white, &rectPages);
 
-    int play_time_total = play_activities->play_time_total;
+    int play_time_total = play_activity_get_total_play_time();
     char play_time_total_formatted[STR_MAX];
     str_serializeTime(play_time_total_formatted, play_time_total);
     renderText(play_time_total_formatted, font30, color_white, &rectMileage);
@@ -227,6 +232,12 @@ int main(int argc, char *argv[])
         if (!changed)
             continue;
 
+        if (loaded_page != current_page) {
+            free_play_activities(play_activities);
+            play_activities = play_activity_find_page(current_page * 4, 4);
+            loaded_page = current_page;
+        }
+
         SDL_BlitSurface(background, NULL, screen, NULL);
 
         sprintf(num_pages_str, "%d/%d", current_page + 1, num_pages);
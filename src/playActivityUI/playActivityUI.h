@@ -20,6 +20,7 @@
 
 #include "system/keymap_sw.h"
 #include "system/system.h"
+#include "theme/text.h"
 #include "utils/config.h"
 #include "utils/file.h"
 #include "utils/keystate.h"
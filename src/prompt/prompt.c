@@ -107,8 +107,7 @@ int main(int argc, char *argv[])
     List list = list_create(pargc, LIST_SMALL);
 
     for (i = 0; i < pargc; i++) {
-        ListItem item = {.action_id = i, .action = NULL};
-        strncpy(item.label, pargs[i], STR_MAX - 1);
+        ListItem item = {.label = pargs[i], .action_id = i, .action = NULL};
         printf_debug("Adding list item: %s (%d)\n", item.label, item.action_id);
         list_addItem(&list, item);
     }
@@ -1,14 +1,13 @@
-#include <fcntl.h>
-#include <linux/input.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "system/keyinject.h"
 #include "utils/log.h"
 
 int main(int argc, char *argv[])
 {
-    struct input_event events[100];
+    int events[KEYINJECT_MAX_EVENTS][2];
 
     if (argc < 3 || argc % 2 == 0) {
         printf("Usage: sendkeys [[CODE] [VALUE], ...]\nValues: 0 - released, 1 "
@@ -17,23 +16,16 @@ int main(int argc, char *argv[])
     }
 
     int num_events = (argc - 1) / 2;
+    if (num_events > KEYINJECT_MAX_EVENTS)
+        num_events = KEYINJECT_MAX_EVENTS;
 
-    for (int i = 1; i < argc; i += 2) {
-        int ev_idx = (i - 1) / 2;
-        events[ev_idx].type = EV_KEY;
-        events[ev_idx].code = atoi(argv[i]);
-        events[ev_idx].value = atoi(argv[i + 1]);
+    for (int i = 0; i < num_events; i++) {
+        events[i][0] = atoi(argv[i * 2 + 1]);
+        events[i][1] = atoi(argv[i * 2 + 2]);
     }
 
-    int input_fd;
-    input_fd = open("/dev/input/event0", O_WRONLY);
-
-    for (int j = 0; j < num_events; j++) {
-        printf_debug("sendkeys: code = %d, value = %d\n", events[j].code,
-                     events[j].value);
-        write(input_fd, &events[j], sizeof(events[j]));
-    }
-    close(input_fd);
+    bool sent = keyinject_sendMulti(num_events, events);
+    keyinject_close();
     sync();
-    return 0;
+    return sent ? 0 : 1;
 }
@@ -6,6 +6,7 @@
 #include <strings.h>
 #include <unistd.h>
 
+#include "theme/compile.h"
 #include "theme/config.h"
 #include "utils/apply_icons.h"
 #include "utils/file.h"
@@ -203,6 +204,8 @@ void installTheme(char *theme_path, bool apply_icons)
     installNonDynamicElement(settings.theme, "ic-MENU+A");
     installNonDynamicElement(settings.theme, "progress-dot");
 
+    theme_compile(theme_path);
+
     if (apply_icons) {
         char icon_pack_path[STR_MAX + 32];
         snprintf(icon_pack_path, STR_MAX + 32 - 1, "%sicons", theme_path);
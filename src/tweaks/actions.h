@@ -430,8 +430,7 @@ void action_deleteAllRecordings(void *pt)
         }
         else {
             system("/mnt/SDCARD/.tmp_update/script/screen_recorder.sh hardkill &");
-            strncpy(_menu_screen_recorder.items[0].sticky_note, "Status: Idle.", sizeof(_menu_screen_recorder.items[0].sticky_note) - 1);
-            _menu_screen_recorder.items[0].sticky_note[sizeof(_menu_screen_recorder.items[0].sticky_note) - 1] = '\0';
+            list_updateStickyNote(&_menu_screen_recorder.items[0], "Status: Idle.");
         }
     }
     else {
@@ -11,29 +11,19 @@
 
 #define BATTPERC_MAX_OFFSET 48
 
-#define BUTTON_MAINUI_LABELS                          \
-    {                                                 \
-        "Context menu", "GameSwitcher", "Resume game" \
-    }
-#define BUTTON_INGAME_LABELS                                  \
-    {                                                         \
-        "Off", "GameSwitcher", "Exit to menu", "Quick switch" \
-    }
+#define BUTTON_MAINUI_LABELS \
+    LIST_VALUE_LABELS("Context menu", "GameSwitcher", "Resume game")
+#define BUTTON_INGAME_LABELS \
+    LIST_VALUE_LABELS("Off", "GameSwitcher", "Exit to menu", "Quick switch")
 
 #define THEME_TOGGLE_LABELS \
-    {                       \
-        "-", "Off", "On"    \
-    }
+    LIST_VALUE_LABELS("-", "Off", "On")
 
-#define BLUELIGHT_LABELS                                                          \
-    {                                                                             \
-        "Subtle 1/5", "Moderate 2/5", "Balanced 3/5", "Strong 4/5", "Intense 5/5" \
-    }
+#define BLUELIGHT_LABELS \
+    LIST_VALUE_LABELS("Subtle 1/5", "Moderate 2/5", "Balanced 3/5", "Strong 4/5", "Intense 5/5")
 
-#define PWM_FREQUENCIES                                                                                                \
-    {                                                                                                                  \
-        "100 Hz", "200 Hz", "300 Hz", "400 Hz", "500 Hz", "600 Hz", "700 Hz", "800  Hz (Default)", "900 Hz", "1000 Hz" \
-    }
+#define PWM_FREQUENCIES \
+    LIST_VALUE_LABELS("100 Hz", "200 Hz", "300 Hz", "400 Hz", "500 Hz", "600 Hz", "700 Hz", "800  Hz (Default)", "900 Hz", "1000 Hz")
 
 void formatter_timezone(void *pt, char *out_label)
 {
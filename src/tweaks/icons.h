@@ -19,6 +19,8 @@
 
 #include "./appstate.h"
 
+#define ICONS_PREVIEW_CACHE 7 // previews kept loaded around the active item
+
 typedef struct IconInfo {
     char name[STR_MAX];
     char path[STR_MAX];
@@ -52,12 +54,10 @@ int _add_icon_alts(const char *pack_dir, const char *pack_name,
             snprintf(alt_name, STR_MAX - 1, "%s - %s", pack_name,
                      file_removeExtension(str_split(icon_name, "-")));
 
-            ListItem item = {.action = action};
-            strncpy(item.label, alt_name, STR_MAX - 1);
-            strncpy(item.payload, pack_dir, STR_MAX - 1);
+            ListItem item = {.label = alt_name, .payload = pack_dir, .action = action};
 
             if (is_file(preview_path))
-                strncpy(item.preview_path, preview_path, STR_MAX - 1);
+                item.preview_path = preview_path;
 
             list_addItem(list, item);
             count++;
@@ -116,12 +116,10 @@ int _add_icon_packs(const char *path, List *list, void (*action)(void *),
                 strncpy(icon_pack_name, ep->d_name, STR_MAX - 1);
                 str_split(icon_pack_name, " by ");
 
-                ListItem item = {.action = action};
-                strncpy(item.label, icon_pack_name, STR_MAX - 1);
-                strncpy(item.payload, icon_pack_path, STR_MAX - 1);
+                ListItem item = {.label = icon_pack_name, .payload = icon_pack_path, .action = action};
 
                 if (is_file(preview_path))
-                    strncpy(item.preview_path, preview_path, STR_MAX - 1);
+                    item.preview_path = preview_path;
 
                 list_addItem(list, item);
                 count++;
@@ -209,6 +207,7 @@ void menu_icon_packs(void *_)
                         _action_apply_icon_pack, true, NULL);
 
         list_sortByLabel(&_menu_icon_packs);
+        list_prefetchPreviews(&_menu_icon_packs, ICONS_PREVIEW_CACHE);
 
         char selected_path[STR_MAX];
         realpath(is_dir(active_icon_pack) ? active_icon_pack
@@ -274,12 +273,14 @@ bool _add_config_icon(const char *path, const char *name,
     str_trim(short_label, 55, label, false);
     short_label[56] = 0;
 
+    char item_label[STR_MAX];
     if (mode != ICON_MODE_APP)
-        snprintf(item.label, STR_MAX - 1, "%s (%s)", short_label, icon_name);
+        snprintf(item_label, STR_MAX - 1, "%s (%s)", short_label, icon_name);
     else {
-        strncpy(item.label, short_label, STR_MAX - 1);
-        strncpy(item.description, icon_name, STR_MAX - 1);
+        strncpy(item_label, short_label, STR_MAX - 1);
+        item.description = icon_name;
     }
+    item.label = item_label;
 
     IconInfo_t *info = &icon_infos[icon_infos_len++];
     strcpy(info->name, icon_name);
@@ -288,7 +289,7 @@ bool _add_config_icon(const char *path, const char *name,
     item.payload_ptr = (void *)info;
 
     if (mode != ICON_MODE_APP)
-        strncpy(item.preview_path, preview_path, STR_MAX - 1);
+        item.preview_path = preview_path;
     else
         item.icon_ptr = (void *)IMG_Load(preview_path);
 
@@ -348,11 +349,7 @@ void _menu_temp_action(void *_item)
         strcpy(info->path, item->preview_path);
 
         if (mode != ICON_MODE_APP) {
-            strcpy(temp_action_item->preview_path, item->preview_path);
-            if (temp_action_item->preview_ptr != NULL) {
-                SDL_FreeSurface((SDL_Surface *)temp_action_item->preview_ptr);
-                temp_action_item->preview_ptr = NULL;
-            }
+            list_setItemPreview(menu_stack[menu_level - 1], temp_action_item, item->preview_path);
         }
         else {
             if (temp_action_item->icon_ptr != NULL)
@@ -394,6 +391,7 @@ void _menu_change_icon(ListItem *item, IconMode_e mode)
                     required_icon);
 
     list_sortByLabel(&_menu_temp);
+    list_prefetchPreviews(&_menu_temp, ICONS_PREVIEW_CACHE);
 
     char selected_path[STR_MAX];
     realpath(info->path, selected_path);
@@ -433,6 +431,7 @@ void menu_console_icons(void *_)
                          &_menu_console_icons, menu_change_console_icon);
 
         list_sortByLabel(&_menu_console_icons);
+        list_prefetchPreviews(&_menu_console_icons, ICONS_PREVIEW_CACHE);
     }
     menu_stack[++menu_level] = &_menu_console_icons;
     header_changed = true;
@@ -477,6 +476,7 @@ void menu_expert_icons(void *_)
                           menu_change_expert_icon);
 
         list_sortByLabel(&_menu_expert_icons);
+        list_prefetchPreviews(&_menu_expert_icons, ICONS_PREVIEW_CACHE);
     }
     menu_stack[++menu_level] = &_menu_expert_icons;
     header_changed = true;
@@ -46,7 +46,7 @@ void menu_systemStartup(void *_)
                                      .label = "Start application",
                                      .item_type = MULTIVALUE,
                                      .value_max = 3,
-                                     .value_labels = {"MainUI", "GameSwitcher", "RetroArch", "AdvanceMENU"},
+                                     .value_labels = LIST_VALUE_LABELS("MainUI", "GameSwitcher", "RetroArch", "AdvanceMENU"),
                                      .value = settings.startup_application,
                                      .action = action_setStartupApplication},
                                  "With this option you can choose which\n"
@@ -76,14 +76,14 @@ void menu_systemDisplay(void *_)
     header_changed = true;
 }
 
-bool _writeDateString(char *label_out)
+bool _writeDateString(ListItem *item)
 {
     char new_label[STR_MAX];
     time_t t = time(NULL);
     struct tm tm = *localtime(&t);
     strftime(new_label, STR_MAX - 1, "Now: %Y-%m-%d %H:%M:%S", &tm);
-    if (strncmp(new_label, label_out, STR_MAX) != 0) {
-        strcpy(label_out, new_label);
+    if (strncmp(new_label, item->label, STR_MAX) != 0) {
+        list_setItemText(item, &item->label, new_label);
         return true;
     }
     return false;
@@ -164,7 +164,7 @@ void menu_datetime(void *_)
                                  "This option lets you add a specific amount\n"
                                  "of hours at startup.");
     }
-    _writeDateString(_menu_date_time.items[0].label);
+    _writeDateString(&_menu_date_time.items[0]);
     menu_stack[++menu_level] = &_menu_date_time;
     header_changed = true;
 }
@@ -211,7 +211,7 @@ void menu_system(void *_)
                                      .label = "Vibration intensity",
                                      .item_type = MULTIVALUE,
                                      .value_max = 3,
-                                     .value_labels = {"Off", "Low", "Normal", "High"},
+                                     .value_labels = LIST_VALUE_LABELS("Off", "Low", "Normal", "High"),
                                      .value = settings.vibration,
                                      .action = action_setVibration},
                                  "Set the vibration strength for haptic\n"
@@ -353,7 +353,7 @@ void menu_buttonAction(void *_)
                                      .label = "Power single press",
                                      .item_type = MULTIVALUE,
                                      .value_max = 1,
-                                     .value_labels = {"Standby", "Shutdown"},
+                                     .value_labels = LIST_VALUE_LABELS("Standby", "Shutdown"),
                                      .value = (int)settings.disable_standby,
                                      .action = action_setDisableStandby},
                                  "Change the power button single press\n"
@@ -396,7 +396,7 @@ void menu_batteryPercentage(void *_)
                          .label = "Text alignment",
                          .item_type = MULTIVALUE,
                          .value_max = 3,
-                         .value_labels = {"-", "Left", "Center", "Right"},
+                         .value_labels = LIST_VALUE_LABELS("-", "Left", "Center", "Right"),
                          .value = value_batteryPercentagePosition(),
                          .action = action_batteryPercentagePosition});
         list_addItem(&_menu_battery_percentage,
@@ -546,10 +546,9 @@ void menu_blueLight(void *_)
         }
     }
     if (DEVICE_ID == MIYOO354) {
-        _writeDateString(_menu_user_blue_light.items[0].label);
-        char scheduleToggleLabel[100];
-        strcpy(scheduleToggleLabel, exists("/tmp/.blfIgnoreSchedule") ? "Schedule (ignored)" : "Schedule");
-        strcpy(_menu_user_blue_light.items[2].label, scheduleToggleLabel);
+        _writeDateString(&_menu_user_blue_light.items[0]);
+        const char *scheduleToggleLabel = exists("/tmp/.blfIgnoreSchedule") ? "Schedule (ignored)" : "Schedule";
+        list_setItemText(&_menu_user_blue_light.items[2], &_menu_user_blue_light.items[2].label, scheduleToggleLabel);
     }
     menu_stack[++menu_level] = &_menu_user_blue_light;
     header_changed = true;
@@ -665,8 +664,10 @@ void menu_diagnostics(void *pt)
                                  "Logs will be generated in, \n"
                                  "SD: /.tmp_update/logs.");
         for (int i = 0; i < diags_numScripts; i++) {
+            char diagLabel[DIAG_MAX_LABEL_LENGTH];
             ListItem diagItem = {
-                .label = "",
+                .label = diagLabel,
+                .sticky_note = "Idle: Selected script not running",
                 .payload_ptr = &scripts[i].filename,
                 .action = action_runDiagnosticScript,
             };
@@ -679,8 +680,7 @@ void menu_diagnostics(void *pt)
                 prefix = "Fix: ";
             }
 
-            snprintf(diagItem.label, DIAG_MAX_LABEL_LENGTH - 1, "%s%.62s", prefix, scripts[i].label);
-            strncpy(diagItem.sticky_note, "Idle: Selected script not running", STR_MAX - 1);
+            snprintf(diagLabel, DIAG_MAX_LABEL_LENGTH - 1, "%s%.62s", prefix, scripts[i].label);
 
             char *parsed_Tooltip = diags_parseNewLines(scripts[i].tooltip);
             list_addItemWithInfoNote(&_menu_diagnostics, diagItem, parsed_Tooltip);
@@ -710,8 +710,8 @@ void menu_advanced(void *_)
                                          .label = "Brightness control",
                                          .item_type = MULTIVALUE,
                                          .value_max = 1,
-                                         .value_labels = {"SELECT+R2/L2",
-                                                          "MENU+UP/DOWN"},
+                                         .value_labels = LIST_VALUE_LABELS("SELECT+R2/L2",
+                                                                           "MENU+UP/DOWN"),
                                          .value = config_flag_get(".altBrightness"),
                                          .action = action_setAltBrightness},
                                      "Change the shortcut for brightness.");
@@ -742,7 +742,7 @@ void menu_advanced(void *_)
                                          .label = "LCD undervolt",
                                          .item_type = MULTIVALUE,
                                          .value_max = 4,
-                                         .value_labels = {"Off", "-0.1V", "-0.2V", "-0.3V", "-0.4V"},
+                                         .value_labels = LIST_VALUE_LABELS("Off", "-0.1V", "-0.2V", "-0.3V", "-0.4V"),
                                          .value = value_getLcdVoltage(),
                                          .action = action_advancedSetLcdVoltage},
                                      "Use this option if you're seeing\n"
@@ -824,8 +824,7 @@ void menu_screen_recorder(void *pt)
 
     int isRecordingActive = exists("/tmp/recorder_active");
     const char *recordingStatus = isRecordingActive ? "Status: Now recording..." : "Status: Idle.";
-    strncpy(_menu_screen_recorder.items[0].sticky_note, recordingStatus, sizeof(_menu_screen_recorder.items[0].sticky_note) - 1);
-    _menu_screen_recorder.items[0].sticky_note[sizeof(_menu_screen_recorder.items[0].sticky_note) - 1] = '\0';
+    list_updateStickyNote(&_menu_screen_recorder.items[0], recordingStatus);
     menu_stack[++menu_level] = &_menu_screen_recorder;
     header_changed = true;
 }
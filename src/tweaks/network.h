@@ -369,20 +369,19 @@ void network_setTzSelectState(void *pt)
 
 void network_toggleVNC(void *pt)
 {
-    char command_start[STR_MAX];
-    char command_stop[STR_MAX];
+    char args[STR_MAX];
 
     int new_fps = (int)network_state.vncfps;
 
-    sprintf(command_start, "/mnt/SDCARD/.tmp_update/bin/vncserver -k /dev/input/event0 -F %d -r 180 > /dev/null 2>&1 &", new_fps);
-    sprintf(command_stop, "killall -9 vncserver");
+    sprintf(args, "-k /dev/input/event0 -F %d -r 180 > /dev/null 2>&1", new_fps);
 
+    // process_start/process_killall keep the process snapshot up to date
     if (!network_state.vncserv) {
         network_state.vncserv = true;
         network_setState(&network_state.vncserv, ".vncServer", true);
         reset_menus = true;
         if (!process_isRunning("vncserver")) {
-            system(command_start);
+            process_start("vncserver", args, "/mnt/SDCARD/.tmp_update", false);
         }
     }
     else {
@@ -390,7 +389,7 @@ void network_toggleVNC(void *pt)
         network_setState(&network_state.vncserv, ".vncServer", false);
         reset_menus = true;
         if (process_isRunning("vncserver")) {
-            system(command_stop);
+            process_killall("vncserver");
         }
     }
 }
@@ -428,15 +427,17 @@ void menu_smbd(void *pt)
                                  item->info_note);
 
         for (int i = 0; i < network_numShares; i++) {
+            char shareLabel[STR_MAX];
             ListItem shareItem = {
+                .label = shareLabel,
+                .sticky_note = str_replace(_network_shares[i].path, "/mnt/SDCARD", "SD:"),
                 .item_type = TOGGLE,
                 .disabled = !network_state.smbd,
                 .action = network_toggleSmbAvailable, // set the action to the wrapper function
                 .value = _network_shares[i].available,
                 .payload_ptr = _network_shares + i // store a pointer to the share in the payload
             };
-            snprintf(shareItem.label, STR_MAX - 1, "Share: %s", _network_shares[i].name);
-            strncpy(shareItem.sticky_note, str_replace(_network_shares[i].path, "/mnt/SDCARD", "SD:"), STR_MAX - 1);
+            snprintf(shareLabel, STR_MAX - 1, "Share: %s", _network_shares[i].name);
             list_addItem(&_menu_smbd, shareItem);
         }
     }
@@ -616,7 +617,7 @@ void menu_wifi(void *_)
         //                  .label = "WPS...",
         //                  .action = menu_wps});
     }
-    strcpy(_menu_wifi.items[0].label, ip_address_label);
+    list_setItemText(&_menu_wifi.items[0], &_menu_wifi.items[0].label, ip_address_label);
     menu_stack[++menu_level] = &_menu_wifi;
     header_changed = true;
 }
@@ -726,7 +727,7 @@ void menu_network(void *_)
                                  "This helps to conserve battery and\n"
                                  "to keep performance at a maximum.");
     }
-    strcpy(_menu_network.items[0].label, ip_address_label);
+    list_setItemText(&_menu_network.items[0], &_menu_network.items[0].label, ip_address_label);
     menu_stack[++menu_level] = &_menu_network;
     header_changed = true;
 }
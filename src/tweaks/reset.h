@@ -5,6 +5,7 @@
 
 #include "system/device_model.h"
 #include "system/keymap_sw.h"
+#include "theme/compile.h"
 #include "theme/render/dialog.h"
 #include "theme/sound.h"
 
@@ -91,6 +92,7 @@ void action_resetThemeOverrides(void *pt)
     if (!_disable_confirm && !_confirmReset(title_str, "Are you sure you want to\nreset theme overrides?"))
         return;
     system("rm -rf /mnt/SDCARD/Saves/CurrentProfile/theme/*");
+    theme_compile(theme()->path);
     if (!_disable_confirm)
         _notifyResetDone(title_str);
 }
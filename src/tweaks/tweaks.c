@@ -199,18 +199,22 @@ int main(int argc, char *argv[])
         if (battery_hasChanged(ticks, &battery_percentage))
             battery_changed = true;
 
+        // A preview finished loading in the background
+        if (list_previewLoaded(menu_stack[menu_level]))
+            list_changed = true;
+
         blf_changing = exists("/tmp/blue_light_script.lock");
 
         if (acc_ticks >= time_step) {
             if (isMenu(&_menu_date_time) || isMenu(&_menu_user_blue_light)) {
                 if (isMenu(&_menu_date_time)) {
-                    if (_writeDateString(_menu_date_time.items[0].label)) {
+                    if (_writeDateString(&_menu_date_time.items[0])) {
                         list_changed = true;
                     }
                 }
                 if (DEVICE_ID == MIYOO354) {
                     if (isMenu(&_menu_user_blue_light)) {
-                        if (_writeDateString(_menu_user_blue_light.items[0].label)) {
+                        if (_writeDateString(&_menu_user_blue_light.items[0])) {
                             list_changed = true;
                         }
                     }
@@ -220,9 +224,9 @@ int main(int argc, char *argv[])
                 network_loadState();
                 if (netinfo_getIpAddress(ip_address_label, network_state.hotspot ? "wlan1" : "wlan0")) {
                     if (_menu_network._created)
-                        strcpy(_menu_network.items[0].label, ip_address_label);
+                        list_setItemText(&_menu_network.items[0], &_menu_network.items[0].label, ip_address_label);
                     if (_menu_wifi._created)
-                        strcpy(_menu_wifi.items[0].label, ip_address_label);
+                        list_setItemText(&_menu_wifi.items[0], &_menu_wifi.items[0].label, ip_address_label);
                     list_changed = true;
                 }
             }
@@ -453,6 +453,8 @@ launch_game_postprocess() {
 
         cd $sysdir
         playActivity stop "$rompath"
+        # Builds the cache lookup index off the UI path
+        playActivity index_cache "$rompath" > /dev/null 2>&1 &
 
         if [ -f /tmp/.lowBat ]; then
             bootScreen lowBat
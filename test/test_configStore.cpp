@@ -0,0 +1,180 @@
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+extern "C" {
+#include "utils/config.h"
+}
+
+static std::vector<std::string> changed_keys;
+
+static void onConfigChange(const char *key) { changed_keys.push_back(key ? key : "*"); }
+
+class test_configStore : public ::testing::Test {
+protected:
+    char root[64];
+
+    void SetUp() override
+    {
+        strcpy(root, "/tmp/test_configStore_XXXXXX");
+        ASSERT_NE(mkdtemp(root), nullptr);
+        sprintf(config_store_root, "%s/config/", root);
+        sprintf(config_store_path, "%s/config.store", root);
+        mkdir(config_store_root, 0755);
+        config_store_reset();
+        changed_keys.clear();
+
+        writeFile(".showRecents", "");
+        writeFile("vibration", "2");
+        writeFile("battery/warnAt", "15");
+        writeFile("display/blueLightTime", "20:00\n");
+    }
+
+    void TearDown() override
+    {
+        config_store_reset();
+        std::string cmd = std::string("rm -rf ") + root;
+        system(cmd.c_str());
+    }
+
+    void writeFile(const char *key, const char *value)
+    {
+        std::string path = std::string(config_store_root) + key;
+        std::string dir = path.substr(0, path.rfind('/'));
+        mkdirs(dir.c_str());
+        FILE *fp = fopen(path.c_str(), "w");
+        fputs(value, fp);
+        fclose(fp);
+    }
+
+    std::string readFile(const char *path)
+    {
+        const char *data = file_read(path);
+        std::string result = data ? data : "";
+        free((void *)data);
+        return result;
+    }
+
+    void waitRecheck() { usleep((CONFIG_STORE_RECHECK_MS + 20) * 1000); }
+};
+
+TEST_F(test_configStore, readsLegacyLayout)
+{
+    int value = 0;
+    char str[STR_MAX] = "";
+
+    EXPECT_TRUE(config_flag_get(".showRecents"));
+    EXPECT_FALSE(config_flag_get(".showExpert"));
+    EXPECT_TRUE(config_get("vibration", CONFIG_INT, &value));
+    EXPECT_EQ(value, 2);
+    EXPECT_TRUE(config_get("battery/warnAt", CONFIG_INT, &value));
+    EXPECT_EQ(value, 15);
+    EXPECT_TRUE(config_get("display/blueLightTime", CONFIG_STR, str));
+    EXPECT_STREQ(str, "20:00");
+    EXPECT_FALSE(config_get("battery/exitAt", CONFIG_INT, &value));
+    EXPECT_FALSE(config_get("missing/key", CONFIG_INT, &value));
+}
+
+TEST_F(test_configStore, writesThroughToLegacyFiles)
+{
+    config_setNumber("battery/warnAt", 25);
+    config_setString("startup/time", (char *)"08:30");
+    config_flag_set(".showExpert", true);
+
+    EXPECT_EQ(readFile((std::string(config_store_root) + "battery/warnAt").c_str()), "25");
+    EXPECT_EQ(readFile((std::string(config_store_root) + "startup/time").c_str()), "08:30");
+    EXPECT_TRUE(exists((std::string(config_store_root) + ".showExpert").c_str()));
+    EXPECT_FALSE(exists((std::string(config_store_root) + ".showExpert_").c_str()));
+
+    config_flag_set(".showExpert", false);
+    EXPECT_FALSE(config_flag_get(".showExpert"));
+    EXPECT_TRUE(config_flag_get(".showExpert_"));
+}
+
+TEST_F(test_configStore, picksUpExternalChanges)
+{
+    int value = 0;
+    EXPECT_TRUE(config_get("battery/warnAt", CONFIG_INT, &value));
+    EXPECT_FALSE(config_flag_get(".bgmMute"));
+
+    // What the shell scripts do
+    writeFile("battery/warnAt", "5");
+    writeFile(".bgmMute", "");
+    remove((std::string(config_store_root) + ".showRecents").c_str());
+    waitRecheck();
+
+    EXPECT_TRUE(config_get("battery/warnAt", CONFIG_INT, &value));
+    EXPECT_EQ(value, 5);
+    EXPECT_TRUE(config_flag_get(".bgmMute"));
+    EXPECT_FALSE(config_flag_get(".showRecents"));
+}
+
+TEST_F(test_configStore, persistsIndex)
+{
+    int value = 0;
+    config_get("vibration", CONFIG_INT, &value);
+    config_flag_get(".showRecents");
+    config_store_save();
+
+    std::string index = readFile(config_store_path);
+    EXPECT_EQ(index.find(CONFIG_STORE_MAGIC "\n"), 0);
+    EXPECT_NE(index.find("\tvibration\t2\n"), std::string::npos);
+    EXPECT_NE(index.find("p\t.showRecents\n"), std::string::npos);
+    EXPECT_NE(index.find("end\n"), std::string::npos);
+
+    // Loaded from the index
+    config_store_reset();
+    value = 0;
+    EXPECT_TRUE(config_get("vibration", CONFIG_INT, &value));
+    EXPECT_EQ(value, 2);
+    EXPECT_TRUE(config_flag_get(".showRecents"));
+}
+
+TEST_F(test_configStore, escapesValues)
+{
+    char str[STR_MAX] = "";
+    writeFile("multiline", "a\tb\\c\nsecond");
+
+    EXPECT_TRUE(config_get("multiline", CONFIG_STR, str));
+    config_store_save();
+    config_store_reset();
+
+    str[0] = '\0';
+    EXPECT_TRUE(config_get("multiline", CONFIG_STR, str));
+    EXPECT_STREQ(str, "a\tb\\c");
+}
+
+TEST_F(test_configStore, ignoresTruncatedIndex)
+{
+    int value = 0;
+    FILE *fp = fopen(config_store_path, "w");
+    fputs(CONFIG_STORE_MAGIC "\nf\t1\t1\tvibration\t9\n", fp);
+    fclose(fp);
+
+    EXPECT_TRUE(config_get("vibration", CONFIG_INT, &value));
+    EXPECT_EQ(value, 2);
+}
+
+TEST_F(test_configStore, notifiesChanges)
+{
+    int value = 0;
+    config_store_onChange(onConfigChange);
+    config_get("battery/warnAt", CONFIG_INT, &value);
+    config_flag_get(".bgmMute");
+    EXPECT_TRUE(changed_keys.empty());
+
+    config_setNumber("battery/warnAt", 30);
+    config_setNumber("battery/warnAt", 30);
+    ASSERT_EQ(changed_keys.size(), 1);
+    EXPECT_EQ(changed_keys[0], "battery/warnAt");
+
+    changed_keys.clear();
+    writeFile(".bgmMute", "");
+    waitRecheck();
+    EXPECT_TRUE(config_flag_get(".bgmMute"));
+    ASSERT_EQ(changed_keys.size(), 1);
+    EXPECT_EQ(changed_keys[0], ".bgmMute");
+}
@@ -0,0 +1,257 @@
+#include "gtest/gtest.h"
+
+#include <SDL/SDL.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#include "utils/imageCache.h"
+}
+
+#define TOTAL 200
+
+// Images are 4x4, filled with their index and the version of their source
+struct Source {
+    std::atomic<int> version[TOTAL];
+    std::atomic<int> loads[TOTAL];
+    std::atomic<int> delay_us{0};
+};
+
+static uint32_t imageValue(int index, int version) { return index << 8 | version; }
+
+static SDL_Surface *loadImage(int index, void *userdata)
+{
+    Source *source = (Source *)userdata;
+    source->loads[index]++;
+    if (source->delay_us > 0)
+        usleep(source->delay_us);
+
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, 4, 4, 32, 0xFF0000, 0xFF00, 0xFF, 0);
+    uint32_t value = imageValue(index, source->version[index]);
+    for (int i = 0; i < 16; i++)
+        ((uint32_t *)surface->pixels)[i] = value;
+    return surface;
+}
+
+static uint32_t pixel(SDL_Surface *surface) { return ((uint32_t *)surface->pixels)[15]; }
+
+// Counters are written by the worker, under the lock
+static uint32_t locked(ImageCache *cache, uint32_t *counter)
+{
+    pthread_mutex_lock(&cache->lock);
+    uint32_t value = *counter;
+    pthread_mutex_unlock(&cache->lock);
+    return value;
+}
+
+static int refcount(ImageCache *cache, SDL_Surface *surface)
+{
+    pthread_mutex_lock(&cache->lock);
+    int value = surface->refcount;
+    pthread_mutex_unlock(&cache->lock);
+    return value;
+}
+
+static bool waitLoaded(ImageCache *cache, int index)
+{
+    for (int i = 0; i < 2000 && !imageCache_isLoaded(cache, index); i++)
+        usleep(1000);
+    return imageCache_isLoaded(cache, index);
+}
+
+class test_imageCache : public ::testing::Test {
+  protected:
+    Source source;
+
+    void SetUp() override
+    {
+        for (int i = 0; i < TOTAL; i++) {
+            source.version[i] = 0;
+            source.loads[i] = 0;
+        }
+    }
+
+    int loadsBetween(int start, int end)
+    {
+        int count = 0;
+        for (int i = start; i <= end; i++)
+            count += source.loads[i];
+        return count;
+    }
+};
+
+TEST_F(test_imageCache, prefetchesAroundFocus)
+{
+    ImageCache *cache = imageCache_create(5, TOTAL, loadImage, &source);
+    ASSERT_NE(cache, nullptr);
+
+    // Nothing before the first focus
+    usleep(10000);
+    EXPECT_EQ(loadsBetween(0, TOTAL - 1), 0);
+
+    imageCache_focus(cache, 50);
+    SDL_Surface *surface = imageCache_acquireWait(cache, 50);
+    ASSERT_NE(surface, nullptr);
+    EXPECT_EQ(pixel(surface), imageValue(50, 0));
+    imageCache_release(cache, surface);
+
+    for (int i = 48; i <= 52; i++)
+        EXPECT_TRUE(waitLoaded(cache, i)) << i;
+    EXPECT_EQ(loadsBetween(0, TOTAL - 1), 5);
+
+    // Clamped at the ends, the window stays full
+    imageCache_focus(cache, TOTAL - 1);
+    for (int i = TOTAL - 5; i < TOTAL; i++)
+        EXPECT_TRUE(waitLoaded(cache, i)) << i;
+
+    imageCache_free(cache);
+}
+
+TEST_F(test_imageCache, leansTowardsScrolling)
+{
+    ImageCache *cache = imageCache_create(7, TOTAL, loadImage, &source);
+
+    for (int i = 20; i <= 24; i++)
+        imageCache_focus(cache, i);
+
+    // Scrolling forward fast: the window is ahead, but for one
+    EXPECT_EQ(cache->window_start, 23);
+    EXPECT_EQ(cache->window_end, 29);
+    EXPECT_TRUE(waitLoaded(cache, 29));
+
+    // Then back: it turns around
+    imageCache_focus(cache, 23);
+    imageCache_focus(cache, 22);
+    EXPECT_EQ(cache->direction, -1);
+    EXPECT_EQ(cache->window_start, 17);
+    EXPECT_EQ(cache->window_end, 23);
+    EXPECT_TRUE(waitLoaded(cache, 17));
+
+    imageCache_free(cache);
+}
+
+TEST_F(test_imageCache, jumpDropsStaleLoads)
+{
+    source.delay_us = 20000;
+    ImageCache *cache = imageCache_create(9, TOTAL, loadImage, &source);
+
+    imageCache_focus(cache, 10);
+    usleep(5000); // 10 is being loaded
+    imageCache_focus(cache, 150);
+
+    SDL_Surface *surface = imageCache_acquireWait(cache, 150);
+    ASSERT_NE(surface, nullptr);
+    imageCache_release(cache, surface);
+
+    // Only the load that was in flight, and its result was dropped
+    EXPECT_EQ(loadsBetween(0, 100), 1);
+    EXPECT_FALSE(imageCache_isLoaded(cache, 10));
+    EXPECT_EQ(locked(cache, &cache->discarded), 1u);
+
+    imageCache_free(cache);
+}
+
+TEST_F(test_imageCache, acquiredOutlivesEviction)
+{
+    ImageCache *cache = imageCache_create(3, TOTAL, loadImage, &source);
+
+    imageCache_focus(cache, 0);
+    SDL_Surface *surface = imageCache_acquireWait(cache, 0);
+    ASSERT_NE(surface, nullptr);
+    EXPECT_EQ(refcount(cache, surface), 2);
+
+    imageCache_focus(cache, 99);
+    EXPECT_TRUE(waitLoaded(cache, 99));
+    for (int i = 98; i <= 100; i++)
+        EXPECT_TRUE(waitLoaded(cache, i));
+
+    // Evicted, still ours
+    EXPECT_FALSE(imageCache_isLoaded(cache, 0));
+    EXPECT_EQ(refcount(cache, surface), 1);
+    EXPECT_EQ(pixel(surface), imageValue(0, 0));
+    imageCache_release(cache, surface);
+
+    imageCache_free(cache);
+}
+
+TEST_F(test_imageCache, invalidateReloads)
+{
+    ImageCache *cache = imageCache_create(5, TOTAL, loadImage, &source);
+
+    imageCache_focus(cache, 7);
+    SDL_Surface *surface = imageCache_acquireWait(cache, 7);
+    imageCache_release(cache, surface);
+
+    imageCache_invalidate(cache, 7);
+    source.version[7] = 1;
+    usleep(10000);
+    // Held off until the next focus
+    EXPECT_EQ(imageCache_acquire(cache, 7), nullptr);
+
+    imageCache_focus(cache, 7);
+    surface = imageCache_acquireWait(cache, 7);
+    ASSERT_NE(surface, nullptr);
+    EXPECT_EQ(pixel(surface), imageValue(7, 1));
+    imageCache_release(cache, surface);
+
+    imageCache_free(cache);
+}
+
+// Meant to run under -fsanitize=thread (and address) as well
+TEST_F(test_imageCache, stress)
+{
+    ImageCache *cache = imageCache_create(7, TOTAL, loadImage, &source);
+    std::atomic<int> mismatches{0};
+    std::atomic<int> hits{0};
+
+    source.delay_us = 50;
+
+    auto browse = [&](unsigned seed, bool invalidates) {
+        std::mt19937 rng(seed);
+        int focus = rng() % TOTAL;
+
+        for (int i = 0; i < 3000; i++) {
+            int move = rng() % 10;
+            if (move < 7)
+                focus += (rng() % 2) ? 1 : -1; // scrolling
+            else if (move < 9)
+                focus += (int)(rng() % 9) - 4;
+            else
+                focus = rng() % TOTAL; // jump
+            focus = focus < 0 ? 0 : focus >= TOTAL ? TOTAL - 1 : focus;
+
+            imageCache_focus(cache, focus);
+
+            SDL_Surface *surface = (rng() % 50 == 0) ? imageCache_acquireWait(cache, focus)
+                                                     : imageCache_acquire(cache, focus);
+            if (surface != NULL) {
+                hits++;
+                if ((pixel(surface) >> 8) != (uint32_t)focus)
+                    mismatches++;
+                if (rng() % 4 == 0)
+                    usleep(20);
+                imageCache_release(cache, surface);
+            }
+
+            if (invalidates && rng() % 100 == 0)
+                imageCache_invalidate(cache, focus);
+
+            usleep(rng() % 100); // a frame
+        }
+    };
+
+    std::thread other(browse, 2, false);
+    browse(1, true);
+    other.join();
+
+    printf("image cache stress: %d hits, %u loads, %u discarded\n", hits.load(),
+           locked(cache, &cache->loads), locked(cache, &cache->discarded));
+    EXPECT_EQ(mismatches, 0);
+    EXPECT_GT(hits, 0);
+
+    imageCache_free(cache);
+}
@@ -0,0 +1,180 @@
+#include "gtest/gtest.h"
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_image.h>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+extern "C" {
+#include "utils/imageWriter.h"
+}
+
+#define TEST_DIR "/tmp/test_imageWriter"
+
+// A screenshot-like frame: flat areas, gradients and some noise
+static std::vector<uint32_t> makeFrame(int width, int height)
+{
+    std::vector<uint32_t> pixels(width * height);
+    uint32_t seed = 1;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t r = y < height / 3 ? 40 : (x * 255 / width);
+            uint32_t g = (y * 255 / height);
+            uint32_t b = (x / 16 + y / 16) % 2 ? 200 : (seed >> 24) & 0x3F;
+            uint32_t a = x % 7 == 0 ? 0 : 0xFF;
+            pixels[y * width + x] = a << 24 | r << 16 | g << 8 | b;
+        }
+    }
+    return pixels;
+}
+
+static long fileSize(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+class test_imageWriter : public ::testing::Test {
+  protected:
+    void SetUp() override { mkdir(TEST_DIR, 0777); }
+    void TearDown() override { system("rm -rf " TEST_DIR); }
+};
+
+TEST_F(test_imageWriter, swizzle)
+{
+    const int width = 37; // vector body and scalar tail
+    std::vector<uint32_t> src = makeFrame(width, 1);
+    std::vector<uint8_t> rgba(width * 4), rgb(width * 3);
+
+    for (bool reverse : {false, true}) {
+        image_swizzleRGBA(rgba.data(), src.data(), width, reverse, true);
+        image_swizzleRGB(rgb.data(), src.data(), width, reverse);
+
+        for (int i = 0; i < width; i++) {
+            uint32_t pix = src[reverse ? width - 1 - i : i];
+            uint32_t cleared = pix & 0xFF000000 ? pix : 0;
+            EXPECT_EQ(rgba[i * 4 + 0], (uint8_t)(cleared >> 16));
+            EXPECT_EQ(rgba[i * 4 + 1], (uint8_t)(cleared >> 8));
+            EXPECT_EQ(rgba[i * 4 + 2], (uint8_t)cleared);
+            EXPECT_EQ(rgba[i * 4 + 3], (uint8_t)(pix >> 24));
+            EXPECT_EQ(rgb[i * 3 + 0], (uint8_t)(pix >> 16));
+            EXPECT_EQ(rgb[i * 3 + 1], (uint8_t)(pix >> 8));
+            EXPECT_EQ(rgb[i * 3 + 2], (uint8_t)pix);
+        }
+    }
+}
+
+TEST_F(test_imageWriter, pngRgbRotated)
+{
+    const int width = 67, height = 41;
+    std::vector<uint32_t> frame = makeFrame(width, height);
+    ImageWriterOptions options = {IMAGE_PNG_RGB, 2, PNG_FILTER_UP, true, false};
+
+    ASSERT_TRUE(image_write(TEST_DIR "/rgb.png", frame.data(), width, height, width * 4, &options));
+    EXPECT_EQ(fileSize(TEST_DIR "/rgb.png.tmp"), -1);
+
+    SDL_Surface *image = IMG_Load(TEST_DIR "/rgb.png");
+    ASSERT_NE(image, nullptr);
+    ASSERT_EQ(image->w, width);
+    ASSERT_EQ(image->h, height);
+    int bytes_per_pixel = image->format->BytesPerPixel;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = (const uint8_t *)image->pixels + y * image->pitch;
+        for (int x = 0; x < width; x++) {
+            uint32_t pix = frame[(height - 1 - y) * width + (width - 1 - x)];
+            Uint32 value = 0;
+            Uint8 r, g, b;
+            memcpy(&value, row + x * bytes_per_pixel, bytes_per_pixel);
+            SDL_GetRGB(value, image->format, &r, &g, &b);
+            ASSERT_EQ((uint32_t)(r << 16 | g << 8 | b), pix & 0xFFFFFF) << x << "," << y;
+        }
+    }
+
+    SDL_FreeSurface(image);
+}
+
+TEST_F(test_imageWriter, rawLz4RoundTrip)
+{
+    const int width = 120, height = 90;
+    std::vector<uint32_t> frame = makeFrame(width, height);
+    std::string src_path = TEST_DIR "/screen.png";
+    fclose(fopen(src_path.c_str(), "wb"));
+
+    for (ImageFormat format : {IMAGE_RAW, IMAGE_RAW_LZ4}) {
+        ImageWriterOptions options = {format, -1, 0, true, false};
+        ASSERT_TRUE(image_write(src_path.c_str(), frame.data(), width, height, width * 4, &options));
+
+        RawImage raw;
+        ASSERT_TRUE(raw_image_map(src_path.c_str(), &raw));
+        EXPECT_EQ(raw.header->compression, format == IMAGE_RAW_LZ4 ? RAW_IMAGE_LZ4 : RAW_IMAGE_UNCOMPRESSED);
+        ASSERT_EQ(raw.header->width, (uint32_t)width);
+        ASSERT_EQ(raw.header->height, (uint32_t)height);
+
+        const uint32_t *pixels = (const uint32_t *)raw.pixels;
+        for (int i = 0; i < width * height; i++)
+            ASSERT_EQ(pixels[i], 0xFF000000 | frame[width * height - 1 - i]) << i;
+
+        raw_image_unmap(&raw);
+    }
+}
+
+TEST_F(test_imageWriter, lz4RejectsCorruptBlocks)
+{
+    std::vector<uint8_t> src(4096);
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (uint8_t)(i / 64);
+
+    std::vector<uint8_t> compressed(lz4_compressBound(src.size()));
+    size_t size = lz4_compress(src.data(), src.size(), compressed.data(), compressed.size());
+    ASSERT_GT(size, 0u);
+    ASSERT_LT(size, src.size());
+
+    std::vector<uint8_t> out(src.size());
+    ASSERT_TRUE(lz4_decompress(compressed.data(), size, out.data(), out.size()));
+    EXPECT_EQ(out, src);
+
+    EXPECT_FALSE(lz4_decompress(compressed.data(), size - 1, out.data(), out.size()));
+    EXPECT_FALSE(lz4_decompress(compressed.data(), size, out.data(), out.size() - 1));
+}
+
+// Benchmark, not run by default: --gtest_also_run_disabled_tests
+TEST_F(test_imageWriter, DISABLED_benchmark)
+{
+    typedef std::chrono::steady_clock Clock;
+    const int width = 640, height = 480, iterations = 5;
+    std::vector<uint32_t> frame = makeFrame(width, height);
+    std::string src_path = TEST_DIR "/bench.png";
+
+    struct {
+        const char *name;
+        ImageWriterOptions options;
+    } modes[] = {
+        {"png rgba default", {IMAGE_PNG_RGBA, -1, 0, true, false}},
+        {"png rgb default", {IMAGE_PNG_RGB, -1, 0, true, false}},
+        {"png rgb level 2 up", {IMAGE_PNG_RGB, 2, PNG_FILTER_UP, true, false}},
+        {"png rgb level 1 none", {IMAGE_PNG_RGB, 1, PNG_FILTER_NONE, true, false}},
+        {"raw", {IMAGE_RAW, -1, 0, true, false}},
+        {"raw lz4", {IMAGE_RAW_LZ4, -1, 0, true, false}},
+    };
+
+    fclose(fopen(src_path.c_str(), "wb"));
+
+    for (auto &mode : modes) {
+        bool raw = mode.options.format == IMAGE_RAW || mode.options.format == IMAGE_RAW_LZ4;
+        std::string path = raw ? TEST_DIR "/bench.png" : TEST_DIR "/out.png";
+        std::string out_path = raw ? TEST_DIR "/bench.raw" : path;
+
+        auto start = Clock::now();
+        for (int i = 0; i < iterations; i++)
+            ASSERT_TRUE(image_write(path.c_str(), frame.data(), width, height, width * 4, &mode.options));
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+
+        printf("image_write %-22s %8.2f ms %9ld bytes\n", mode.name, ms, fileSize(out_path));
+    }
+}
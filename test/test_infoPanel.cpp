@@ -1,11 +1,18 @@
 #include "gtest/gtest.h"
 
-#include <string>
 #include <SDL/SDL.h>
+#include <SDL/SDL_rotozoom.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unistd.h>
 
 #include "../src/infoPanel/imagesCache.h"
+#include "../src/infoPanel/imagesScale.h"
 
 #define STR_MAX 256
+#define IMAGES_COUNT 12
 
 typedef struct
 {
@@ -15,12 +22,57 @@ typedef struct
     std::string drawn_image_path;
 } TestItem;
 
-TEST(test_infoPanel, cacheTest)
+// Waits for the background prefetch to load an image
+static bool waitCached(int index)
+{
+    for (int i = 0; i < 2000 && !isImageCached(index); i++)
+        usleep(1000);
+    return isImageCached(index);
+}
+
+// Waits for the images around `index` that the cache keeps
+static void waitPrefetched(int index)
 {
+    for (int i = index - 2; i <= index + 2; i++)
+        if (i >= 0 && i < IMAGES_COUNT)
+            waitCached(i);
+}
+
+class test_infoPanel : public ::testing::Test {
+  protected:
     char **images_paths = NULL;
-    int images_paths_count = 5;
     SDL_Surface *screen = NULL;
 
+    // The 5 test pages, in turn
+    void SetUp() override
+    {
+        images_paths = (char **)malloc(IMAGES_COUNT * sizeof(char *));
+
+        for (int i = 0; i < IMAGES_COUNT; i++) {
+            images_paths[i] = (char *)malloc(STR_MAX * sizeof(char));
+            sprintf(images_paths[i], "./infoPanel_test_data/page%d.png", i % 5);
+        }
+
+        screen = SDL_CreateRGBSurface(SDL_SWSURFACE, 640, 480, 32, 0xFF0000, 0xFF00, 0xFF, 0);
+    }
+
+    void TearDown() override
+    {
+        cleanImagesCache();
+        for (int i = 0; i < IMAGES_COUNT; i++)
+            free(images_paths[i]);
+        free(images_paths);
+        SDL_FreeSurface(screen);
+    }
+
+    char *draw(int new_index, int initial_index, bool *cache_used, const SDL_Rect *frame = NULL)
+    {
+        return drawImageByIndex(new_index, initial_index, images_paths, IMAGES_COUNT, screen, frame, cache_used);
+    }
+};
+
+TEST_F(test_infoPanel, cacheTest)
+{
     const int test_data_count = 11;
     TestItem test_data[test_data_count];
     test_data[0] = { 0, -1, false, "" };
@@ -30,32 +82,21 @@ TEST(test_infoPanel, cacheTest)
     test_data[4] = { 1, 2, true, "./infoPanel_test_data/page2.png" };
     test_data[5] = { 2, 3, true, "./infoPanel_test_data/page3.png" };
     test_data[6] = { 3, 2, true, "./infoPanel_test_data/page2.png" };
-    test_data[7] = { 2, 4, false, "" }; // random jump is not yet implemented
-    test_data[8] = { 2, 3, true, "./infoPanel_test_data/page3.png" };
+    test_data[7] = { 2, 4, true, "./infoPanel_test_data/page4.png" }; // jump within the window
+    test_data[8] = { 4, 3, true, "./infoPanel_test_data/page3.png" };
     test_data[9] = { 3, 4, true, "./infoPanel_test_data/page4.png" };
-    test_data[10] = { 4, 5, false, "" };
+    test_data[10] = { 4, IMAGES_COUNT, false, "" };
 
-    images_paths = (char**)malloc(images_paths_count * sizeof(char*));
-
-	for (int i = 0; i < images_paths_count; i++)
-	{
-		images_paths[i] = (char*)malloc(STR_MAX * sizeof(char));
-
-		strcat(images_paths[i], "./infoPanel_test_data/page");
-        char index_str[10];
-        sprintf(index_str, "%d", i);
-        strcat(images_paths[i], index_str);
-        strcat(images_paths[i], ".png");
-	}
-
-    char* drawn_image_path = NULL;
+    char *drawn_image_path = NULL;
     for (int i = 0; i < test_data_count; i++)
     {
         printf("Entering test item #%d\n", i);
         const TestItem& test_item = test_data[i];
         bool cache_used = false;
-        drawn_image_path = drawImageByIndex(test_item.new_index, test_item.initial_index,
-            images_paths, images_paths_count, screen, NULL, &cache_used);
+        // Prefetched in the background by the time it's asked for
+        if (i > 1 && test_item.new_index < IMAGES_COUNT)
+            waitCached(test_item.new_index);
+        drawn_image_path = draw(test_item.new_index, test_item.initial_index, &cache_used);
 
         if (drawn_image_path != NULL)
         {
@@ -65,7 +106,293 @@ TEST(test_infoPanel, cacheTest)
         {
             ASSERT_EQ(test_item.drawn_image_path, "");
         }
-        
-        ASSERT_EQ(cache_used, test_item.cache_used);
+
+        ASSERT_EQ(cache_used, test_item.cache_used) << "test item #" << i;
+    }
+}
+
+TEST_F(test_infoPanel, jumps)
+{
+    bool cache_used = true;
+
+    ASSERT_NE(draw(0, 0, &cache_used), nullptr);
+    EXPECT_FALSE(cache_used);
+    waitPrefetched(0);
+
+    // Far: loaded on demand, then its neighbours are prefetched
+    EXPECT_STREQ(draw(9, 0, &cache_used), images_paths[9]);
+    EXPECT_FALSE(cache_used);
+    EXPECT_TRUE(isImageCached(9));
+    waitPrefetched(9);
+    EXPECT_TRUE(isImageCached(7));
+    EXPECT_TRUE(isImageCached(11));
+
+    // Near: served from the cache
+    EXPECT_STREQ(draw(7, 9, &cache_used), images_paths[7]);
+    EXPECT_TRUE(cache_used);
+    EXPECT_STREQ(draw(8, 7, &cache_used), images_paths[8]);
+    EXPECT_TRUE(cache_used);
+
+    // The pages jumped away from were dropped
+    EXPECT_FALSE(isImageCached(0));
+    EXPECT_FALSE(isImageCached(1));
+}
+
+TEST_F(test_infoPanel, prefetchesAhead)
+{
+    bool cache_used = false;
+
+    draw(0, 0, &cache_used);
+    waitPrefetched(0);
+
+    // Turning pages forward: the window moves ahead, keeping the previous
+    // page for a step back
+    for (int i = 1; i <= 3; i++)
+        draw(i, i - 1, &cache_used);
+
+    EXPECT_TRUE(waitCached(6));
+    EXPECT_TRUE(isImageCached(2));
+    EXPECT_FALSE(isImageCached(1));
+
+    for (int i = 4; i <= 7; i++) {
+        draw(i, i - 1, &cache_used);
+        EXPECT_TRUE(cache_used) << i;
+        waitCached(i + 1);
+    }
+}
+
+TEST_F(test_infoPanel, drawsPreScaled)
+{
+    const SDL_Rect frame = {100, 60, 320, 240};
+    bool cache_used = false;
+
+    // The 640x480 pages fit the frame once cached
+    draw(2, 2, &cache_used, &frame);
+    waitPrefetched(2);
+    SDL_FillRect(screen, NULL, 0);
+    draw(3, 2, &cache_used, &frame);
+    EXPECT_TRUE(cache_used);
+
+    int outside = 0, inside = 0;
+    for (int y = 0; y < screen->h; y++)
+        for (int x = 0; x < screen->w; x++) {
+            bool in_frame = x >= frame.x && x < frame.x + frame.w && y >= frame.y && y < frame.y + frame.h;
+            uint32_t pixel = ((uint32_t *)((uint8_t *)screen->pixels + y * screen->pitch))[x];
+            if (pixel != 0)
+                (in_frame ? inside : outside)++;
+        }
+    EXPECT_EQ(outside, 0);
+    EXPECT_GT(inside, 0);
+
+    // Drawn at another size: rebuilt for it
+    draw(3, 3, &cache_used);
+    EXPECT_FALSE(cache_used);
+}
+
+// A page: smooth gradients with a few hard edges
+static SDL_Surface *createPage(int width, int height)
+{
+    SDL_Surface *page = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32, 0xFF0000, 0xFF00, 0xFF, 0xFF000000);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) {
+            uint32_t r = x * 255 / width, g = y * 255 / height, b = ((x / 64 + y / 64) % 2) ? 200 : 40;
+            ((uint32_t *)((uint8_t *)page->pixels + y * page->pitch))[x] = 0xFF000000 | r << 16 | g << 8 | b;
+        }
+    return page;
+}
+
+static uint8_t channel(SDL_Surface *surface, int x, int y, uint32_t mask)
+{
+    uint32_t pixel = ((uint32_t *)((uint8_t *)surface->pixels + y * surface->pitch))[x];
+    return (pixel & mask) >> __builtin_ctz(mask);
+}
+
+TEST(test_imagesScale, likeRotozoom)
+{
+    for (int width : {752, 800, 1280}) {
+        SDL_Surface *page = createPage(width, width * 3 / 4);
+        double scale = 640.0 / width;
+
+        SDL_Surface *expected = rotozoomSurface(page, 0.0, scale, true);
+        SDL_Surface *scaled = scaleImageDown(page, scale);
+        ASSERT_NE(scaled, nullptr);
+        ASSERT_EQ(scaled->w, expected->w) << width;
+        ASSERT_EQ(scaled->h, expected->h) << width;
+
+        // Box filtered instead of interpolated: close, away from the edges
+        double diff = 0;
+        int count = 0;
+        for (int y = 0; y < scaled->h; y++)
+            for (int x = 0; x < scaled->w; x++)
+                for (uint32_t mask : {0xFF0000u, 0xFF00u, 0xFFu}) {
+                    diff += abs(channel(scaled, x, y, mask) - channel(expected, x, y, mask));
+                    count++;
+                }
+        EXPECT_LT(diff / count, 2.0) << width;
+        EXPECT_EQ(channel(scaled, 0, 0, 0xFF000000), 0xFF);
+
+        SDL_FreeSurface(expected);
+        SDL_FreeSurface(scaled);
+        SDL_FreeSurface(page);
+    }
+}
+
+TEST(test_imagesScale, wholeRatios)
+{
+    SDL_Surface *page = createPage(1280, 960);
+    SDL_Surface *scaled = scaleImageDown(page, 0.5);
+    ASSERT_NE(scaled, nullptr);
+    ASSERT_EQ(scaled->w, 640);
+    ASSERT_EQ(scaled->h, 480);
+
+    for (int y = 0; y < 480; y += 7)
+        for (int x = 0; x < 640; x += 5)
+            for (uint32_t mask : {0xFF0000u, 0xFF00u, 0xFFu}) {
+                int sum = channel(page, x * 2, y * 2, mask) + channel(page, x * 2 + 1, y * 2, mask) +
+                          channel(page, x * 2, y * 2 + 1, mask) + channel(page, x * 2 + 1, y * 2 + 1, mask);
+                ASSERT_EQ(channel(scaled, x, y, mask), (sum + 2) / 4) << x << "," << y;
+            }
+
+    // Not a downscale
+    EXPECT_EQ(scaleImageDown(page, 1.5), nullptr);
+
+    SDL_FreeSurface(scaled);
+    SDL_FreeSurface(page);
+}
+
+TEST_F(test_infoPanel, scaledVariantsAreKept)
+{
+    SDL_Surface *image = createPage(752, 560);
+
+    drawImage(image, screen, NULL);
+    // Referenced by its scaled variant
+    EXPECT_EQ(image->refcount, 2);
+    drawImage(image, screen, NULL);
+    EXPECT_EQ(image->refcount, 2);
+
+    cleanImagesCache();
+    EXPECT_EQ(image->refcount, 1);
+
+    // Freed by its owner first: kept alive until the variant goes
+    drawImage(image, screen, NULL);
+    SDL_FreeSurface(image);
+    cleanImagesCache();
+}
+
+static std::mutex g_store_lock;
+static std::map<std::string, SDL_Surface *> g_store;
+static int g_store_loads = 0;
+
+static SDL_Surface *copySurface(SDL_Surface *surface)
+{
+    SDL_Surface *copy = SDL_CreateRGBSurface(SDL_SWSURFACE, surface->w, surface->h, 32, surface->format->Rmask,
+                                             surface->format->Gmask, surface->format->Bmask, surface->format->Amask);
+    for (int y = 0; y < surface->h; y++)
+        memcpy((uint8_t *)copy->pixels + y * copy->pitch, (uint8_t *)surface->pixels + y * surface->pitch, surface->w * 4);
+    return copy;
+}
+
+static SDL_Surface *storeLoad(const char *image_path, int width, int height)
+{
+    std::lock_guard<std::mutex> lock(g_store_lock);
+    auto it = g_store.find(image_path);
+    // Scaled for another frame
+    if (it == g_store.end() || it->second->w > width || it->second->h > height ||
+        (it->second->w != width && it->second->h != height))
+        return NULL;
+    g_store_loads++;
+    return copySurface(it->second);
+}
+
+static void storeSave(const char *image_path, SDL_Surface *scaled_image)
+{
+    std::lock_guard<std::mutex> lock(g_store_lock);
+    if (g_store.count(image_path) == 0)
+        g_store[image_path] = copySurface(scaled_image);
+}
+
+TEST_F(test_infoPanel, storesScaledImages)
+{
+    const SDL_Rect frame = {0, 60, 640, 360}; // 480x360 once scaled
+    bool cache_used = false;
+
+    setScaledImagesStore(storeLoad, storeSave);
+
+    // The window is clamped to pages 0 to 4
+    draw(0, 0, &cache_used, &frame);
+    waitPrefetched(2);
+    {
+        std::lock_guard<std::mutex> lock(g_store_lock);
+        EXPECT_EQ(g_store.size(), 5u);
+        EXPECT_EQ(g_store_loads, 0);
+    }
+
+    // Next run: loaded back instead of decoded and scaled again
+    cleanImagesCache();
+    draw(0, 0, &cache_used, &frame);
+    waitPrefetched(2);
+    {
+        std::lock_guard<std::mutex> lock(g_store_lock);
+        EXPECT_EQ(g_store_loads, 5);
+        EXPECT_EQ(g_store.size(), 5u);
+    }
+
+    cleanImagesCache();
+    setScaledImagesStore(NULL, NULL);
+    for (auto &entry : g_store)
+        SDL_FreeSurface(entry.second);
+    g_store.clear();
+}
+
+// Before: rotozoomSurface on every draw of an image bigger than the frame
+static void drawImageRotozoom(SDL_Surface *image, SDL_Surface *screen, const SDL_Rect *target)
+{
+    SDL_Surface *scaled_image = NULL;
+
+    if (image->w > target->w || image->h > target->h) {
+        double ratio_x = (double)target->w / image->w;
+        double ratio_y = (double)target->h / image->h;
+        scaled_image = rotozoomSurface(image, 0.0, ratio_x < ratio_y ? ratio_x : ratio_y, true);
+        image = scaled_image;
+    }
+
+    SDL_Rect image_pos = {(Sint16)(target->x + (target->w - image->w) / 2), (Sint16)(target->y + (target->h - image->h) / 2)};
+    SDL_BlitSurface(image, NULL, screen, &image_pos);
+
+    if (scaled_image != NULL)
+        SDL_FreeSurface(scaled_image);
+}
+
+// Benchmark, not run by default: --gtest_also_run_disabled_tests
+TEST_F(test_infoPanel, DISABLED_benchmarkDrawPage)
+{
+    typedef std::chrono::steady_clock Clock;
+    const int frames = 20;
+    const SDL_Rect full = {0, 0, 640, 480}, themed = {20, 60, 600, 360};
+
+    for (int width : {752, 640}) {
+        SDL_Surface *page = createPage(width, width * 3 / 4 - (width == 752 ? 4 : 0));
+
+        for (const SDL_Rect *target : {&full, &themed}) {
+            auto start = Clock::now();
+            for (int i = 0; i < frames; i++)
+                drawImageRotozoom(page, screen, target);
+            double rotozoom_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+
+            start = Clock::now();
+            drawImage(page, screen, target);
+            double first_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            start = Clock::now();
+            for (int i = 0; i < frames; i++)
+                drawImage(page, screen, target);
+            double cached_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+
+            printf("%dx%d page in %dx%d: %.2f ms/draw with rotozoom, %.2f ms first draw, %.2f ms/draw after\n",
+                   page->w, page->h, target->w, target->h, rotozoom_ms, first_ms, cached_ms);
+        }
+
+        cleanImagesCache();
+        SDL_FreeSurface(page);
     }
-}
\ No newline at end of file
+}
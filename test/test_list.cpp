@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+
+#include <string>
+
+extern "C" {
+#include "components/list.h"
+}
+
+TEST(test_list, copiesTexts)
+{
+    List list = list_create(4, LIST_SMALL);
+    char label[STR_MAX] = "Temporary label";
+    ListItem item = {};
+    item.label = label;
+    item.sticky_note = "Note";
+
+    ListItem *added = list_addItemWithInfoNote(&list, item, "Info");
+    strcpy(label, "Overwritten");
+
+    EXPECT_STREQ(added->label, "Temporary label");
+    EXPECT_STREQ(added->sticky_note, "Note");
+    EXPECT_STREQ(added->info_note, "Info");
+    // Texts that weren't set read as empty
+    EXPECT_STREQ(added->description, "");
+    EXPECT_STREQ(added->payload, "");
+    EXPECT_STREQ(added->preview_path, "");
+    EXPECT_TRUE(list_hasInfoNote(&list));
+
+    list_free(&list);
+}
+
+TEST(test_list, valueLabels)
+{
+    List list = list_create(2, LIST_SMALL);
+    const char *labels[] = {"Off", "Low", "High", NULL};
+    char value_label[STR_MAX];
+
+    ListItem item = {};
+    item.item_type = MULTIVALUE;
+    item.value_max = 2;
+    item.value = 1;
+    item.value_labels = labels;
+    ListItem *with_labels = list_addItem(&list, item);
+
+    ListItem plain = {};
+    plain.item_type = MULTIVALUE;
+    plain.value = 7;
+    ListItem *without_labels = list_addItem(&list, plain);
+
+    EXPECT_NE(with_labels->value_labels, labels);
+    list_getItemValueLabel(with_labels, value_label);
+    EXPECT_STREQ(value_label, "Low");
+    EXPECT_EQ(with_labels->value_labels[3], nullptr);
+
+    EXPECT_EQ(without_labels->value_labels, nullptr);
+    list_getItemValueLabel(without_labels, value_label);
+    EXPECT_STREQ(value_label, "7");
+
+    list_free(&list);
+}
+
+TEST(test_list, setItemText)
+{
+    List list = list_create(1, LIST_SMALL);
+    ListItem item = {};
+    item.label = "Now: 2024-01-01 00:00:00";
+    ListItem *added = list_addItem(&list, item);
+
+    // Same length: rewritten in place
+    const char *before = added->label;
+    list_setItemText(added, &added->label, "Now: 2024-01-01 00:00:01");
+    EXPECT_EQ(added->label, before);
+    EXPECT_STREQ(added->label, "Now: 2024-01-01 00:00:01");
+
+    // Longer: moved, then back in place for shorter ones
+    std::string longer(100, 'x');
+    list_setItemText(added, &added->label, longer.c_str());
+    EXPECT_EQ(added->label, longer);
+    const char *moved = added->label;
+    list_updateStickyNote(added, "Script running...");
+    list_setItemText(added, &added->label, "Short");
+    EXPECT_EQ(added->label, moved);
+    EXPECT_STREQ(added->label, "Short");
+    EXPECT_STREQ(list_getStickyNote(added), "Script running...");
+
+    // Capped like the fixed size fields were
+    std::string too_long(STR_MAX * 2, 'y');
+    list_setItemText(added, &added->label, too_long.c_str());
+    EXPECT_EQ(strlen(added->label), (size_t)LIST_TEXT_MAX);
+
+    list_free(&list);
+}
+
+TEST(test_list, sortByLabel)
+{
+    List list = list_create(3, LIST_SMALL);
+    for (const char *label : {"banana", "Apple", "cherry"}) {
+        ListItem item = {};
+        item.label = label;
+        list_addItem(&list, item);
+    }
+
+    list_sortByLabel(&list);
+    EXPECT_STREQ(list.items[0].label, "Apple");
+    EXPECT_STREQ(list.items[1].label, "banana");
+    EXPECT_STREQ(list.items[2].label, "cherry");
+
+    list_free(&list);
+}
+
+TEST(test_list, compactItems)
+{
+    // The fixed text fields and the 100 value labels took ~27 KB per item
+    EXPECT_LT(sizeof(ListItem), 256u);
+}
@@ -0,0 +1,182 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <vector>
+
+extern "C" {
+#include "system/osd.h"
+}
+
+#define FB_WIDTH 640
+#define FB_HEIGHT 480
+#define FB_PAGES 3
+#define METER_WIDTH 4
+
+// A game frame: different content on every page and every frame
+static void renderFrame(std::vector<uint32_t> &fb, int page, uint32_t frame)
+{
+    uint32_t *pixels = fb.data() + page * FB_WIDTH * FB_HEIGHT;
+    for (int i = 0; i < FB_WIDTH * FB_HEIGHT; i++)
+        pixels[i] = 0xFF000000 | (i * 2654435761u + frame * 97 + page);
+}
+
+static void expectBar(const std::vector<uint32_t> &fb, int page, int value, int value_max, uint32_t color)
+{
+    int filled = value * FB_HEIGHT / value_max;
+    for (int y = 0; y < FB_HEIGHT; y++) {
+        const uint32_t *row = fb.data() + (page * FB_HEIGHT + y) * FB_WIDTH;
+        for (int x = FB_WIDTH - METER_WIDTH; x < FB_WIDTH; x++)
+            ASSERT_EQ(row[x], y < filled ? color : 0) << "page " << page << " at " << x << "," << y;
+    }
+}
+
+class test_osd : public ::testing::Test {
+  protected:
+    std::vector<uint32_t> fb;
+    OsdBar bar;
+
+    void SetUp() override
+    {
+        fb.resize(FB_WIDTH * FB_HEIGHT * FB_PAGES);
+        for (int page = 0; page < FB_PAGES; page++)
+            renderFrame(fb, page, 0);
+        ASSERT_TRUE(osd_bar_init(&bar, fb.data(), FB_WIDTH, FB_HEIGHT, FB_PAGES, METER_WIDTH));
+    }
+
+    void TearDown() override { osd_bar_restore(&bar); }
+};
+
+TEST_F(test_osd, restoresOnlyTheStrip)
+{
+    std::vector<uint32_t> original = fb;
+
+    EXPECT_TRUE(osd_bar_update(&bar, 0, __osd_bar_pack(7, 20, OSD_VOLUME_COLOR)));
+    expectBar(fb, 0, 7, 20, OSD_VOLUME_COLOR);
+
+    // Nothing outside the strip of the displayed page is touched
+    for (size_t i = 0; i < fb.size(); i++) {
+        int x = i % FB_WIDTH, page = i / (FB_WIDTH * FB_HEIGHT);
+        if (page != 0 || x < FB_WIDTH - METER_WIDTH) {
+            ASSERT_EQ(fb[i], original[i]) << i;
+        }
+    }
+
+    osd_bar_restore(&bar);
+    EXPECT_EQ(fb, original);
+}
+
+TEST_F(test_osd, redrawsOnlyOnChange)
+{
+    for (int i = 0; i < 500; i++)
+        osd_bar_update(&bar, 1, __osd_bar_pack(5, 10, OSD_BRIGHTNESS_COLOR));
+    EXPECT_EQ(bar.draw_count, 1u);
+
+    EXPECT_TRUE(osd_bar_update(&bar, 1, __osd_bar_pack(6, 10, OSD_BRIGHTNESS_COLOR)));
+    EXPECT_FALSE(osd_bar_update(&bar, 1, __osd_bar_pack(6, 10, OSD_BRIGHTNESS_COLOR)));
+    EXPECT_EQ(bar.draw_count, 2u);
+    expectBar(fb, 1, 6, 10, OSD_BRIGHTNESS_COLOR);
+}
+
+TEST_F(test_osd, redrawsAfterOverdraw)
+{
+    uint64_t state = __osd_bar_pack(10, 20, OSD_MUTE_ON_COLOR);
+    osd_bar_update(&bar, 0, state);
+
+    // A single buffered app redraws the page it displays
+    renderFrame(fb, 0, 1);
+    std::vector<uint32_t> redrawn = fb;
+
+    EXPECT_TRUE(osd_bar_update(&bar, 0, state));
+    expectBar(fb, 0, 10, 20, OSD_MUTE_ON_COLOR);
+
+    // What's restored is the new content, not the stale one
+    osd_bar_restore(&bar);
+    EXPECT_EQ(fb, redrawn);
+}
+
+TEST_F(test_osd, followsPageFlips)
+{
+    const int frames = 120; // 2 s at 60 fps
+    const int polls_per_frame = 4;
+    uint64_t state = __osd_bar_pack(12, 20, OSD_VOLUME_COLOR);
+    std::vector<uint32_t> rendered = fb; // the game's frames, without the bar
+
+    for (int frame = 1; frame <= frames; frame++) {
+        int page = frame % FB_PAGES;
+        renderFrame(fb, page, frame); // into the back buffer, then flipped
+        renderFrame(rendered, page, frame);
+        for (int i = 0; i < polls_per_frame; i++)
+            osd_bar_update(&bar, page, state);
+        expectBar(fb, page, 12, 20, OSD_VOLUME_COLOR);
+    }
+
+    // Once per flipped in frame, not once per poll
+    EXPECT_EQ(bar.draw_count, (uint32_t)frames);
+
+    // The game is rendering the next frame when the bar goes away: that
+    // page is left alone, the others get their frames back
+    renderFrame(fb, (frames + 1) % FB_PAGES, frames + 1);
+    renderFrame(rendered, (frames + 1) % FB_PAGES, frames + 1);
+    osd_bar_restore(&bar);
+    EXPECT_EQ(fb, rendered);
+}
+
+TEST_F(test_osd, flipBackKeepsSavedContent)
+{
+    std::vector<uint32_t> original = fb;
+    uint64_t state = __osd_bar_pack(3, 10, OSD_BRIGHTNESS_COLOR);
+
+    // Pages flipped without being redrawn: the bar already on them isn't
+    // mistaken for the content behind it
+    for (int i = 0; i < 10; i++)
+        osd_bar_update(&bar, i % 2, state);
+    EXPECT_EQ(bar.draw_count, 2u);
+
+    osd_bar_restore(&bar);
+    EXPECT_EQ(fb, original);
+}
+
+// The previous thread: all pages redrawn every 1 ms for the 2 s the bar is
+// shown, whether anything changed or not
+static void printBarAllPages(std::vector<uint32_t> &fb, uint32_t color, int filled)
+{
+    uint32_t *ofs = fb.data() + FB_WIDTH - METER_WIDTH;
+    for (int i = 0; i < FB_HEIGHT * FB_PAGES; i++, ofs += FB_WIDTH) {
+        uint32_t curr = (i % FB_HEIGHT) < filled ? color : 0;
+        for (int j = 0; j < METER_WIDTH; j++)
+            ofs[j] = curr;
+    }
+}
+
+// Static screen (menu, paused game): the bar is drawn once while visible
+TEST_F(test_osd, drawsOnceWhileVisible)
+{
+    uint64_t state = __osd_bar_pack(8, 20, OSD_VOLUME_COLOR);
+
+    for (int i = 0; i < OSD_BAR_TIMEOUT / OSD_BAR_POLL_MS; i++)
+        osd_bar_update(&bar, 0, state);
+
+    EXPECT_EQ(bar.draw_count, 1u);
+}
+
+// Benchmark, not run by default: --gtest_also_run_disabled_tests
+TEST_F(test_osd, DISABLED_cpuWhileVisible)
+{
+    typedef std::chrono::steady_clock Clock;
+    uint64_t state = __osd_bar_pack(8, 20, OSD_VOLUME_COLOR);
+    const int old_iterations = OSD_BAR_TIMEOUT / 1;
+    const int new_iterations = OSD_BAR_TIMEOUT / OSD_BAR_POLL_MS;
+
+    auto start = Clock::now();
+    for (int i = 0; i < old_iterations; i++)
+        printBarAllPages(fb, OSD_VOLUME_COLOR, 8 * FB_HEIGHT / 20);
+    double old_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (int i = 0; i < new_iterations; i++)
+        osd_bar_update(&bar, 0, state);
+    double new_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    printf("osd bar, 2 s static screen: %.3f ms drawing every 1 ms, %.3f ms compositing (%u draws)\n",
+           old_ms, new_ms, bar.draw_count);
+}
@@ -0,0 +1,189 @@
+#include "gtest/gtest.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include "../src/playActivity/playActivityDB.h"
+}
+
+#define TEST_ROMS 500
+#define TEST_BATCH 50
+
+class test_playActivity : public ::testing::Test {
+protected:
+    char root[64];
+    char rom_dir[128];
+
+    void SetUp() override
+    {
+        strcpy(root, "/tmp/test_playActivity_XXXXXX");
+        ASSERT_NE(mkdtemp(root), nullptr);
+        snprintf(play_activity_db_path, PATH_MAX, "%s/play_activity/play_activity_db.sqlite", root);
+        snprintf(rom_dir, sizeof(rom_dir), "%s/Roms/GB", root);
+
+        // Schema created up front, the writers only add activities
+        play_activity_db_open();
+        play_activity_db_close();
+        ASSERT_TRUE(is_file(play_activity_db_path));
+    }
+
+    void TearDown() override
+    {
+        play_activity_db_release();
+        strcpy(play_activity_db_path, PLAY_ACTIVITY_DB_NEW_FILE);
+
+        char cmd[128];
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+        system(cmd);
+    }
+
+    // What `playActivity batch` does with start/stop lines: one handle,
+    // commits every TEST_BATCH roms
+    void writeActivities(int batches)
+    {
+        char rom_path[PATH_MAX];
+
+        play_activity_db_keep_open();
+        play_activity_db_open();
+
+        for (int b = 0; b < batches; b++) {
+            play_activity_db_begin();
+            for (int i = 0; i < TEST_BATCH; i++) {
+                snprintf(rom_path, sizeof(rom_path), "%s/game%d.gb", rom_dir, (b * TEST_BATCH + i) % TEST_ROMS);
+                play_activity_start(rom_path);
+                play_activity_stop(rom_path);
+            }
+            play_activity_db_commit();
+        }
+
+        play_activity_db_release();
+    }
+
+    int countActivities(void)
+    {
+        int count = 0;
+        play_activity_db_open();
+        sqlite3_stmt *stmt = play_activity_db_prepare("SELECT COUNT(*) FROM play_activity;");
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            count = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+        play_activity_db_close();
+        return count;
+    }
+};
+
+TEST_F(test_playActivity, writesAndChecksStats)
+{
+    writeActivities(2);
+
+    EXPECT_EQ(countActivities(), 2 * TEST_BATCH);
+    EXPECT_EQ(play_activity_check_stats(false), 0);
+}
+
+// The writer is SIGKILLed at varying points while it writes: the database
+// must stay intact and rom_stats consistent with the history
+TEST_F(test_playActivity, survivesKillMidWrite)
+{
+    const int iterations = 20;
+
+    for (int n = 0; n < iterations; n++) {
+        pid_t pid = fork();
+        ASSERT_NE(pid, -1);
+
+        if (pid == 0) {
+            writeActivities(TEST_ROMS / TEST_BATCH);
+            _exit(0);
+        }
+
+        usleep((n % 10) * 1000);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+
+        ASSERT_EQ(play_activity_check_stats(false), 0) << "iteration " << n;
+    }
+
+    // Committed batches are kept, the interrupted one is rolled back
+    EXPECT_EQ(countActivities() % TEST_BATCH, 0);
+}
+
+class test_cacheDB : public ::testing::Test {
+protected:
+    char root[64];
+    char cache_dir[128];
+    char cache_path[192];
+
+    void SetUp() override
+    {
+        strcpy(root, "/tmp/test_cacheDB_XXXXXX");
+        ASSERT_NE(mkdtemp(root), nullptr);
+        snprintf(cache_dir, sizeof(cache_dir), "%s/Roms/GBA", root);
+        snprintf(cache_path, sizeof(cache_path), "%s/GBA_cache6.db", cache_dir);
+        mkdirs(cache_dir);
+    }
+
+    void TearDown() override
+    {
+        cache_db_release();
+
+        char cmd[128];
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+        system(cmd);
+    }
+
+    // Same table layout as MainUI's cache, paths stored the way MainUI does.
+    // The display name "x" belongs to another rom, so a lookup that misses
+    // the path and falls back to the name finds the wrong game.
+    void createCache(void)
+    {
+        sqlite3 *db = NULL;
+        ASSERT_EQ(sqlite3_open(cache_path, &db), SQLITE_OK);
+        ASSERT_EQ(sqlite3_exec(db,
+                               "CREATE TABLE GBA_roms(id INTEGER PRIMARY KEY, disp TEXT, path TEXT, imgpath TEXT, type INTEGER, ppath TEXT, pinyin TEXT);"
+                               "INSERT INTO GBA_roms(disp, path, imgpath, pinyin) VALUES"
+                               "('x', '/mnt/SDCARD/Emu/GBA/../../Roms/GBA/other.zip', '/mnt/SDCARD/Roms/GBA/Imgs/other.png', 'Other Game'),"
+                               "('Game X', '/mnt/SDCARD/Emu/GBA/../../Roms/GBA/x.zip', '/mnt/SDCARD/Roms/GBA/Imgs/x.png', 'Game X');",
+                               NULL, NULL, NULL),
+                  SQLITE_OK);
+        sqlite3_close(db);
+    }
+};
+
+TEST_F(test_cacheDB, findsEmuPrefixedPaths)
+{
+    createCache();
+
+    char rom_path[PATH_MAX];
+    snprintf(rom_path, sizeof(rom_path), "%s/x.zip", cache_dir);
+
+    CacheDBItem *item = cache_db_find(rom_path);
+    ASSERT_NE(item, nullptr);
+    EXPECT_STREQ(item->name, "Game X");
+    EXPECT_STREQ(item->path, "/mnt/SDCARD/Emu/GBA/../../Roms/GBA/x.zip");
+    EXPECT_STREQ(item->imgpath, "/mnt/SDCARD/Roms/GBA/Imgs/x.png");
+    free(item);
+
+    // Case-insensitive, like the LIKE lookup it replaces
+    snprintf(rom_path, sizeof(rom_path), "%s/X.ZIP", cache_dir);
+    item = cache_db_find(rom_path);
+    ASSERT_NE(item, nullptr);
+    EXPECT_STREQ(item->name, "Game X");
+    free(item);
+}
+
+TEST_F(test_cacheDB, seesCacheCreatedLater)
+{
+    char rom_path[PATH_MAX];
+    snprintf(rom_path, sizeof(rom_path), "%s/x.zip", cache_dir);
+
+    EXPECT_EQ(cache_db_find(rom_path), nullptr);
+
+    createCache();
+
+    CacheDBItem *item = cache_db_find(rom_path);
+    ASSERT_NE(item, nullptr);
+    EXPECT_STREQ(item->name, "Game X");
+    free(item);
+}
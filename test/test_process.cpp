@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+
+extern "C" {
+#include "utils/file.h"
+#include "utils/process.h"
+}
+
+class test_process : public ::testing::Test {
+protected:
+    char root[64];
+
+    void SetUp() override
+    {
+        strcpy(root, "/tmp/test_process_XXXXXX");
+        ASSERT_NE(mkdtemp(root), nullptr);
+        strcpy(process_proc_root, root);
+        process_snapshot_invalidate();
+
+        addProcess("1", "init");
+        addProcess("2", "kthreadd");
+        addProcess("100", "retroarch");
+        addProcess("101", "ra32.ss");
+        addProcess("102", "MainUI");
+        addProcess("self", "test");
+    }
+
+    void TearDown() override
+    {
+        std::string cmd = std::string("rm -rf ") + root;
+        system(cmd.c_str());
+        strcpy(process_proc_root, "/proc");
+        process_snapshot_invalidate();
+    }
+
+    void addProcess(const char *pid, const char *comm)
+    {
+        std::string dir = std::string(root) + "/" + pid;
+        mkdir(dir.c_str(), 0755);
+        FILE *fp = fopen((dir + "/comm").c_str(), "w");
+        fprintf(fp, "%s\n", comm);
+        fclose(fp);
+    }
+};
+
+TEST_F(test_process, findsProcessesByName)
+{
+    EXPECT_EQ(process_searchpid("retroarch"), 100);
+    EXPECT_EQ(process_searchpid("MainUI"), 102);
+    EXPECT_EQ(process_searchpid("drastic"), 0);
+    EXPECT_TRUE(process_isRunning("MainUI"));
+    EXPECT_FALSE(process_isRunning("gameSwitcher"));
+}
+
+TEST_F(test_process, forwardMatch)
+{
+    EXPECT_EQ(process_searchpid("ra32"), 101);
+    EXPECT_EQ(process_searchpid("Main"), 102);
+}
+
+// Like the /proc scan it replaces: the first match in /proc order wins,
+// even when a later process has the exact name
+TEST_F(test_process, firstMatchInProcOrder)
+{
+    addProcess("150", "ra32");
+
+    pid_t first = 0;
+    DIR *dp = opendir(root);
+    struct dirent *entry;
+    while (first == 0 && (entry = readdir(dp)) != NULL) {
+        if (strcmp(entry->d_name, "101") == 0 || strcmp(entry->d_name, "150") == 0)
+            first = atoi(entry->d_name);
+    }
+    closedir(dp);
+
+    EXPECT_EQ(process_searchpid("ra32"), first);
+}
+
+TEST_F(test_process, ignoresKernelAndNonPidEntries)
+{
+    EXPECT_EQ(process_searchpid("init"), 0);
+    EXPECT_EQ(process_searchpid("kthreadd"), 0);
+    EXPECT_EQ(process_searchpid("test"), 0);
+}
+
+TEST_F(test_process, snapshotIsReusedUntilInvalidated)
+{
+    EXPECT_EQ(process_searchpid("drastic"), 0);
+
+    addProcess("200", "drastic");
+    EXPECT_EQ(process_searchpid("drastic"), 0);
+
+    process_snapshot_invalidate();
+    EXPECT_EQ(process_searchpid("drastic"), 200);
+}
+
+TEST_F(test_process, snapshotExpires)
+{
+    EXPECT_EQ(process_searchpid("drastic"), 0);
+
+    addProcess("200", "drastic");
+    usleep((PROCESS_SNAPSHOT_TTL_MS + 50) * 1000);
+    EXPECT_EQ(process_searchpid("drastic"), 200);
+}
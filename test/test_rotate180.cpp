@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+
+#include <SDL/SDL.h>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include "utils/rotate180.h"
+}
+
+// Every byte of the surface (padding included) gets a distinct-ish value
+static void fillPattern(SDL_Surface *surface)
+{
+    uint8_t *data = (uint8_t *)surface->pixels;
+    for (int i = 0; i < surface->pitch * surface->h; i++)
+        data[i] = (uint8_t)(i * 131 + (i >> 8) * 7 + 1);
+}
+
+static void checkRotated(int width, int height, int bpp)
+{
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, bpp, 0, 0, 0, 0);
+    ASSERT_NE(surface, nullptr);
+
+    int bytes_per_pixel = surface->format->BytesPerPixel;
+    int pitch = surface->pitch;
+    fillPattern(surface);
+    std::vector<uint8_t> original((uint8_t *)surface->pixels, (uint8_t *)surface->pixels + pitch * height);
+
+    EXPECT_EQ(rotate180(surface), surface);
+
+    const uint8_t *rotated = (const uint8_t *)surface->pixels;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const uint8_t *expected = &original[(height - 1 - y) * pitch + (width - 1 - x) * bytes_per_pixel];
+            ASSERT_EQ(memcmp(rotated + y * pitch + x * bytes_per_pixel, expected, bytes_per_pixel), 0)
+                << width << "x" << height << "x" << bpp << " at " << x << "," << y;
+        }
+        // Row padding is left alone
+        int row_end = width * bytes_per_pixel;
+        ASSERT_EQ(memcmp(rotated + y * pitch + row_end, &original[y * pitch + row_end], pitch - row_end), 0);
+    }
+
+    SDL_FreeSurface(surface);
+}
+
+TEST(test_rotate180, pixelExact)
+{
+    const int sizes[][2] = {{1, 1}, {2, 1}, {1, 2}, {3, 3}, {5, 4}, {7, 9}, {17, 3}, {33, 5}, {640, 480}, {641, 481}, {752, 560}};
+
+    for (int bpp : {8, 16, 24, 32})
+        for (auto &size : sizes)
+            checkRotated(size[0], size[1], bpp);
+}
+
+TEST(test_rotate180, twiceIsIdentity)
+{
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, 321, 243, 32, 0, 0, 0, 0);
+    fillPattern(surface);
+    std::vector<uint8_t> original((uint8_t *)surface->pixels, (uint8_t *)surface->pixels + surface->pitch * surface->h);
+
+    rotate180(rotate180(surface));
+    EXPECT_EQ(memcmp(surface->pixels, original.data(), original.size()), 0);
+
+    SDL_FreeSurface(surface);
+}
+
+TEST(test_rotate180, handlesNull)
+{
+    EXPECT_EQ(rotate180(NULL), nullptr);
+}
+
+// What the rotozoom version cost at least, without its interpolation:
+// allocating a frame, copying into it rotated, and copying it back
+static void rotateByCopy(SDL_Surface *surface)
+{
+    int size = surface->pitch * surface->h;
+    uint32_t *copy = (uint32_t *)malloc(size);
+    uint32_t *pixels = (uint32_t *)surface->pixels;
+    int count = size / 4;
+    for (int i = 0; i < count; i++)
+        copy[count - 1 - i] = pixels[i];
+    memcpy(pixels, copy, size);
+    free(copy);
+}
+
+// Benchmark, not run by default: --gtest_also_run_disabled_tests
+TEST(test_rotate180, DISABLED_benchmark)
+{
+    typedef std::chrono::steady_clock Clock;
+    const int sizes[][2] = {{640, 480}, {752, 560}};
+    const int iterations = 200;
+
+    for (auto &size : sizes) {
+        for (int bpp : {16, 32}) {
+            SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, size[0], size[1], bpp, 0, 0, 0, 0);
+            fillPattern(surface);
+
+            auto start = Clock::now();
+            for (int i = 0; i < iterations; i++)
+                rotate180(surface);
+            double in_place_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+
+            start = Clock::now();
+            for (int i = 0; i < iterations; i++)
+                rotateByCopy(surface);
+            double copy_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+
+            printf("rotate180 %dx%dx%d: %.3f ms in place, %.3f ms alloc+copy+copy back\n",
+                   size[0], size[1], bpp, in_place_ms, copy_ms);
+            SDL_FreeSurface(surface);
+        }
+    }
+}
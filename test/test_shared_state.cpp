@@ -0,0 +1,193 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <stdlib.h>
+#include <string>
+#include <sys/wait.h>
+
+extern "C" {
+#include "system/shared_state.h"
+}
+
+class test_shared_state : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        shared_state_key = 0x54530000 | (getpid() & 0xffff);
+        shared_state_compat = false;
+        shared_state_detach(true);
+        ASSERT_TRUE(shared_state_attach());
+    }
+
+    void TearDown() override
+    {
+        shared_state_detach(true);
+        shared_state_key = SHARED_STATE_KEY;
+        shared_state_compat = true;
+    }
+};
+
+TEST_F(test_shared_state, startsUnpublished)
+{
+    SharedState state;
+    ASSERT_TRUE(shared_state_read(&state));
+    EXPECT_EQ(state.published, 0);
+    EXPECT_EQ(shared_state_getBatteryPercentage(NULL), -1);
+}
+
+TEST_F(test_shared_state, publishesBattery)
+{
+    bool charging = false;
+
+    shared_state_setBattery(42, true);
+    EXPECT_EQ(shared_state_getBatteryPercentage(&charging), 42);
+    EXPECT_TRUE(charging);
+
+    shared_state_setBattery(-1, false);
+    EXPECT_EQ(shared_state_getBatteryPercentage(NULL), -1);
+}
+
+TEST_F(test_shared_state, publishesStateRomAndFlags)
+{
+    SharedState state;
+
+    shared_state_setSystemState(3);
+    shared_state_setRom("/mnt/SDCARD/Roms/GB/game.gb");
+    shared_state_setFlag(SHARED_FLAG_BATTERY_DISPLAY, true);
+    shared_state_setFlag(SHARED_FLAG_LOW_BATTERY, false);
+
+    ASSERT_TRUE(shared_state_read(&state));
+    EXPECT_EQ(state.system_state, 3);
+    EXPECT_STREQ(state.current_rom, "/mnt/SDCARD/Roms/GB/game.gb");
+    EXPECT_TRUE(shared_state_getFlag(SHARED_FLAG_BATTERY_DISPLAY));
+    EXPECT_FALSE(shared_state_getFlag(SHARED_FLAG_LOW_BATTERY));
+}
+
+TEST_F(test_shared_state, resyncsEditedCompatFiles)
+{
+    FILE *fp;
+    int percentage = 0;
+
+    shared_state_compat = true;
+    shared_state_setBattery(42, false);
+    shared_state_setFlag(SHARED_FLAG_LOW_BATTERY, true);
+
+    // Changed behind the writers' back, same values published again
+    file_put(fp, SHARED_STATE_PERCBAT_PATH, "%d", 17);
+    remove("/tmp/.lowBat");
+    shared_state_setBattery(42, false);
+    shared_state_setFlag(SHARED_FLAG_LOW_BATTERY, true);
+
+    file_get(fp, SHARED_STATE_PERCBAT_PATH, "%d", &percentage);
+    EXPECT_EQ(percentage, 42);
+    EXPECT_TRUE(exists("/tmp/.lowBat"));
+
+    shared_state_setBattery(-1, false);
+    shared_state_setFlag(SHARED_FLAG_LOW_BATTERY, false);
+    EXPECT_FALSE(exists(SHARED_STATE_PERCBAT_PATH));
+    EXPECT_FALSE(exists("/tmp/.lowBat"));
+}
+
+TEST_F(test_shared_state, visibleAcrossProcesses)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        shared_state_detach(false);
+        shared_state_setBattery(77, false);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+
+    EXPECT_EQ(shared_state_getBatteryPercentage(NULL), 77);
+}
+
+// Writers publish values that satisfy invariants across fields, readers
+// check every snapshot they take
+static bool isConsistent(const SharedState *state)
+{
+    if (state->charging != (state->battery_percentage % 2 == 0))
+        return false;
+    if (state->system_state != state->battery_percentage % 7)
+        return false;
+    size_t len = strlen(state->current_rom);
+    if (len != 0 && len != 10 + (size_t)(state->current_rom[0] - 'a') * 8)
+        return false;
+    for (size_t i = 1; i < len; i++)
+        if (state->current_rom[i] != state->current_rom[0])
+            return false;
+    return true;
+}
+
+static void writeConsistent(int k)
+{
+    char rom[SHARED_STATE_ROM_MAX];
+    int c = k % 26;
+    memset(rom, 'a' + c, 10 + c * 8);
+    rom[10 + c * 8] = '\0';
+
+    // One transaction for several fields, as the setters do per group
+    uint32_t locked = __shared_state_begin();
+    SharedState *state = &__shared_state->state;
+    state->battery_percentage = k;
+    state->charging = k % 2 == 0;
+    state->system_state = k % 7;
+    strcpy(state->current_rom, rom);
+    state->published |= SHARED_FIELD_BATTERY | SHARED_FIELD_SYSTEM_STATE | SHARED_FIELD_ROM;
+    __shared_state_end(locked);
+}
+
+TEST_F(test_shared_state, noTornReadsUnderContention)
+{
+    const int writers = 2, readers = 3, duration_ms = 500;
+    int pipe_fds[2];
+    pid_t pids[writers + readers];
+
+    ASSERT_EQ(pipe(pipe_fds), 0);
+    writeConsistent(0);
+
+    for (int p = 0; p < writers + readers; p++) {
+        if ((pids[p] = fork()) != 0)
+            continue;
+
+        shared_state_detach(false);
+        shared_state_attach();
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(duration_ms);
+        long counts[4] = {p < writers, 0, 0, 0}; // is writer, operations, torn, failed
+
+        for (int k = p * 1000003; std::chrono::steady_clock::now() < end; k++) {
+            if (p < writers) {
+                writeConsistent(k & 0x7fffffff);
+            }
+            else {
+                SharedState state;
+                if (!shared_state_read(&state))
+                    counts[3]++;
+                else if (!isConsistent(&state))
+                    counts[2]++;
+            }
+            counts[1]++;
+        }
+
+        write(pipe_fds[1], counts, sizeof(counts));
+        _exit(0);
+    }
+
+    long writes = 0, reads = 0, torn = 0, failed = 0;
+    for (int p = 0; p < writers + readers; p++) {
+        long counts[4];
+        ASSERT_EQ(read(pipe_fds[0], counts, sizeof(counts)), (ssize_t)sizeof(counts));
+        *(counts[0] ? &writes : &reads) += counts[1];
+        torn += counts[2];
+        failed += counts[3];
+    }
+    for (int p = 0; p < writers + readers; p++)
+        waitpid(pids[p], NULL, 0);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+
+    printf("shared_state: %ld writes, %ld reads, %ld torn, %ld failed\n", writes, reads, torn, failed);
+    EXPECT_GT(writes, 0);
+    EXPECT_GT(reads, 0);
+    EXPECT_EQ(torn, 0);
+    EXPECT_EQ(failed, 0);
+}
@@ -0,0 +1,215 @@
+#include "gtest/gtest.h"
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+#include <chrono>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "theme/text.h"
+}
+
+#define TEST_FONT "../static/build/miyoo/app/Exo-2-Bold-Italic.ttf"
+
+static const SDL_Color color_white = {255, 255, 255};
+static const SDL_Color color_grey = {117, 123, 156};
+static const SDL_Color color_black = {0, 0, 0};
+
+static SDL_Surface *createScreen(void)
+{
+    SDL_Surface *screen = SDL_CreateRGBSurface(SDL_SWSURFACE, 640, 480, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    uint32_t *pixels = (uint32_t *)screen->pixels;
+    for (int i = 0; i < 640 * 480; i++)
+        pixels[i] = 0x203040 + (i % 640) / 5 * 0x010101;
+    return screen;
+}
+
+static uint32_t pixelAt(SDL_Surface *surface, int x, int y)
+{
+    return ((uint32_t *)((uint8_t *)surface->pixels + y * surface->pitch))[x];
+}
+
+class test_text : public ::testing::Test {
+  protected:
+    TTF_Font *font = NULL;
+
+    void SetUp() override
+    {
+        TTF_Init();
+        font = TTF_OpenFont(TEST_FONT, 28);
+        ASSERT_NE(font, nullptr);
+    }
+
+    void TearDown() override
+    {
+        text_cacheFree();
+        TTF_CloseFont(font);
+        TTF_Quit();
+    }
+};
+
+TEST_F(test_text, sameAsSdlTtf)
+{
+    for (const char *str : {"Show recents", "Brightness: 7", "Wi-Fi (12%)", "Français, Español", "AVATAR Type", "j"}) {
+        SDL_Surface *expected = TTF_RenderUTF8_Blended(font, str, color_grey);
+        SDL_Surface *label = text_render(font, str, color_grey);
+        ASSERT_NE(expected, nullptr);
+        ASSERT_NE(label, nullptr);
+        ASSERT_EQ(label->w, expected->w) << str;
+        ASSERT_EQ(label->h, expected->h) << str;
+
+        for (int y = 0; y < label->h; y++) {
+            for (int x = 0; x < label->w; x++) {
+                uint32_t a = pixelAt(expected, x, y), b = pixelAt(label, x, y);
+                // Fully transparent pixels may differ in colour only
+                if ((a >> 24) != 0 || (b >> 24) != 0) {
+                    ASSERT_EQ(b, a) << str << " at " << x << "," << y;
+                }
+            }
+        }
+
+        SDL_FreeSurface(expected);
+    }
+
+    EXPECT_EQ(text_render(font, "", color_grey), nullptr);
+}
+
+TEST_F(test_text, shadowInOneBlit)
+{
+    const char *str = "Auto-save last game";
+    SDL_Surface *expected = createScreen(), *screen = createScreen();
+
+    // Before: the shadow, then the text over it
+    SDL_Surface *shadow = TTF_RenderUTF8_Blended(font, str, color_black);
+    SDL_Surface *fg = TTF_RenderUTF8_Blended(font, str, color_white);
+    SDL_Rect shadow_pos = {20 + TEXT_SHADOW_X, 100 + TEXT_SHADOW_Y}, fg_pos = {20, 100};
+    SDL_BlitSurface(shadow, NULL, expected, &shadow_pos);
+    SDL_BlitSurface(fg, NULL, expected, &fg_pos);
+
+    SDL_Surface *label = text_renderEx(font, str, color_white, true, SDL_ALPHA_OPAQUE);
+    ASSERT_EQ(label->w, fg->w + TEXT_SHADOW_X);
+    ASSERT_EQ(label->h, fg->h + TEXT_SHADOW_Y);
+    SDL_Rect label_pos = {20, 100};
+    SDL_BlitSurface(label, NULL, screen, &label_pos);
+
+    for (int y = 0; y < 480; y++)
+        for (int x = 0; x < 640; x++) {
+            uint32_t a = pixelAt(expected, x, y), b = pixelAt(screen, x, y);
+            for (int shift = 0; shift < 24; shift += 8)
+                ASSERT_NEAR((int)(a >> shift & 0xFF), (int)(b >> shift & 0xFF), 3) << x << "," << y;
+        }
+
+    SDL_FreeSurface(shadow);
+    SDL_FreeSurface(fg);
+    SDL_FreeSurface(expected);
+    SDL_FreeSurface(screen);
+}
+
+TEST_F(test_text, cache)
+{
+    SDL_Surface *label = text_render(font, "Theme", color_white);
+    uint32_t misses = __text_misses;
+
+    EXPECT_EQ(text_render(font, "Theme", color_white), label);
+    EXPECT_EQ(__text_misses, misses);
+
+    // Colour, alpha and shadow are part of the key
+    EXPECT_NE(text_render(font, "Theme", color_grey), label);
+    EXPECT_NE(text_renderEx(font, "Theme", color_white, false, 60), label);
+    EXPECT_NE(text_renderEx(font, "Theme", color_white, true, SDL_ALPHA_OPAQUE), label);
+    EXPECT_EQ(__text_misses, misses + 3);
+
+    // Least recently used labels go first
+    for (int i = 0; i < TEXT_CACHE_LABELS * 2; i++) {
+        text_render(font, "Theme", color_white);
+        text_render(font, std::to_string(i).c_str(), color_white);
+    }
+    EXPECT_LE(__text_label_count, TEXT_CACHE_LABELS);
+    EXPECT_LE(__text_label_bytes, (size_t)TEXT_CACHE_BYTES);
+    EXPECT_EQ(text_render(font, "Theme", color_white), label);
+
+    text_releaseFont(font);
+    EXPECT_EQ(__text_label_count, 0);
+    EXPECT_EQ(__text_fonts, nullptr);
+}
+
+// The text of a tweaks page: title, list labels (the active one with its
+// shadow), multivalue values, hints and the page status
+struct PageText {
+    const char *str;
+    bool shadow;
+};
+
+static const PageText tweaks_page[] = {
+    {"System", false},
+    {"Startup", false},
+    {"Save and exit", true},
+    {"Vibration intensity", false},
+    {"Normal", false},
+    {"Menu button haptics", false},
+    {"Low battery warning", false},
+    {"15%", false},
+    {"Advanced", false},
+    {"SELECT", false},
+    {"BACK", false},
+    {"3/", false},
+    {"9", false},
+};
+
+// Before: rendered by SDL_ttf and freed, for every frame
+static void renderPageTtf(SDL_Surface *screen, TTF_Font *font)
+{
+    int y = 60;
+    for (const PageText &text : tweaks_page) {
+        SDL_Rect pos = {20, (Sint16)y};
+        if (text.shadow) {
+            SDL_Surface *shadow = TTF_RenderUTF8_Blended(font, text.str, color_black);
+            SDL_Rect shadow_pos = {21, (Sint16)(y + 2)};
+            SDL_BlitSurface(shadow, NULL, screen, &shadow_pos);
+            SDL_FreeSurface(shadow);
+        }
+        SDL_Surface *label = TTF_RenderUTF8_Blended(font, text.str, color_white);
+        SDL_BlitSurface(label, NULL, screen, &pos);
+        SDL_FreeSurface(label);
+        y += 30;
+    }
+}
+
+static void renderPageCached(SDL_Surface *screen, TTF_Font *font)
+{
+    int y = 60;
+    for (const PageText &text : tweaks_page) {
+        SDL_Rect pos = {20, (Sint16)y};
+        SDL_BlitSurface(text_renderEx(font, text.str, color_white, text.shadow, SDL_ALPHA_OPAQUE), NULL, screen, &pos);
+        y += 30;
+    }
+}
+
+// Benchmark, not run by default: --gtest_also_run_disabled_tests
+TEST_F(test_text, DISABLED_benchmarkTweaksPage)
+{
+    typedef std::chrono::steady_clock Clock;
+    const int frames = 60;
+    SDL_Surface *screen = createScreen();
+
+    auto start = Clock::now();
+    for (int i = 0; i < frames; i++)
+        renderPageTtf(screen, font);
+    double ttf_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+
+    start = Clock::now();
+    renderPageCached(screen, font);
+    double first_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (int i = 0; i < frames; i++)
+        renderPageCached(screen, font);
+    double cached_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+
+    printf("tweaks page text: %.3f ms/frame with SDL_ttf, %.3f ms first frame, %.3f ms/frame cached\n",
+           ttf_ms, first_ms, cached_ms);
+
+    SDL_FreeSurface(screen);
+}
@@ -0,0 +1,160 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <poll.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "utils/watcher.h"
+}
+
+typedef std::chrono::steady_clock Clock;
+
+struct WatchRecord {
+    std::vector<std::pair<std::string, WatchEvent>> events;
+    Clock::time_point last;
+};
+
+static void onWatch(const char *path, WatchEvent event, void *userdata)
+{
+    WatchRecord *record = (WatchRecord *)userdata;
+    record->events.push_back({path, event});
+    record->last = Clock::now();
+}
+
+class test_watcher : public ::testing::Test {
+protected:
+    char root[64];
+    Watcher watcher;
+    WatchRecord record;
+
+    void SetUp() override
+    {
+        strcpy(root, "/tmp/test_watcher_XXXXXX");
+        ASSERT_NE(mkdtemp(root), nullptr);
+        ASSERT_TRUE(watcher_init(&watcher));
+    }
+
+    void TearDown() override
+    {
+        watcher_close(&watcher);
+        std::string cmd = std::string("rm -rf ") + root;
+        system(cmd.c_str());
+    }
+
+    std::string path(const char *name) { return std::string(root) + "/" + name; }
+
+    void touch(const char *name)
+    {
+        FILE *fp = fopen(path(name).c_str(), "a");
+        fclose(fp);
+    }
+
+    // What keymon's main loop does
+    int pollOnce(int timeout_ms)
+    {
+        struct pollfd fds[1] = {{watcher.fd, POLLIN, 0}};
+        if (poll(fds, 1, timeout_ms) <= 0)
+            return 0;
+        return watcher_dispatch(&watcher);
+    }
+};
+
+TEST_F(test_watcher, reportsCreationOfMissingFile)
+{
+    ASSERT_TRUE(watcher_add(&watcher, path("settings_changed").c_str(), onWatch, &record));
+
+    touch("settings_changed");
+    EXPECT_EQ(pollOnce(1000), 1);
+    ASSERT_EQ(record.events.size(), 1);
+    EXPECT_EQ(record.events[0].first, path("settings_changed"));
+    EXPECT_EQ(record.events[0].second, WATCH_CHANGED);
+}
+
+TEST_F(test_watcher, reportsRemoval)
+{
+    touch("state_changed");
+    ASSERT_TRUE(watcher_add(&watcher, path("state_changed").c_str(), onWatch, &record));
+
+    remove(path("state_changed").c_str());
+    EXPECT_EQ(pollOnce(1000), 1);
+    ASSERT_EQ(record.events.size(), 1);
+    EXPECT_EQ(record.events[0].second, WATCH_REMOVED);
+}
+
+TEST_F(test_watcher, coalescesEventsPerDispatch)
+{
+    ASSERT_TRUE(watcher_add(&watcher, path("favourite.json").c_str(), onWatch, &record));
+
+    // Create + modify + close, several times
+    for (int i = 0; i < 5; i++) {
+        FILE *fp = fopen(path("favourite.json").c_str(), "w");
+        fprintf(fp, "{\"n\": %d}", i);
+        fclose(fp);
+    }
+
+    EXPECT_EQ(pollOnce(1000), 1);
+    EXPECT_EQ(record.events.size(), 1);
+}
+
+TEST_F(test_watcher, ignoresOtherFiles)
+{
+    ASSERT_TRUE(watcher_add(&watcher, path("state_changed").c_str(), onWatch, &record));
+
+    touch("percBat");
+    touch("state_changed_");
+    EXPECT_EQ(pollOnce(100), 0);
+    EXPECT_TRUE(record.events.empty());
+}
+
+TEST_F(test_watcher, sharesDirectoryWatch)
+{
+    WatchRecord other;
+    ASSERT_TRUE(watcher_add(&watcher, path("settings_changed").c_str(), onWatch, &record));
+    ASSERT_TRUE(watcher_add(&watcher, path("state_changed").c_str(), onWatch, &other));
+
+    touch("state_changed");
+    EXPECT_EQ(pollOnce(1000), 1);
+    EXPECT_TRUE(record.events.empty());
+    EXPECT_EQ(other.events.size(), 1);
+}
+
+TEST_F(test_watcher, failsForMissingDirectory)
+{
+    EXPECT_FALSE(watcher_add(&watcher, path("missing/state_changed").c_str(), onWatch, &record));
+}
+
+// Benchmark, not run by default: --gtest_also_run_disabled_tests
+TEST_F(test_watcher, DISABLED_reactionLatency)
+{
+    const int iterations = 50;
+    double total_us = 0, max_us = 0;
+
+    ASSERT_TRUE(watcher_add(&watcher, path("state_changed").c_str(), onWatch, &record));
+
+    for (int i = 0; i < iterations; i++) {
+        Clock::time_point written;
+        std::thread writer([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            written = Clock::now();
+            if (i % 2 == 0)
+                touch("state_changed");
+            else
+                remove(path("state_changed").c_str());
+        });
+        int called = pollOnce(1000);
+        writer.join();
+        ASSERT_EQ(called, 1);
+
+        double us = std::chrono::duration<double, std::micro>(record.last - written).count();
+        total_us += us;
+        if (us > max_us)
+            max_us = us;
+    }
+
+    // keymon used to notice these on the next key press, or within 15 s
+    printf("watcher: %.0f us mean, %.0f us max reaction latency\n", total_us / iterations, max_us);
+}